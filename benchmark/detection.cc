@@ -0,0 +1,81 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+/*
+ * Measures how keypoint detection and descriptor extraction scale with
+ * the number of threads. Every run loads the images again, so that no
+ * cached results are reused between runs.
+ *
+ *   benchmark/detection examples/images/box1.jpg examples/images/box2.jpg ...
+ */
+
+#include <chrono>
+#include <iostream>
+#include <omp.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <boxes.h>
+
+static double run(const std::vector<std::string>& filenames, int threads) {
+	Boxes::Boxes boxes;
+
+	for (std::string filename: filenames)
+		boxes.img_read(filename);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	#pragma omp parallel for num_threads(threads) schedule(dynamic)
+	for (unsigned int i = 0; i < boxes.img_size(); i++) {
+		Boxes::Image* image = boxes.img_get(i);
+
+		image->get_descriptors();
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	return elapsed.count();
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " IMAGE..." << std::endl;
+		exit(2);
+	}
+
+	std::vector<std::string> filenames(argv + 1, argv + argc);
+
+	int max_threads = omp_get_max_threads();
+	double baseline = 0.0;
+
+	std::cout << "threads\tseconds\timages/s\tspeedup" << std::endl;
+
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		double seconds = run(filenames, threads);
+
+		if (threads == 1)
+			baseline = seconds;
+
+		std::cout << threads << "\t" << seconds << "\t"
+			<< filenames.size() / seconds << "\t" << baseline / seconds << std::endl;
+	}
+
+	exit(0);
+}
@@ -0,0 +1,89 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+/*
+ * Compares the Hamming kernel with cv::BFMatcher on random 32 byte
+ * descriptors, as they are produced by ORB.
+ *
+ *   benchmark/hamming [ROWS...]
+ */
+
+#include <chrono>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <stdlib.h>
+#include <vector>
+
+#include <boxes/constants.h>
+#include <boxes/descriptor_index.h>
+#include <boxes/hamming.h>
+
+#define BENCHMARK_DESCRIPTOR_BYTES 32
+#define BENCHMARK_RATIO 0.8
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds_since(Clock::time_point start) {
+	std::chrono::duration<double> elapsed = Clock::now() - start;
+
+	return elapsed.count();
+}
+
+static void run(int rows) {
+	cv::Mat query(rows, BENCHMARK_DESCRIPTOR_BYTES, CV_8U);
+	cv::Mat train(rows, BENCHMARK_DESCRIPTOR_BYTES, CV_8U);
+
+	cv::randu(query, cv::Scalar::all(0), cv::Scalar::all(256));
+	cv::randu(train, cv::Scalar::all(0), cv::Scalar::all(256));
+
+	std::vector<cv::DMatch> bf_matches;
+	std::vector<cv::DMatch> hamming_matches;
+
+	Clock::time_point start = Clock::now();
+	Boxes::BruteForceIndex bf_index(&train);
+	bf_index.ratio_match(&query, BENCHMARK_RATIO, &bf_matches);
+	double bf_seconds = seconds_since(start);
+
+	start = Clock::now();
+	Boxes::HammingIndex hamming_index(&train);
+	hamming_index.ratio_match(&query, BENCHMARK_RATIO, &hamming_matches);
+	double hamming_seconds = seconds_since(start);
+
+	std::cout << rows << "\t" << bf_seconds << "\t" << hamming_seconds << "\t"
+		<< bf_seconds / hamming_seconds << "\t" << bf_matches.size() << "\t"
+		<< hamming_matches.size() << std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::vector<int> sizes;
+
+	for (int i = 1; i < argc; i++)
+		sizes.push_back(atoi(argv[i]));
+
+	if (sizes.empty())
+		sizes = { 500, 1000, 2000, 5000, 10000 };
+
+	std::cout << "Using the " << Boxes::hamming_implementation() << " implementation" << std::endl;
+	std::cout << "rows\tBFMatcher\thamming\tspeedup\tBF matches\thamming matches" << std::endl;
+
+	for (int rows: sizes)
+		run(rows);
+
+	exit(0);
+}
@@ -0,0 +1,117 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+/*
+ * Compares the fundamental matrix and the five-point estimator on all
+ * image pairs. For both it prints the time spent in matching and in
+ * calculating the camera matrix, the number of RANSAC iterations, how
+ * many models were scored and rejected early by SPRT and the share of
+ * inliers.
+ *
+ *   benchmark/pose [KEY=VALUE...] IMAGE...
+ *
+ * For example with examples/images/box1.jpg examples/images/box2.jpg.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <boxes.h>
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds_since(Clock::time_point start) {
+	std::chrono::duration<double> elapsed = Clock::now() - start;
+
+	return elapsed.count();
+}
+
+static void run(const std::vector<std::string>& config, const std::vector<std::string>& filenames, const std::string estimator) {
+	Boxes::Boxes boxes;
+
+	for (std::string line: config)
+		boxes.config->parse_line(line);
+
+	boxes.config->set("POSE_ESTIMATOR", estimator);
+	boxes.compile_settings();
+
+	for (std::string filename: filenames)
+		boxes.img_read(filename);
+
+	// Detect features and build the indices before measuring.
+	for (unsigned int i = 0; i < boxes.img_size(); i++)
+		boxes.img_get(i)->get_descriptor_index();
+
+	double seconds = 0.0;
+	unsigned int iterations = 0;
+	unsigned int models = 0;
+	unsigned int rejected = 0;
+	unsigned int putative_matches = 0;
+	double inliers = 0.0;
+
+	for (std::pair<Boxes::Image*, Boxes::Image*> image_pair: boxes.make_pairs()) {
+		Boxes::FeatureMatcher matcher(&boxes, image_pair.first, image_pair.second);
+
+		Clock::time_point start = Clock::now();
+		matcher.match();
+		delete matcher.calculate_camera_matrix();
+		seconds += seconds_since(start);
+
+		const Boxes::RansacResult* result = matcher.get_ransac_result();
+		iterations += result->iterations;
+		models += result->models;
+		rejected += result->rejected;
+
+		putative_matches += matcher.get_putative_matches();
+		inliers += matcher.get_inlier_ratio() * matcher.get_putative_matches();
+	}
+
+	std::cout << estimator << "\t" << seconds << "\t" << iterations << "\t"
+		<< models << "\t" << rejected << "\t" << putative_matches << "\t" << inliers << "\t"
+		<< (putative_matches ? inliers / putative_matches : 0.0) << std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::vector<std::string> config;
+	std::vector<std::string> filenames;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+
+		if (arg.find("=") != std::string::npos)
+			config.push_back(arg);
+		else
+			filenames.push_back(arg);
+	}
+
+	if (filenames.size() < 2) {
+		std::cerr << "Usage: " << argv[0] << " [KEY=VALUE...] IMAGE..." << std::endl;
+		exit(2);
+	}
+
+	std::cout << "estimator\tseconds\titerations\tmodels\trejected\tmatches\tinliers\tinlier ratio" << std::endl;
+
+	run(config, filenames, POSE_ESTIMATOR_FUNDAMENTAL);
+	run(config, filenames, POSE_ESTIMATOR_FIVE_POINT);
+
+	exit(0);
+}
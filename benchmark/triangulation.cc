@@ -0,0 +1,176 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+/*
+ * Compares the triangulation kernel with the previous implementation,
+ * which used cv::Mat and cv::solve(..., cv::DECOMP_SVD) for every point.
+ * The default size is one correspondence per pixel of a 1280x960 image,
+ * like on the Farneback optical flow path.
+ *
+ *   benchmark/triangulation [POINTS]
+ */
+
+#include <chrono>
+#include <iostream>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <stdlib.h>
+#include <vector>
+
+#include <boxes/triangulation.h>
+
+#define BENCHMARK_POINTS (1280 * 960)
+
+// The previous implementation with the same parameters.
+#define REFERENCE_MAX_ITERATIONS 10
+#define REFERENCE_EPSILON 0.001
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds_since(Clock::time_point start) {
+	std::chrono::duration<double> elapsed = Clock::now() - start;
+
+	return elapsed.count();
+}
+
+static cv::Mat_<double> reference_solve(const cv::Point3d* p1, const cv::Matx34d* c1, const cv::Point3d* p2, const cv::Matx34d* c2, double weight1, double weight2) {
+	cv::Matx43d A(
+		(p1->x * (*c1)(2,0) - (*c1)(0,0)) / weight1, (p1->x * (*c1)(2,1) - (*c1)(0,1)) / weight1, (p1->x * (*c1)(2,2) - (*c1)(0,2)) / weight1,
+		(p1->y * (*c1)(2,0) - (*c1)(1,0)) / weight1, (p1->y * (*c1)(2,1) - (*c1)(1,1)) / weight1, (p1->y * (*c1)(2,2) - (*c1)(1,2)) / weight1,
+		(p2->x * (*c2)(2,0) - (*c2)(0,0)) / weight2, (p2->x * (*c2)(2,1) - (*c2)(0,1)) / weight2, (p2->x * (*c2)(2,2) - (*c2)(0,2)) / weight2,
+		(p2->y * (*c2)(2,0) - (*c2)(1,0)) / weight2, (p2->y * (*c2)(2,1) - (*c2)(1,1)) / weight2, (p2->y * (*c2)(2,2) - (*c2)(1,2)) / weight2
+	);
+
+	cv::Matx41d B(
+		-(p1->x * (*c1)(2,3) - (*c1)(0,3)) / weight1,
+		-(p1->y * (*c1)(2,3) - (*c1)(1,3)) / weight1,
+		-(p2->x * (*c2)(2,3) - (*c2)(0,3)) / weight2,
+		-(p2->y * (*c2)(2,3) - (*c2)(1,3)) / weight2
+	);
+
+	cv::Mat_<double> X;
+	cv::solve(A, B, X, cv::DECOMP_SVD);
+
+	cv::Mat_<double> Y(4,1);
+	Y(0) = X(0);
+	Y(1) = X(1);
+	Y(2) = X(2);
+	Y(3) = 1.0;
+
+	return Y;
+}
+
+static cv::Mat_<double> reference_triangulate(const cv::Point2f* pt1, const cv::Mat* c1_inv, const cv::Matx34d* p1,
+		const cv::Point2f* pt2, const cv::Mat* c2_inv, const cv::Matx34d* p2) {
+	cv::Mat_<double> x1 = *c1_inv * cv::Mat_<double>(cv::Point3d(pt1->x, pt1->y, 1.0));
+	cv::Mat_<double> x2 = *c2_inv * cv::Mat_<double>(cv::Point3d(pt2->x, pt2->y, 1.0));
+
+	cv::Point3d u1(x1(0), x1(1), x1(2));
+	cv::Point3d u2(x2(0), x2(1), x2(2));
+
+	double weight1 = 1.0;
+	double weight2 = 1.0;
+
+	cv::Mat_<double> X = reference_solve(&u1, p1, &u2, p2, weight1, weight2);
+
+	for (unsigned int i = 0; i < REFERENCE_MAX_ITERATIONS; i++) {
+		double weight1_ = cv::Mat_<double>(cv::Mat_<double>(*p1).row(2) * X)(0);
+		double weight2_ = cv::Mat_<double>(cv::Mat_<double>(*p2).row(2) * X)(0);
+
+		if ((fabsf(weight1 - weight1_) <= REFERENCE_EPSILON) && (fabsf(weight2 - weight2_) <= REFERENCE_EPSILON))
+			break;
+
+		weight1 = weight1_;
+		weight2 = weight2_;
+
+		X = reference_solve(&u1, p1, &u2, p2, weight1, weight2);
+	}
+
+	return X;
+}
+
+static cv::Point2f project(const cv::Matx34d* P, const cv::Point3d* X) {
+	cv::Vec3d x = (*P) * cv::Vec4d(X->x, X->y, X->z, 1.0);
+
+	return cv::Point2f(x[0] / x[2], x[1] / x[2]);
+}
+
+int main(int argc, char **argv) {
+	unsigned int n = BENCHMARK_POINTS;
+	if (argc > 1)
+		n = atoi(argv[1]);
+
+	cv::Matx33d camera(1280, 0, 640, 0, 960, 480, 0, 0, 1);
+
+	cv::Matx34d p1 = cv::Matx34d::eye();
+	cv::Matx34d p2(
+		cos(0.1),  0, sin(0.1), -1.0,
+		0,         1, 0,         0.05,
+		-sin(0.1), 0, cos(0.1),  0.02
+	);
+
+	cv::Matx34d KP1 = camera * p1;
+	cv::Matx34d KP2 = camera * p2;
+
+	// Project random points into both images and add some noise.
+	cv::RNG rng;
+	std::vector<cv::Point2f> points1(n);
+	std::vector<cv::Point2f> points2(n);
+
+	for (unsigned int i = 0; i < n; i++) {
+		cv::Point3d X(rng.uniform(-2.0, 2.0), rng.uniform(-2.0, 2.0), rng.uniform(4.0, 12.0));
+
+		points1[i] = project(&KP1, &X) + cv::Point2f(rng.gaussian(0.5), rng.gaussian(0.5));
+		points2[i] = project(&KP2, &X) + cv::Point2f(rng.gaussian(0.5), rng.gaussian(0.5));
+	}
+
+	// The new kernel.
+	std::vector<cv::Point3d> points(n);
+	std::vector<double> reprojection_errors(n);
+	std::vector<uchar> valid(n);
+
+	Clock::time_point start = Clock::now();
+	Boxes::triangulate_correspondences(&points1[0], &points2[0], n, camera, p1, camera, p2,
+		&points[0], &reprojection_errors[0], &valid[0]);
+	double kernel_seconds = seconds_since(start);
+
+	// The previous implementation.
+	cv::Mat c_inv = cv::Mat(camera).inv();
+	double max_difference = 0.0;
+
+	start = Clock::now();
+	for (unsigned int i = 0; i < n; i++) {
+		cv::Mat_<double> X = reference_triangulate(&points1[i], &c_inv, &p1, &points2[i], &c_inv, &p2);
+
+		// Degenerate points have no usable position to compare.
+		if (!valid[i])
+			continue;
+
+		double difference = cv::norm(cv::Point3d(X(0), X(1), X(2)) - points[i]);
+		if (difference > max_difference)
+			max_difference = difference;
+	}
+	double reference_seconds = seconds_since(start);
+
+	std::cout << "points\treference\tkernel\tspeedup\tmax difference" << std::endl;
+	std::cout << n << "\t" << reference_seconds << "\t" << kernel_seconds << "\t"
+		<< reference_seconds / kernel_seconds << "\t" << max_difference << std::endl;
+
+	exit(0);
+}
@@ -20,12 +20,15 @@
 #ifndef BOXES_BOXES_H
 #define BOXES_BOXES_H
 
+#include <mutex>
 #include <opencv2/opencv.hpp>
 #include <string>
 #include <vector>
 
 #include <boxes/config.h>
+#include <boxes/feature_registry.h>
 #include <boxes/image.h>
+#include <boxes/scheduler.h>
 
 namespace Boxes {
 	class Boxes {
@@ -34,6 +37,14 @@ namespace Boxes {
 			~Boxes();
 
 			Config* config = NULL;
+			FeatureRegistry* features = NULL;
+
+			// Settings
+			const Settings& compile_settings();
+			const Settings& get_settings();
+
+			// The thread pool that all parallel work of the library runs on.
+			Scheduler* get_scheduler();
 
 			// Image operations
 			unsigned int img_read(const std::string filename, const std::string resolution = "");
@@ -54,6 +65,14 @@ namespace Boxes {
 
 		private:
 			std::vector<Image*> images;
+
+			Settings settings;
+			bool settings_compiled = false;
+			std::mutex settings_mutex;
+
+			Scheduler* scheduler = NULL;
+			int scheduler_threads = 0;
+			std::mutex scheduler_mutex;
 	};
 }
 
@@ -0,0 +1,103 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifndef BOXES_BUNDLE_ADJUSTMENT_H
+#define BOXES_BUNDLE_ADJUSTMENT_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include <boxes/scheduler.h>
+
+namespace Boxes {
+	struct BundleAdjustmentResult {
+		unsigned int cameras = 0;
+		unsigned int points = 0;
+		unsigned int observations = 0;
+
+		unsigned int iterations = 0;
+		bool converged = false;
+
+		// Root mean square reprojection error in pixels before and after.
+		double initial_error = 0.0;
+		double final_error = 0.0;
+
+		double seconds = 0.0;
+	};
+
+	/*
+	 * Sparse bundle adjustment.
+	 *
+	 * Refines camera poses [R|t] and points together, so that the sum of
+	 * the robust (Huber) reprojection errors of all observations becomes
+	 * minimal. Every Levenberg-Marquardt step eliminates the points with
+	 * the Schur complement and only solves a dense system with six
+	 * unknowns per free camera.
+	 *
+	 * Residuals, Jacobians and the blocks of the normal equations are
+	 * evaluated in parallel on the scheduler, and all sums are taken in a
+	 * fixed order, so the result does not depend on the number of threads.
+	 */
+	class BundleAdjuster {
+		public:
+			BundleAdjuster(unsigned int max_iterations, Scheduler* scheduler);
+
+			// camera is the intrinsic matrix, fixed cameras do not move.
+			unsigned int add_camera(const cv::Matx34d* pose, const cv::Matx33d* camera, bool fixed = false);
+			unsigned int add_point(const cv::Point3d* point);
+			void add_observation(unsigned int camera, unsigned int point, const cv::Point2f* pt);
+
+			BundleAdjustmentResult run();
+
+			cv::Matx34d get_pose(unsigned int camera) const;
+			cv::Point3d get_point(unsigned int point) const;
+
+		private:
+			unsigned int max_iterations;
+			Scheduler* scheduler = NULL;
+
+			// Cameras
+			std::vector<cv::Matx33d> rotations;
+			std::vector<cv::Vec3d> translations;
+			std::vector<cv::Matx33d> intrinsics;
+			std::vector<uchar> fixed;
+
+			std::vector<cv::Vec3d> points;
+
+			// Observations
+			std::vector<unsigned int> observation_cameras;
+			std::vector<unsigned int> observation_points;
+			std::vector<cv::Vec2d> observation_coordinates;
+
+			// Observations grouped by point and by camera.
+			std::vector<unsigned int> point_offsets;
+			std::vector<unsigned int> point_observations;
+			std::vector<unsigned int> camera_offsets;
+			std::vector<unsigned int> camera_observations;
+
+			void index_observations();
+
+			double evaluate(const std::vector<cv::Matx33d>* rotations, const std::vector<cv::Vec3d>* translations,
+				const std::vector<cv::Vec3d>* points, double* squared_error) const;
+			void linearize(std::vector<cv::Vec2d>* residuals, std::vector<double>* weights,
+				std::vector<cv::Matx<double, 2, 6> >* camera_jacobians, std::vector<cv::Matx23d>* point_jacobians) const;
+	};
+};
+
+#endif
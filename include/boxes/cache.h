@@ -0,0 +1,127 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifndef BOXES_CACHE_H
+#define BOXES_CACHE_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace Boxes {
+	/*
+	 * A string-keyed cache that owns the objects it holds.
+	 *
+	 * Values are computed on the first lookup of a key and deleted
+	 * when the cache is destroyed or the key is erased. Callers must
+	 * not free them.
+	 *
+	 * Lookups are thread-safe. Every entry is initialized exactly once:
+	 * different keys are computed concurrently, while a thread asking
+	 * for a key that is being computed waits for that result.
+	 */
+	template <typename T>
+	class Cache {
+		public:
+			Cache() {};
+			~Cache() {
+				this->clear();
+			};
+
+			T* get(const std::string key, std::function<T*()> compute) {
+				Entry* entry;
+
+				// Only hold the lock while looking up (or creating) the entry.
+				{
+					std::lock_guard<std::mutex> lock(this->mutex);
+
+					std::unique_ptr<Entry>& e = this->map[key];
+					if (!e)
+						e.reset(new Entry());
+
+					entry = e.get();
+				}
+
+				bool computed = false;
+				std::call_once(entry->once, [&]() {
+					entry->value = compute();
+					computed = true;
+				});
+
+				if (computed)
+					this->_misses++;
+				else
+					this->_hits++;
+
+				return entry->value;
+			};
+
+			void clear() {
+				std::lock_guard<std::mutex> lock(this->mutex);
+
+				for (typename std::map<std::string, std::unique_ptr<Entry>>::iterator i = this->map.begin(); i != this->map.end(); i++) {
+					delete i->second->value;
+				}
+
+				this->map.clear();
+			};
+
+			// Deletes the value of key, the next lookup computes it again.
+			// Nobody may still be using the value or computing it.
+			void erase(const std::string key) {
+				std::lock_guard<std::mutex> lock(this->mutex);
+
+				typename std::map<std::string, std::unique_ptr<Entry>>::iterator i = this->map.find(key);
+				if (i == this->map.end())
+					return;
+
+				delete i->second->value;
+				this->map.erase(i);
+			};
+
+			unsigned int hits() const {
+				return this->_hits;
+			};
+
+			unsigned int misses() const {
+				return this->_misses;
+			};
+
+		private:
+			// Not copyable, because we own all values.
+			Cache(const Cache&);
+			Cache& operator=(const Cache&);
+
+			struct Entry {
+				std::once_flag once;
+				T* value = NULL;
+			};
+
+			std::mutex mutex;
+			std::map<std::string, std::unique_ptr<Entry>> map;
+
+			std::atomic<unsigned int> _hits{0};
+			std::atomic<unsigned int> _misses{0};
+	};
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include <opencv2/opencv.hpp>
 
 #include <boxes/image.h>
+#include <boxes/structs.h>
 
 namespace Boxes {
 	class CloudPoint {
@@ -35,6 +36,10 @@ namespace Boxes {
 			cv::Point2f pt1;
 			cv::Point2f pt2;
 
+			// Indices of the keypoints pt1 and pt2 were matched from.
+			int queryIdx = MATCH_NO_KEYPOINT;
+			int trainIdx = MATCH_NO_KEYPOINT;
+
 			bool operator==(const CloudPoint& other) const;
 
 			// colours
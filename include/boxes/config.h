@@ -25,22 +25,103 @@
 #include <string>
 
 namespace Boxes {
+	/*
+	 * A typed copy of the configuration.
+	 *
+	 * It is compiled and validated once before the pipeline runs, so
+	 * that hot code reads plain fields instead of parsing strings.
+	 */
+	struct Settings {
+		std::string feature_detector;
+		std::string feature_detector_extractor;
+
+		double match_valid_ratio = 0.0;
+		bool match_symmetric = false;
+		bool match_guided = false;
+		int match_max_keypoints = 0;
+		std::string matcher;
+		int matcher_checks = 0;
+
+		double epipolar_distance_factor = 0.0;
+		std::string pose_estimator;
+
+		double ransac_confidence = 0.0;
+		int ransac_max_iterations = 0;
+		bool ransac_prosac = false;
+		bool ransac_sprt = false;
+		bool ransac_local_optimization = false;
+
+		// Refine all cameras and points after every n image pairs, 0 turns it off.
+		int bundle_adjustment_interval = 0;
+		int bundle_adjustment_max_iterations = 0;
+
+		// Link the matches of all pairs into tracks and triangulate them from all views.
+		bool tracks = false;
+
+		// Reconstruct chunks of this many image pairs in parallel, 0 reconstructs all pairs at once.
+		int reconstruction_chunk_size = 0;
+
+		// Number of threads of the scheduler, 0 uses one thread per core.
+		int threads = 0;
+
+		// Dense optical flow: sample every n-th pixel and drop flow that
+		// does not lead back within this many pixels, 0 keeps all flow.
+		int optical_flow_stride = 0;
+		double optical_flow_max_error = 0.0;
+
+		// One of the optical flow engines from constants.h.
+		std::string optical_flow_engine;
+
+		// Parameters of cv::calcOpticalFlowFarneback().
+		double farneback_pyramid_scale = 0.0;
+		int farneback_levels = 0;
+		int farneback_window_size = 0;
+		int farneback_iterations = 0;
+		int farneback_poly_n = 0;
+		double farneback_poly_sigma = 0.0;
+
+		// Pyramidal Lucas-Kanade: points with a larger error are lost. Tracks
+		// good features to track instead of the keypoints if lk_gftt is set.
+		int lk_window_size = 0;
+		int lk_levels = 0;
+		double lk_max_error = 0.0;
+		bool lk_gftt = false;
+
+		// Patch based flow: patches of size pixels, every stride pixels,
+		// on up to levels pyramid levels with that many iterations each.
+		int patch_flow_size = 0;
+		int patch_flow_stride = 0;
+		int patch_flow_levels = 0;
+		int patch_flow_iterations = 0;
+
+		// Track features through the image sequence instead of matching
+		// every pair. Features are detected again when fewer than
+		// tracking_min_features are left, up to tracking_max_features.
+		bool sequence_tracking = false;
+		int tracking_max_features = 0;
+		int tracking_min_features = 0;
+
+		int surf_min_hessian = 0;
+	};
+
 	class Config {
 		public:
 			Config();
 
 			void dump() const;
 
-			std::string get(std::string key);
-			int get_int(std::string key);
-			double get_double(std::string key);
-			bool get_bool(std::string key);
+			std::string get(std::string key) const;
+			int get_int(std::string key) const;
+			double get_double(std::string key) const;
+			bool get_bool(std::string key) const;
 
 			void set(std::string key, std::string value);
 
 			void read(const std::string filename);
 			void parse_line(const std::string line);
 
+			Settings compile() const;
+
 		private:
 			std::map<std::string, std::string> map;
 	};
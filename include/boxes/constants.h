@@ -20,10 +20,6 @@
 #ifndef BOXES_CONSTANTS_H
 #define BOXES_CONSTANTS_H
 
-// Match types
-#define MATCH_TYPE_NORMAL                  0
-#define MATCH_TYPE_RADIUS                  1
-
 // Feature Detector
 /* Available feature detectors: FAST, STAR, ORB, BRISK, MSER, GFTT, HARRIS,
      Dense, SimpleBlob, Grid, Pyramid and (SIFT, SURF which are non-free) */
@@ -53,6 +49,28 @@
 # define DEFAULT_FEATURE_DETECTOR_EXTRACTOR       "ORB"
 #endif
 
+// Descriptor matchers
+#define MATCHER_AUTO                              "AUTO"
+#define MATCHER_BRUTE_FORCE                       "BF"
+#define MATCHER_HAMMING                           "HAMMING"
+#define MATCHER_KDTREE                            "KDTREE"
+#define MATCHER_LSH                               "LSH"
+
+#define DEFAULT_MATCHER                           "BF"
+
+// Pose estimators
+#define POSE_ESTIMATOR_FUNDAMENTAL                "FUNDAMENTAL"
+#define POSE_ESTIMATOR_FIVE_POINT                 "FIVE_POINT"
+
+#define DEFAULT_POSE_ESTIMATOR                    "FUNDAMENTAL"
+
+// Optical flow engines
+#define OPTICAL_FLOW_ENGINE_FARNEBACK             "FARNEBACK"
+#define OPTICAL_FLOW_ENGINE_LUCAS_KANADE          "LK"
+#define OPTICAL_FLOW_ENGINE_PATCH                 "PATCH"
+
+#define DEFAULT_OPTICAL_FLOW_ENGINE               "FARNEBACK"
+
 #define CAMERA_EXTENSION                          "camera"
 #define NURBS_CURVE_EXTENSION                     "nurbs"
 
@@ -69,22 +87,114 @@
 #define REPROJECTION_ERROR_MAX		200.0
 
 #define DEFAULT_MATCH_VALID_RATIO	"0.8"
+#define DEFAULT_MATCH_SYMMETRIC		"false"
+#define DEFAULT_MATCH_GUIDED		"false"
+#define DEFAULT_MATCH_MAX_KEYPOINTS	"0"
+#define DEFAULT_MATCHER_CHECKS		"32"
 #define DEFAULT_EPIPOLAR_DISTANCE_FACTOR	"0.001"
 
 // Optical Flow constants
-#define OPTICAL_FLOW_ALGO_FARNEBACK
-
-#define OPTICAL_FLOW_USE_GREYSCALE_IMAGES
-// #define OPTICAL_FLOW_USE_GFTT
-#define OF_SEARCH_WINDOW_SIZE           50
-#define OF_MAX_PYRAMIDS                  5
-#define OF_MAX_VERROR                    5.0
-#define OF_RADIUS_MATCH                 (float)OF_SEARCH_WINDOW_SIZE
+#define DEFAULT_OPTICAL_FLOW_STRIDE      "4"
+#define DEFAULT_OPTICAL_FLOW_MAX_ERROR   "1.0"
+
+// Largest distance of a tracked point from a keypoint of the second image, in pixels
+#define OF_RADIUS_MATCH                  8.0f
+
+#define DEFAULT_FARNEBACK_PYRAMID_SCALE  "0.5"
+#define DEFAULT_FARNEBACK_LEVELS         "3"
+#define DEFAULT_FARNEBACK_WINDOW_SIZE    "15"
+#define DEFAULT_FARNEBACK_ITERATIONS     "3"
+#define DEFAULT_FARNEBACK_POLY_N         "5"
+#define DEFAULT_FARNEBACK_POLY_SIGMA     "1.2"
+
+#define DEFAULT_LK_WINDOW_SIZE           "50"
+#define DEFAULT_LK_LEVELS                "5"
+#define DEFAULT_LK_MAX_ERROR             "5.0"
+#define DEFAULT_LK_GFTT                  "false"
+
+// Added to the Hessian of every pixel of a patch, in squared intensity per pixel
+#define PATCH_FLOW_REGULARIZATION        0.01
+// Patches stop moving when an update is shorter than this, in pixels
+#define PATCH_FLOW_EPSILON               0.01
+#define PATCH_FLOW_ROWS_PER_TASK         4
+
+#define DEFAULT_PATCH_FLOW_SIZE          "8"
+#define DEFAULT_PATCH_FLOW_STRIDE        "4"
+#define DEFAULT_PATCH_FLOW_LEVELS        "5"
+#define DEFAULT_PATCH_FLOW_ITERATIONS    "16"
+
+#define DEFAULT_SEQUENCE_TRACKING        "false"
+#define DEFAULT_TRACKING_MAX_FEATURES    "1500"
+#define DEFAULT_TRACKING_MIN_FEATURES    "1000"
+
+// New tracks are started this far from others, in pixels
+#define TRACKING_MIN_DISTANCE            8.0
+#define TRACKING_QUALITY_LEVEL           0.05
+
+// FLANN index parameters
+#define MATCHER_KDTREE_TREES             4
+#define MATCHER_LSH_TABLES              12
+#define MATCHER_LSH_KEY_SIZE            20
+#define MATCHER_LSH_MULTI_PROBE_LEVEL    2
 
 // Triangulation
 #define TRIANGULATION_MAX_ITERATIONS    10
 #define TRIANGULATION_EPSILON            0.001
 
+// RANSAC
+#define RANSAC_SEED                     0x5eed
+#define RANSAC_SPRT_EPSILON              0.1
+#define RANSAC_SPRT_MAX_EPSILON          0.999
+#define RANSAC_SPRT_DELTA                0.01
+#define RANSAC_SPRT_MODEL_COST         200.0
+#define RANSAC_LO_ITERATIONS             4
+#define RANSAC_LO_THRESHOLD_MULTIPLIER   3.0
+
+// Samples that one task of the scheduler fits and scores
+#define RANSAC_SAMPLES_PER_TASK          1
+
+#define DEFAULT_RANSAC_CONFIDENCE        "0.99"
+#define DEFAULT_RANSAC_MAX_ITERATIONS    "1000"
+#define DEFAULT_RANSAC_PROSAC            "true"
+#define DEFAULT_RANSAC_SPRT              "true"
+#define DEFAULT_RANSAC_LOCAL_OPTIMIZATION "true"
+
+// Largest reprojection error of an inlier of the camera pose, in pixels
+#define PNP_REPROJECTION_ERROR           8.0
+
+// Largest distance of a point from its counterpart in the next chunk, relative to the extent of the points
+#define RECONSTRUCTION_CHUNK_ALIGNMENT_ERROR  0.05
+
+#define DEFAULT_RECONSTRUCTION_CHUNK_SIZE     "0"
+
+// Scheduler
+#define DEFAULT_THREADS                 "0"
+
+// Bundle adjustment
+#define BUNDLE_ADJUSTMENT_HUBER_DELTA      2.0
+#define BUNDLE_ADJUSTMENT_INITIAL_LAMBDA   1e-3
+#define BUNDLE_ADJUSTMENT_MIN_LAMBDA       1e-10
+#define BUNDLE_ADJUSTMENT_MAX_LAMBDA       1e12
+#define BUNDLE_ADJUSTMENT_MIN_DAMPING      1e-9
+#define BUNDLE_ADJUSTMENT_TOLERANCE        1e-6
+
+// Work of one task of the scheduler
+#define BUNDLE_ADJUSTMENT_OBSERVATIONS_PER_TASK 1024
+#define BUNDLE_ADJUSTMENT_POINTS_PER_TASK        256
+#define BUNDLE_ADJUSTMENT_CAMERAS_PER_TASK         1
+
+#define DEFAULT_BUNDLE_ADJUSTMENT_INTERVAL       "3"
+#define DEFAULT_BUNDLE_ADJUSTMENT_MAX_ITERATIONS "20"
+
+#define DEFAULT_TRACKS                           "true"
+
+// Tracks that one task of the scheduler triangulates
+#define TRACKS_PER_TASK                  256
+
+// Number of correspondences that decide between the four poses of an essential matrix
+#define CHEIRALITY_SAMPLE_SIZE          64
+#define CHEIRALITY_SEED                 0x5eed
+
 // Point Cloud constants
 #define POINT_CLOUD_TRIANGULATION_SEARCH_RADIUS            1000
 #define POINT_CLOUD_TRIANGULATION_MULTIPLIER                  5.0
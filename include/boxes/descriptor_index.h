@@ -0,0 +1,112 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifndef BOXES_DESCRIPTOR_INDEX_H
+#define BOXES_DESCRIPTOR_INDEX_H
+
+#include <mutex>
+#include <opencv2/flann/flann.hpp>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include <boxes/config.h>
+#include <boxes/hamming.h>
+
+namespace Boxes {
+	/*
+	 * A searchable set of descriptors of one image.
+	 *
+	 * An index is built once per image and then queried with the
+	 * descriptors of every other image it is matched against.
+	 */
+	class DescriptorIndex {
+		public:
+			DescriptorIndex(const cv::Mat* descriptors);
+			virtual ~DescriptorIndex() {};
+
+			// Finds the k nearest neighbours in this index for each row of query.
+			void knn_match(const cv::Mat* query, std::vector<std::vector<cv::DMatch>>* matches, int k);
+
+			// Finds the best match for each row of query that passes the ratio test.
+			void ratio_match(const cv::Mat* query, double ratio, std::vector<cv::DMatch>* matches);
+
+			// Like ratio_match, but only keeps matches that are also the best match of query_index.
+			void mutual_match(DescriptorIndex* query_index, double ratio, std::vector<cv::DMatch>* matches);
+
+			static void ratio_test(const std::vector<std::vector<cv::DMatch>>* nearest_neighbours,
+				double ratio, std::vector<cv::DMatch>* matches);
+
+			const cv::Mat* get_descriptors() const;
+			bool is_binary() const;
+			int get_norm_type() const;
+
+			static std::string resolve_type(const std::string type, const cv::Mat* descriptors);
+			static DescriptorIndex* create(const std::string type, const cv::Mat* descriptors, const Settings& settings);
+
+		protected:
+			const cv::Mat* descriptors;
+
+			virtual void _knn_match(const cv::Mat* query, std::vector<std::vector<cv::DMatch>>* matches, int k) = 0;
+			virtual void _ratio_match(const cv::Mat* query, double ratio, std::vector<cv::DMatch>* matches);
+			virtual void _mutual_match(DescriptorIndex* query_index, double ratio, std::vector<cv::DMatch>* matches);
+	};
+
+	class BruteForceIndex: public DescriptorIndex {
+		public:
+			BruteForceIndex(const cv::Mat* descriptors):
+				DescriptorIndex(descriptors) {};
+
+		protected:
+			void _knn_match(const cv::Mat* query, std::vector<std::vector<cv::DMatch>>* matches, int k);
+	};
+
+	/*
+	 * Exact matching of binary descriptors with a SIMD Hamming kernel.
+	 */
+	class HammingIndex: public DescriptorIndex {
+		public:
+			HammingIndex(const cv::Mat* descriptors);
+
+		protected:
+			void _knn_match(const cv::Mat* query, std::vector<std::vector<cv::DMatch>>* matches, int k);
+			void _ratio_match(const cv::Mat* query, double ratio, std::vector<cv::DMatch>* matches);
+			void _mutual_match(DescriptorIndex* query_index, double ratio, std::vector<cv::DMatch>* matches);
+
+		private:
+			void knn2(const cv::Mat* query, std::vector<HammingNeighbours>* neighbours) const;
+	};
+
+	class FlannIndex: public DescriptorIndex {
+		public:
+			FlannIndex(const cv::Mat* descriptors, const cv::flann::IndexParams& params, int checks);
+
+		protected:
+			void _knn_match(const cv::Mat* query, std::vector<std::vector<cv::DMatch>>* matches, int k);
+
+		private:
+			cv::flann::Index index;
+			int checks;
+
+			// cv::flann::Index may not be searched from several threads at once.
+			std::mutex mutex;
+	};
+};
+
+#endif
@@ -21,13 +21,18 @@
 #define BOXES_FEATURE_MATCHER_H
 
 #include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <unordered_map>
 #include <vector>
 
 #include <boxes/boxes.h>
 #include <boxes/camera_matrix.h>
+#include <boxes/config.h>
 #include <boxes/constants.h>
 #include <boxes/image.h>
+#include <boxes/match_table.h>
 #include <boxes/point_cloud.h>
+#include <boxes/ransac.h>
 #include <boxes/structs.h>
 
 #define FEATURE_MATCHER_USE_SINGLE_MATCHES
@@ -44,6 +49,9 @@ namespace Boxes {
 			PointCloud* point_cloud;
 
 			virtual void match();
+
+			// The pose of image2 relative to image1, which the caller owns.
+			// The images are left alone, MultiCamera sets their poses once the chunks are merged.
 			CameraMatrix* calculate_camera_matrix();
 
 			virtual void draw_matches(const std::string filename);
@@ -52,26 +60,54 @@ namespace Boxes {
 			double triangulate_points(const cv::Matx34d* p1, const cv::Matx34d* p2, PointCloud* point_cloud);
 			double reprojection_error;
 
-			cv::Point2f* find_corresponding_keypoint_coordinates(cv::Point2f* pt1) const;
+			const MatchTable* get_matches() const;
+
+			// Finds the position of the match of a keypoint of image1 in constant time, or -1.
+			// Optical flow matches are looked up by the coordinates pt1 instead.
+			int find_match(int keypoint_idx, const cv::Point2f* pt1) const;
+
+			// Number of matches before and share of inliers after estimating the fundamental matrix.
+			unsigned int get_putative_matches() const;
+			double get_inlier_ratio() const;
+
+			// Statistics of the last RANSAC run.
+			const RansacResult* get_ransac_result() const;
 
 		protected:
 			Boxes* boxes = NULL;
 
-			void _match(const cv::Mat* descriptors1, const cv::Mat* descriptors2, const std::vector<MatchPoint>* match_points = NULL, int match_type = MATCH_TYPE_NORMAL, int norm_type = cv::NORM_L2);
-			std::vector<MatchPoint> matches;
+			// A copy, because Boxes::compile_settings() may replace them while we are matching.
+			const Settings settings;
+
+			void add_matches(const std::vector<cv::DMatch>* good_matches);
+			MatchTable matches;
+			unsigned int putative_matches = 0;
+			unsigned int inlier_matches = 0;
+
+			// Position of the match of every keypoint of image1 in matches, or -1.
+			std::vector<int> keypoint_matches;
+			std::unordered_map<uint64_t, int> coordinate_matches;
+			void update_match_index();
+
+			void match_strongest(unsigned int n, std::vector<cv::DMatch>* good_matches);
+			void guided_match();
 
 			// fundamental matrix
 			cv::Mat fundamental_matrix;
+			double epipolar_distance = 0.0;
 			const cv::Mat* get_fundamental_matrix() const;
 			void calculate_fundamental_matrix();
+			RansacResult ransac_result;
 
 			// essential matrix
+			cv::Mat essential_matrix;
 			cv::Mat calculate_essential_matrix();
+			void estimate_essential_matrix(const std::vector<unsigned int>* order, std::vector<uchar>* status);
 
 			std::vector<CameraMatrix*> calculate_possible_camera_matrices(const cv::Mat* essential_matrix, bool check_coherency = true);
 
-			cv::Mat_<double> triangulate_one_point(const cv::Point3d* p1, const cv::Matx34d* c1, const cv::Point3d* p2, const cv::Matx34d* c2);
-			cv::Mat_<double> _triangulate_one_point(const cv::Point3d* p1, const cv::Matx34d* c1, const cv::Point3d* p2, const cv::Matx34d* c2, double weight1 = 1.0, double weight2 = 1.0);
+			// Draws up to n matches and converts them to normalized image coordinates.
+			void sample_normalized_matches(unsigned int n, std::vector<cv::Vec2d>* x1, std::vector<cv::Vec2d>* x2) const;
 
 			pcl::PointCloud<pcl::PointXYZRGB>::Ptr generate_pcl_point_cloud(const std::vector<CloudPoint> point_cloud);
 	};
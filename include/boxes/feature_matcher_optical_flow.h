@@ -25,6 +25,7 @@
 #include <boxes/boxes.h>
 #include <boxes/feature_matcher.h>
 #include <boxes/image.h>
+#include <boxes/optical_flow.h>
 
 namespace Boxes {
 	class FeatureMatcherOpticalFlow: public FeatureMatcher {
@@ -35,6 +36,10 @@ namespace Boxes {
 
 			void match();
 			void draw_matches(const std::string filename);
+
+		private:
+			void match_dense(const OpticalFlow* optical_flow);
+			void match_sparse(const OpticalFlow* optical_flow);
 	};
 };
 
@@ -0,0 +1,78 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifndef BOXES_FEATURE_REGISTRY_H
+#define BOXES_FEATURE_REGISTRY_H
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <opencv2/features2d/features2d.hpp>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <boxes/config.h>
+#include <boxes/forward_declarations.h>
+
+namespace Boxes {
+	typedef std::function<cv::Ptr<cv::FeatureDetector>(const Settings& settings)> FeatureDetectorFactory;
+	typedef std::function<cv::Ptr<cv::DescriptorExtractor>(const Settings& settings)> DescriptorExtractorFactory;
+
+	/*
+	 * Keeps all known feature detectors and descriptor extractors by the
+	 * names from constants.h.
+	 *
+	 * Instances are created on first use and then reused. Every thread
+	 * gets instances of its own, because the OpenCV algorithms are not
+	 * safe to be shared between threads.
+	 */
+	class FeatureRegistry {
+		public:
+			FeatureRegistry(Boxes* boxes);
+			~FeatureRegistry();
+
+			void register_detector(const std::string name, FeatureDetectorFactory factory);
+			void register_extractor(const std::string name, DescriptorExtractorFactory factory);
+
+			bool has_detector(const std::string name) const;
+			bool has_extractor(const std::string name) const;
+
+			cv::FeatureDetector* get_detector(const std::string name);
+			cv::DescriptorExtractor* get_extractor(const std::string name);
+
+			// Drops all instances, so that they will pick up changed settings.
+			void reset();
+
+		private:
+			Boxes* boxes = NULL;
+
+			void register_defaults();
+
+			std::map<std::string, FeatureDetectorFactory> detector_factories;
+			std::map<std::string, DescriptorExtractorFactory> extractor_factories;
+
+			// Instances by thread and name
+			mutable std::mutex mutex;
+			std::map<std::pair<std::thread::id, std::string>, cv::Ptr<cv::FeatureDetector>> detectors;
+			std::map<std::pair<std::thread::id, std::string>, cv::Ptr<cv::DescriptorExtractor>> extractors;
+	};
+};
+
+#endif
@@ -0,0 +1,101 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifndef BOXES_FEATURE_TRACKER_H
+#define BOXES_FEATURE_TRACKER_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include <boxes/boxes.h>
+#include <boxes/feature_matcher_optical_flow.h>
+#include <boxes/image.h>
+#include <boxes/optical_flow.h>
+#include <boxes/structs.h>
+
+namespace Boxes {
+	/*
+	 * One feature, followed through consecutive images.
+	 *
+	 * points[i] is the position of the feature in image first + i.
+	 */
+	struct FeatureTrack {
+		unsigned int first = 0;
+		std::vector<cv::Point2f> points;
+	};
+
+	/*
+	 * Follows features through a sequence of images with Lucas-Kanade.
+	 *
+	 * Features are only detected again when too many tracks have been
+	 * lost, and only in the regions without any tracks left, so that
+	 * every image mostly costs as much as the features it tracks.
+	 */
+	class FeatureTracker {
+		public:
+			FeatureTracker(Boxes* boxes);
+			~FeatureTracker();
+
+			// Starts new tracks on the first image of the sequence.
+			void start(Image* image);
+
+			// Follows all live tracks into the next image of the sequence.
+			// Every track that survived becomes a match from the last image to this one.
+			void track(Image* image, std::vector<MatchPoint>* match_points);
+
+			// All tracks so far, including the ones that have been lost.
+			const std::vector<FeatureTrack>* get_tracks() const;
+
+			// Number of tracks that reached the last image.
+			unsigned int live_size() const;
+
+		private:
+			Boxes* boxes = NULL;
+			OpticalFlow* optical_flow = NULL;
+
+			Image* image = NULL;
+			unsigned int image_index = 0;
+
+			std::vector<FeatureTrack> tracks;
+			std::vector<unsigned int> live;
+
+			// Starts new tracks where there are none.
+			void detect();
+	};
+
+	/*
+	 * Matches two consecutive images by the tracks of a FeatureTracker.
+	 */
+	class FeatureMatcherTracked: public FeatureMatcherOpticalFlow {
+		public:
+			FeatureMatcherTracked(Boxes* boxes, Image *image1, Image *image2):
+				FeatureMatcherOpticalFlow(boxes, image1, image2) {};
+			~FeatureMatcherTracked() {};
+
+			// The matches the tracker found, must be set before match().
+			void set_match_points(const std::vector<MatchPoint>* match_points);
+
+			void match();
+
+		private:
+			std::vector<MatchPoint> match_points;
+	};
+};
+
+#endif
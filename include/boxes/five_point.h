@@ -0,0 +1,43 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifndef BOXES_FIVE_POINT_H
+#define BOXES_FIVE_POINT_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// A minimal sample has five correspondences and has up to ten solutions.
+#define FIVE_POINT_SAMPLE_SIZE       5
+#define FIVE_POINT_MAX_SOLUTIONS    10
+
+namespace Boxes {
+	/*
+	 * The five-point relative pose solver of Nistér.
+	 *
+	 * Finds all essential matrices E with x2^T * E * x1 = 0 for five
+	 * correspondences in normalized image coordinates. The solutions are
+	 * written to essential_matrices, which must have room for
+	 * FIVE_POINT_MAX_SOLUTIONS matrices, and their number is returned.
+	 */
+	unsigned int five_point_solve(const cv::Vec2d* x1, const cv::Vec2d* x2, cv::Matx33d* essential_matrices);
+
+};
+
+#endif
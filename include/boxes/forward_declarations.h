@@ -24,6 +24,7 @@ namespace Boxes {
 	class Boxes;
 	class CameraMatrix;
 	class CloudPoint;
+	class FeatureRegistry;
 	class Image;
 	class PointCloud;
 };
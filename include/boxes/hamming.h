@@ -0,0 +1,96 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifndef BOXES_HAMMING_H
+#define BOXES_HAMMING_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Number of rows that are compared block by block, so that they stay in cache.
+#define HAMMING_TILE_QUERIES     64
+#define HAMMING_TILE_TRAIN      512
+
+// Fixed-point scale of the ratio test.
+#define HAMMING_RATIO_SCALE    1024
+
+#define HAMMING_NO_MATCH         -1
+
+namespace Boxes {
+	/*
+	 * The two nearest neighbours of one query descriptor.
+	 *
+	 * If there is no second neighbour, second is UINT32_MAX.
+	 */
+	struct HammingNeighbours {
+		int idx = HAMMING_NO_MATCH;
+		uint32_t best = UINT32_MAX;
+
+		int second_idx = HAMMING_NO_MATCH;
+		uint32_t second = UINT32_MAX;
+	};
+
+	/*
+	 * Exact top-2 search for binary descriptors.
+	 *
+	 * Every row of query is compared with every row of train. Both
+	 * matrices are given as row pointer, number of rows and row step
+	 * in bytes. All rows must be `bytes` long.
+	 */
+	void hamming_knn2(const uint8_t* query, unsigned int query_rows, size_t query_step,
+		const uint8_t* train, unsigned int train_rows, size_t train_step,
+		unsigned int bytes, std::vector<HammingNeighbours>* result);
+
+	/*
+	 * Searches both directions at once.
+	 *
+	 * query_result holds the two nearest train rows of every query row
+	 * and train_result the two nearest query rows of every train row.
+	 * Each distance is only computed once.
+	 */
+	void hamming_knn2_symmetric(const uint8_t* query, unsigned int query_rows, size_t query_step,
+		const uint8_t* train, unsigned int train_rows, size_t train_step, unsigned int bytes,
+		std::vector<HammingNeighbours>* query_result, std::vector<HammingNeighbours>* train_result);
+
+	// Converts a ratio to a fraction of HAMMING_RATIO_SCALE, rounding up so that ties still pass.
+	inline uint32_t hamming_ratio(double ratio) {
+		return ceil(ratio * HAMMING_RATIO_SCALE);
+	}
+
+	// Ratio test in the integer domain, the ratio is given as fraction of HAMMING_RATIO_SCALE.
+	inline bool hamming_ratio_test(const HammingNeighbours* n, uint32_t ratio) {
+		if (n->idx == HAMMING_NO_MATCH)
+			return false;
+
+		// Only one candidate.
+		if (n->second_idx == HAMMING_NO_MATCH)
+			return true;
+
+		return ((uint64_t)n->best * HAMMING_RATIO_SCALE <= (uint64_t)n->second * ratio);
+	}
+
+	uint32_t hamming_distance(const uint8_t* a, const uint8_t* b, unsigned int bytes);
+
+	// Returns the name of the implementation that is used on this CPU.
+	const char* hamming_implementation();
+};
+
+#endif
@@ -21,14 +21,17 @@
 #define BOXES_IMAGE_H
 
 #include <opencv2/opencv.hpp>
+#include <functional>
 #include <map>
 #include <string>
 #include <vector>
 
 #include <boxes/forward_declarations.h>
 #include <boxes/boxes.h>
+#include <boxes/cache.h>
 #include <boxes/camera_matrix.h>
 #include <boxes/constants.h>
+#include <boxes/descriptor_index.h>
 #include <boxes/point_cloud.h>
 
 #include <moges/Types.h>
@@ -52,20 +55,33 @@ namespace Boxes {
 
 			// mat
 			const cv::Mat* get_mat() const;
-			const cv::Mat* get_mat(int code) const;
-			const cv::Mat* get_greyscale_mat() const;
+			const cv::Mat* get_mat(int code);
+			const cv::Mat* get_greyscale_mat();
 
-			// descriptors
-			cv::Mat* get_descriptors(std::vector<cv::KeyPoint>* keypoints) const;
-			cv::Mat* get_descriptors(std::vector<cv::KeyPoint>* keypoints, const std::string detector_type) const;
-
-			// keypoints
-			std::vector<cv::KeyPoint>* get_keypoints();
-			std::vector<cv::KeyPoint>* get_keypoints(const std::string detector_type);
+			// image pyramids, built by compute on the first lookup of a key
+			const std::vector<cv::Mat>* get_pyramid(const std::string key,
+				std::function<std::vector<cv::Mat>*()> compute);
+			void release_pyramid(const std::string key);
 
-			// (good) features
+			// descriptors
+			const cv::Mat* get_descriptors();
+			const cv::Mat* get_descriptors(const std::string detector_type, const std::string extractor_type);
+			unsigned int get_descriptor_cache_hits() const;
+			unsigned int get_descriptor_cache_misses() const;
+
+			// descriptor index
+			DescriptorIndex* get_descriptor_index();
+			DescriptorIndex* get_descriptor_index(const std::string detector_type, const std::string extractor_type,
+				const std::string matcher_type);
+
+			// keypoints, the ones with descriptors if an extractor is given
+			const std::vector<cv::KeyPoint>* get_keypoints();
+			const std::vector<cv::KeyPoint>* get_keypoints(const std::string detector_type);
+			const std::vector<cv::KeyPoint>* get_keypoints(const std::string detector_type, const std::string extractor_type);
+
+			// (good) features, only where mask is not zero if given
 			std::vector<cv::Point2f> get_good_features_to_track(int max_corners = 1500, double quality_level = 0.05,
-				double min_distance = 2.0);
+				double min_distance = 2.0, const cv::Mat* mask = NULL);
 
 			// distance
 			void set_distance(unsigned int distance);
@@ -110,9 +126,27 @@ namespace Boxes {
 			// distance
 			unsigned int distance = 0;
 
+			// converted mat cache
+			Cache<cv::Mat> mats;
+
+			// pyramid cache
+			Cache<std::vector<cv::Mat>> pyramids;
+
 			// keypoint cache
-			std::map<std::string, std::vector<cv::KeyPoint>*> keypoints;
+			Cache<std::vector<cv::KeyPoint>> keypoints;
 			std::vector<cv::KeyPoint>* compute_keypoints(const std::string detector_type = DEFAULT_FEATURE_DETECTOR) const;
+
+			// descriptor cache, which holds the keypoints that the descriptors belong to
+			struct Features {
+				std::vector<cv::KeyPoint> keypoints;
+				cv::Mat descriptors;
+			};
+			Cache<Features> features;
+			Features* get_features(const std::string detector_type, const std::string extractor_type);
+			Features* compute_features(const std::vector<cv::KeyPoint>* keypoints, const std::string extractor_type) const;
+
+			// descriptor index cache
+			Cache<DescriptorIndex> descriptor_indices;
 	};
 };
 
@@ -0,0 +1,63 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifndef BOXES_MATCH_TABLE_H
+#define BOXES_MATCH_TABLE_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include <boxes/structs.h>
+
+namespace Boxes {
+	/*
+	 * All matches of an image pair, stored column by column.
+	 *
+	 * The coordinates can be passed to OpenCV as they are and the
+	 * keypoint indices make looking up a match constant time.
+	 */
+	class MatchTable {
+		public:
+			std::vector<cv::Point2f> points1;
+			std::vector<cv::Point2f> points2;
+
+			// Keypoint indices in both images, MATCH_NO_KEYPOINT for optical flow matches.
+			std::vector<int> query_indices;
+			std::vector<int> train_indices;
+
+			std::vector<float> distances;
+
+			unsigned int size() const;
+			bool empty() const;
+
+			void clear();
+			void reserve(unsigned int n);
+
+			void add(const MatchPoint* match);
+			void add(const cv::Point2f& pt1, const cv::Point2f& pt2, int queryIdx, int trainIdx, float distance = 0.0);
+
+			MatchPoint get(unsigned int i) const;
+			bool has_keypoints(unsigned int i) const;
+
+			// Removes all matches that have a zero in mask.
+			void filter(const std::vector<uchar>* mask);
+	};
+};
+
+#endif
@@ -22,12 +22,36 @@
 
 #include <vector>
 
+#include <boxes/bundle_adjustment.h>
 #include <boxes/feature_matcher.h>
+#include <boxes/feature_tracker.h>
 #include <boxes/image.h>
 #include <boxes/multi_camera.h>
 #include <boxes/point_cloud.h>
+#include <boxes/ransac.h>
+#include <boxes/tracks.h>
 
 namespace Boxes {
+	/*
+	 * A range of consecutive image pairs that is reconstructed on its own.
+	 *
+	 * poses holds the poses of the images of the pairs [first, last) in
+	 * the coordinate system of the first image of the chunk.
+	 */
+	struct ReconstructionChunk {
+		unsigned int first = 0;
+		unsigned int last = 0;
+
+		std::vector<cv::Matx34d> poses;
+		std::vector<BundleAdjustmentResult> bundle_adjustment_results;
+
+		// The tracks of the last bundle adjustment with their refined points.
+		Tracks tracks;
+
+		// A pair of the chunk could not be reconstructed, all following pairs are skipped.
+		bool failed = false;
+	};
+
 	class MultiCamera {
 		public:
 			MultiCamera(Boxes* boxes);
@@ -40,6 +64,9 @@ namespace Boxes {
 
 			FeatureMatcher* get_feature_matcher(unsigned int index) const;
 
+			// The tracker of the last run in sequence tracking mode, NULL otherwise.
+			FeatureTracker* get_feature_tracker() const;
+
 			void run(bool use_optical_flow);
 
 			void write_matches_all(const std::string* filename) const;
@@ -54,12 +81,16 @@ namespace Boxes {
 
 			PointCloud* get_point_cloud() const;
 
+			// Convergence and timing of every bundle adjustment of the last run.
+			const std::vector<BundleAdjustmentResult>* get_bundle_adjustment_results() const;
+
 			double mean_reprojection_error;
 
 		protected:
 			Boxes* boxes = NULL;
 
 			std::vector<FeatureMatcher*> feature_matchers;
+			FeatureTracker* feature_tracker = NULL;
 
 			std::vector<Image*> images;
 			void add_image(Image* image);
@@ -69,6 +100,26 @@ namespace Boxes {
 
 			FeatureMatcher* match(Image* image1, Image* image2, bool optical_flow) const;
 
+			// The image with the given index in the sequence of image pairs.
+			Image* chain_image(unsigned int index) const;
+
+			// Chains the pose of pair n to the pairs before it in its chunk and triangulates its points.
+			void reconstruct_pair(ReconstructionChunk* chunk, unsigned int n);
+
+			// The pose of the second image of pair n from the relative pose of the pair alone.
+			cv::Matx34d chain_relative_pose(const ReconstructionChunk* chunk, unsigned int n) const;
+
+			// The similarity that maps chunk2 into the coordinate system of chunk1 by their shared image.
+			RansacModel align_chunks(const ReconstructionChunk* chunk1, const ReconstructionChunk* chunk2) const;
+			void transform_chunk(ReconstructionChunk* chunk, const RansacModel* similarity);
+
+			// Links the points of the first n pairs of a chunk into tracks and triangulates them.
+			void build_tracks(const ReconstructionChunk* chunk, unsigned int n, Tracks* tracks) const;
+
+			// Refines the cameras and points of the first n pairs of a chunk together.
+			std::vector<BundleAdjustmentResult> bundle_adjustment_results;
+			void bundle_adjust(ReconstructionChunk* chunk, unsigned int n);
+
 			std::pair<pcl::PolygonMesh, std::pair<pcl::PointXYZ, pcl::PointXYZ>>
 				make_camera_polygon(Image* image, uint8_t r, uint8_t g, uint8_t b, double s) const;
 	};
@@ -0,0 +1,153 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifndef BOXES_OPTICAL_FLOW_H
+#define BOXES_OPTICAL_FLOW_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include <boxes/config.h>
+#include <boxes/forward_declarations.h>
+#include <boxes/scheduler.h>
+
+namespace Boxes {
+	/*
+	 * Calculates how the pixels of one greyscale image moved in another.
+	 *
+	 * Dense engines calculate the flow of every pixel, sparse engines
+	 * only follow the points they are given. Engines are chosen by the
+	 * names from constants.h and tuned with the settings of their own.
+	 *
+	 * Engines work on pyramids of the images in a layout of their own.
+	 * Images keep them, so that an image that is part of several pairs
+	 * only gets its pyramid built once.
+	 */
+	class OpticalFlow {
+		public:
+			OpticalFlow(Scheduler* scheduler) : scheduler(scheduler) {};
+			virtual ~OpticalFlow() {};
+
+			// Creates the engine that the settings ask for.
+			static OpticalFlow* create(const Settings& settings, Scheduler* scheduler);
+
+			virtual bool is_dense() const = 0;
+
+			// The pyramid of the image for this engine, built on first use.
+			const std::vector<cv::Mat>* get_pyramid(Image* image) const;
+			virtual std::vector<cv::Mat>* build_pyramid(const cv::Mat* greyscale) const = 0;
+
+			// Frees the pyramid of an image that is not going to be used again.
+			void release_pyramid(Image* image) const;
+
+			// Flow of every pixel of the first image as CV_32FC2, only for dense engines.
+			virtual void calculate(const std::vector<cv::Mat>* pyramid1, const std::vector<cv::Mat>* pyramid2,
+				cv::Mat* flow) const;
+
+			// Where points1 went in the second image. Points with a status of 0 were lost.
+			virtual void track(const std::vector<cv::Mat>* pyramid1, const std::vector<cv::Mat>* pyramid2,
+				const std::vector<cv::Point2f>* points1, std::vector<cv::Point2f>* points2,
+				std::vector<uchar>* status) const;
+
+		protected:
+			Scheduler* scheduler = NULL;
+
+			// Tells pyramids of different engines and parameters apart.
+			virtual std::string pyramid_key() const = 0;
+	};
+
+	class OpticalFlowFarneback: public OpticalFlow {
+		public:
+			OpticalFlowFarneback(const Settings& settings, Scheduler* scheduler);
+
+			bool is_dense() const { return true; };
+
+			// OpenCV builds the pyramids itself, so this is only the image.
+			std::vector<cv::Mat>* build_pyramid(const cv::Mat* greyscale) const;
+			void calculate(const std::vector<cv::Mat>* pyramid1, const std::vector<cv::Mat>* pyramid2,
+				cv::Mat* flow) const;
+
+		protected:
+			std::string pyramid_key() const;
+
+		private:
+			double pyramid_scale;
+			int levels;
+			int window_size;
+			int iterations;
+			int poly_n;
+			double poly_sigma;
+	};
+
+	class OpticalFlowLucasKanade: public OpticalFlow {
+		public:
+			OpticalFlowLucasKanade(const Settings& settings, Scheduler* scheduler);
+
+			bool is_dense() const { return false; };
+
+			// The pyramid of cv::buildOpticalFlowPyramid() with its derivatives.
+			std::vector<cv::Mat>* build_pyramid(const cv::Mat* greyscale) const;
+			void track(const std::vector<cv::Mat>* pyramid1, const std::vector<cv::Mat>* pyramid2,
+				const std::vector<cv::Point2f>* points1, std::vector<cv::Point2f>* points2,
+				std::vector<uchar>* status) const;
+
+		protected:
+			std::string pyramid_key() const;
+
+		private:
+			int window_size;
+			int levels;
+			double max_error;
+	};
+
+	/*
+	 * Coarse-to-fine dense flow from patches.
+	 *
+	 * On every level of an image pyramid, square patches on a regular grid
+	 * are aligned to the second image by an inverse compositional search,
+	 * starting from the flow of the level above. The flow of a pixel is the
+	 * mean of the patches that cover it, weighted by how well they fit.
+	 */
+	class OpticalFlowPatch: public OpticalFlow {
+		public:
+			OpticalFlowPatch(const Settings& settings, Scheduler* scheduler);
+
+			bool is_dense() const { return true; };
+
+			// Every level is the image and its derivatives in x and y as CV_32F, finest first.
+			std::vector<cv::Mat>* build_pyramid(const cv::Mat* greyscale) const;
+			void calculate(const std::vector<cv::Mat>* pyramid1, const std::vector<cv::Mat>* pyramid2,
+				cv::Mat* flow) const;
+
+		protected:
+			std::string pyramid_key() const;
+
+		private:
+			int patch_size;
+			int stride;
+			int levels;
+			int iterations;
+
+			void calculate_level(const cv::Mat* image1, const cv::Mat* dx, const cv::Mat* dy,
+				const cv::Mat* image2, const cv::Mat* initial, cv::Mat* flow) const;
+	};
+};
+
+#endif
@@ -27,6 +27,7 @@ INCLUDE_IGNORE_WARNINGS_BEGIN
 #include <pcl/surface/convex_hull.h>
 INCLUDE_IGNORE_WARNINGS_END
 
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -44,6 +45,7 @@ namespace Boxes {
 			~PointCloud();
 
 			void add_point(CloudPoint point);
+			void add_points(const std::vector<CloudPoint>* points);
 			void remove_point(const CloudPoint* point);
 			void cut_curve(const Image* image);
 			const std::vector<CloudPoint>* get_points() const;
@@ -81,7 +83,8 @@ namespace Boxes {
 			double scale = 1;
 			std::vector<CloudPoint> points;
 
-			// Convex hull
+			// Convex hull, computed once by whichever thread asks first.
+			std::mutex convex_hull_mutex;
 			pcl::ConvexHull<pcl::PointXYZRGB>* convex_hull = NULL;
 			pcl::PolygonMesh* convex_hull_mesh = NULL;
 			void compute_convex_hull(pcl::ConvexHull<pcl::PointXYZRGB>* convex_hull, pcl::PolygonMesh* convex_hull_mesh) const;
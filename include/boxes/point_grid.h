@@ -0,0 +1,74 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifndef BOXES_POINT_GRID_H
+#define BOXES_POINT_GRID_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Average number of points per cell, if no cell size is given.
+#define POINT_GRID_POINTS_PER_CELL 4
+
+namespace Boxes {
+	/*
+	 * A uniform bucket grid over a set of 2D points.
+	 *
+	 * The points of each cell are stored next to each other, so that a
+	 * query only touches the cells it overlaps.
+	 */
+	class PointGrid {
+		public:
+			PointGrid(const std::vector<cv::Point2f>* points, float cell_size = 0.0);
+
+			unsigned int size() const;
+
+			// Finds all points that are at most distance away from the line a*x + b*y + c = 0.
+			void query_line(const cv::Vec3d& line, double distance, std::vector<int>* result) const;
+
+			// Finds all points that are at most radius away from center.
+			void query_radius(const cv::Point2f& center, float radius, std::vector<int>* result) const;
+
+			// Finds the k points closest to center that are at most radius away, closest first.
+			// The trainIdx of each match is the index of the point.
+			void query_nearest(const cv::Point2f& center, float radius, unsigned int k,
+				std::vector<cv::DMatch>* result) const;
+
+		private:
+			std::vector<cv::Point2f> points;
+
+			cv::Point2f origin;
+			float cell_size;
+			int cols;
+			int rows;
+
+			// The points of cell i are cell_points[cell_start[i]] to cell_points[cell_start[i + 1] - 1].
+			std::vector<unsigned int> cell_start;
+			std::vector<int> cell_points;
+
+			int get_col(float x) const;
+			int get_row(float y) const;
+
+			// Calls function for the index of every point within radius of center.
+			template <typename Function>
+			void for_each_in_radius(const cv::Point2f& center, float radius, Function function) const;
+	};
+};
+
+#endif
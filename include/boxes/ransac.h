@@ -0,0 +1,159 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifndef BOXES_RANSAC_H
+#define BOXES_RANSAC_H
+
+#include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <vector>
+
+#include <boxes/config.h>
+#include <boxes/scheduler.h>
+
+// Number of correspondences whose errors are computed at once.
+#define RANSAC_BLOCK_SIZE           256
+
+// Number of samples that are drawn and scored in parallel.
+#define RANSAC_BATCH_SIZE            16
+
+#define RANSAC_MAX_SAMPLE_SIZE        8
+#define RANSAC_MAX_MODELS            10
+
+namespace Boxes {
+	/*
+	 * A model that is fitted by RANSAC.
+	 *
+	 * Fundamental and essential matrices and homographies only use
+	 * matrix. A camera pose uses matrix as rotation and translation.
+	 */
+	struct RansacModel {
+		cv::Matx33d matrix;
+		cv::Vec3d translation;
+	};
+
+	struct RansacParameters {
+		RansacParameters(const Settings& settings, double threshold);
+
+		// Largest error of an inlier, in the unit of the estimator.
+		double threshold;
+
+		double confidence;
+		unsigned int max_iterations;
+		uint64_t seed;
+
+		// Draw the best correspondences first.
+		bool prosac;
+
+		// Stop scoring a model as soon as it is unlikely to be good.
+		bool sprt;
+
+		// Refit every new best model to its inliers.
+		bool local_optimization;
+	};
+
+	struct RansacResult {
+		unsigned int iterations = 0;
+		unsigned int inliers = 0;
+
+		// Number of scored models and how many of them SPRT rejected early.
+		unsigned int models = 0;
+		unsigned int rejected = 0;
+
+		unsigned int local_optimizations = 0;
+	};
+
+	/*
+	 * A kind of model that can be estimated with RANSAC.
+	 *
+	 * An estimator owns the correspondences, preferably as struct of
+	 * arrays, so that errors() can compute a whole block at once.
+	 */
+	class RansacEstimator {
+		public:
+			RansacEstimator(unsigned int n);
+			virtual ~RansacEstimator() {};
+
+			// Number of correspondences.
+			unsigned int size() const;
+
+			virtual unsigned int sample_size() const = 0;
+
+			// Fits all models to a minimal sample and returns their number.
+			virtual unsigned int fit_minimal(const unsigned int* sample, RansacModel* models) const = 0;
+
+			// Fits one model to n correspondences, model holds an initial guess.
+			virtual bool fit(const unsigned int* indices, unsigned int n, RansacModel* model) const = 0;
+
+			// Writes the squared errors of the correspondences [start, start + count).
+			virtual void errors(const RansacModel* model, unsigned int start, unsigned int count, double* errors) const = 0;
+
+		protected:
+			unsigned int n;
+	};
+
+	/*
+	 * RANSAC with PROSAC sampling, SPRT model verification and local
+	 * optimization of the best model.
+	 *
+	 * Samples are drawn in order and scored in parallel on the scheduler
+	 * in batches of RANSAC_BATCH_SIZE, so that the result does not depend
+	 * on the number of threads.
+	 */
+	class Ransac {
+		public:
+			Ransac(const RansacEstimator* estimator, const RansacParameters& parameters, Scheduler* scheduler);
+
+			// order lists the correspondences from best to worst for PROSAC and may be NULL.
+			RansacResult run(RansacModel* model, std::vector<uchar>* mask, const std::vector<unsigned int>* order = NULL);
+
+		private:
+			const RansacEstimator* estimator;
+			RansacParameters parameters;
+			Scheduler* scheduler = NULL;
+
+			// PROSAC
+			const std::vector<unsigned int>* order = NULL;
+			unsigned int prosac_n = 0;
+			double prosac_t = 0.0;
+			double prosac_t_prime = 0.0;
+
+			// SPRT
+			double sprt_epsilon = 0.0;
+			double sprt_delta = 0.0;
+			double sprt_threshold = 0.0;
+
+			// Whether good models are more consistent than bad ones, only then is sprt_threshold set.
+			bool sprt_decisive = false;
+
+			void draw_sample(cv::RNG* rng, unsigned int iteration, unsigned int* sample);
+			void update_sprt_threshold();
+
+			unsigned int score(const RansacModel* model, double threshold, bool sprt, bool* rejected, unsigned int* tested) const;
+			unsigned int local_optimization(RansacModel* model, unsigned int inliers) const;
+	};
+
+	// Number of RANSAC iterations that find an all-inlier sample with the given confidence.
+	unsigned int ransac_iterations(double inlier_ratio, unsigned int sample_size, double confidence, unsigned int max_iterations);
+
+	// Indices of all values, sorted in ascending order.
+	void ransac_order(const std::vector<float>* values, std::vector<unsigned int>* order);
+};
+
+#endif
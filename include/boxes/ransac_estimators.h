@@ -0,0 +1,131 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifndef BOXES_RANSAC_ESTIMATORS_H
+#define BOXES_RANSAC_ESTIMATORS_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include <boxes/ransac.h>
+
+namespace Boxes {
+	/*
+	 * Correspondences of two images as struct of arrays.
+	 *
+	 * x1, y1, x2 and y2 are the coordinates that errors are measured in.
+	 * u1, v1, u2 and v2 are the same points moved to their centroid and
+	 * scaled to a mean distance of sqrt(2) for the linear solvers. T1 and
+	 * T2 map x to u.
+	 */
+	class PointCorrespondences: public RansacEstimator {
+		public:
+			PointCorrespondences(const std::vector<cv::Point2f>* points1, const std::vector<cv::Point2f>* points2,
+				const cv::Matx33d* camera1 = NULL, const cv::Matx33d* camera2 = NULL);
+
+		protected:
+			std::vector<double> x1, y1, x2, y2;
+			std::vector<double> u1, v1, u2, v2;
+			cv::Matx33d T1, T2;
+
+			// Least squares solution of F with u2^T * F * u1 = 0.
+			bool fit_epipolar(const unsigned int* indices, unsigned int n, cv::Matx33d* F) const;
+
+			// The Sampson distance of every correspondence.
+			void sampson_errors(const cv::Matx33d* F, unsigned int start, unsigned int count, double* errors) const;
+	};
+
+	// Fundamental matrix from eight correspondences in pixels.
+	class FundamentalEstimator: public PointCorrespondences {
+		public:
+			FundamentalEstimator(const std::vector<cv::Point2f>* points1, const std::vector<cv::Point2f>* points2);
+
+			unsigned int sample_size() const;
+			unsigned int fit_minimal(const unsigned int* sample, RansacModel* models) const;
+			bool fit(const unsigned int* indices, unsigned int n, RansacModel* model) const;
+			void errors(const RansacModel* model, unsigned int start, unsigned int count, double* errors) const;
+	};
+
+	// Essential matrix from five correspondences, errors are in normalized coordinates.
+	class EssentialEstimator: public PointCorrespondences {
+		public:
+			EssentialEstimator(const std::vector<cv::Point2f>* points1, const std::vector<cv::Point2f>* points2,
+				const cv::Matx33d* camera1, const cv::Matx33d* camera2);
+
+			unsigned int sample_size() const;
+			unsigned int fit_minimal(const unsigned int* sample, RansacModel* models) const;
+			bool fit(const unsigned int* indices, unsigned int n, RansacModel* model) const;
+			void errors(const RansacModel* model, unsigned int start, unsigned int count, double* errors) const;
+	};
+
+	// Homography from four correspondences, errors are transfer errors in the second image.
+	class HomographyEstimator: public PointCorrespondences {
+		public:
+			HomographyEstimator(const std::vector<cv::Point2f>* points1, const std::vector<cv::Point2f>* points2);
+
+			unsigned int sample_size() const;
+			unsigned int fit_minimal(const unsigned int* sample, RansacModel* models) const;
+			bool fit(const unsigned int* indices, unsigned int n, RansacModel* model) const;
+			void errors(const RansacModel* model, unsigned int start, unsigned int count, double* errors) const;
+	};
+
+	// Camera pose from 3D points and their projections, errors are reprojection errors in pixels.
+	class PnPEstimator: public RansacEstimator {
+		public:
+			PnPEstimator(const std::vector<cv::Point3f>* object_points, const std::vector<cv::Point2f>* image_points,
+				const cv::Matx33d* camera);
+
+			unsigned int sample_size() const;
+			unsigned int fit_minimal(const unsigned int* sample, RansacModel* models) const;
+			bool fit(const unsigned int* indices, unsigned int n, RansacModel* model) const;
+			void errors(const RansacModel* model, unsigned int start, unsigned int count, double* errors) const;
+
+		private:
+			const std::vector<cv::Point3f>* object_points;
+			const std::vector<cv::Point2f>* image_points;
+			cv::Matx33d camera;
+
+			std::vector<double> X, Y, Z;
+			std::vector<double> u, v;
+
+			bool solve(const unsigned int* indices, unsigned int n, int flags, RansacModel* model) const;
+	};
+
+	/*
+	 * Similarity transform from three pairs of 3D points.
+	 *
+	 * The model maps points1 onto points2 with scale * rotation as matrix
+	 * and translation. Errors are squared distances in the unit of points2.
+	 */
+	class SimilarityEstimator: public RansacEstimator {
+		public:
+			SimilarityEstimator(const std::vector<cv::Point3d>* points1, const std::vector<cv::Point3d>* points2);
+
+			unsigned int sample_size() const;
+			unsigned int fit_minimal(const unsigned int* sample, RansacModel* models) const;
+			bool fit(const unsigned int* indices, unsigned int n, RansacModel* model) const;
+			void errors(const RansacModel* model, unsigned int start, unsigned int count, double* errors) const;
+
+		private:
+			std::vector<double> X1, Y1, Z1;
+			std::vector<double> X2, Y2, Z2;
+	};
+};
+
+#endif
@@ -0,0 +1,115 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifndef BOXES_SCHEDULER_H
+#define BOXES_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Boxes {
+	typedef std::function<void()> Task;
+
+	/*
+	 * Tasks that are waited for together.
+	 *
+	 * Scheduler::wait() rethrows the first exception of any of them.
+	 */
+	class TaskGroup {
+		public:
+			TaskGroup();
+
+		private:
+			friend class Scheduler;
+
+			std::atomic<unsigned int> pending;
+
+			std::mutex mutex;
+			std::exception_ptr error;
+	};
+
+	/*
+	 * A pool of threads that run tasks.
+	 *
+	 * Every worker has a queue of its own and runs its newest task first.
+	 * Workers without tasks steal the oldest task of another queue.
+	 * Threads that wait for a group run other tasks in the meantime, so
+	 * tasks may start and wait for more tasks without blocking a worker.
+	 *
+	 * OpenMP loops and OpenCV run on one thread inside of tasks, also
+	 * when the waiting thread runs them, so that nested parallelism does
+	 * not use more threads than the pool has.
+	 */
+	class Scheduler {
+		public:
+			// Uses one thread per core if threads is 0. The calling thread counts as one of them.
+			Scheduler(unsigned int threads = 0);
+			~Scheduler();
+
+			// Number of threads, including the one that waits.
+			unsigned int size() const;
+
+			void run(TaskGroup* group, Task task);
+			void wait(TaskGroup* group);
+
+			// Calls function(i) for all i in [begin, end), with grain indices per task.
+			void parallel_for(unsigned int begin, unsigned int end, unsigned int grain,
+				std::function<void(unsigned int)> function);
+
+		private:
+			struct Job {
+				Task task;
+				TaskGroup* group;
+			};
+
+			struct Queue {
+				std::mutex mutex;
+				std::deque<Job> jobs;
+			};
+
+			unsigned int threads;
+			int opencv_threads;
+
+			// One queue per worker, the last one is shared by all other threads.
+			std::vector<Queue*> queues;
+			std::vector<std::thread> workers;
+
+			std::atomic<unsigned int> queued;
+
+			std::mutex sleep_mutex;
+			std::condition_variable sleep;
+			bool stopping = false;
+
+			unsigned int current_queue() const;
+
+			bool find(Job* job);
+			void execute(Job* job);
+			void notify();
+
+			void work(unsigned int index);
+	};
+};
+
+#endif
@@ -22,11 +22,18 @@
 
 #include <opencv2/opencv.hpp>
 
+// Marks matches that do not belong to a keypoint, like optical flow matches.
+#define MATCH_NO_KEYPOINT -1
+
 namespace Boxes {
 	struct MatchPoint {
 		cv::Point2f pt1;
 		cv::Point2f pt2;
 
+		// Indices of the keypoints in both images.
+		int queryIdx = MATCH_NO_KEYPOINT;
+		int trainIdx = MATCH_NO_KEYPOINT;
+
 		double distance = 0.0;
 	};
 };
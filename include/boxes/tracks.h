@@ -0,0 +1,108 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifndef BOXES_TRACKS_H
+#define BOXES_TRACKS_H
+
+#include <map>
+#include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boxes/scheduler.h>
+
+namespace Boxes {
+	/*
+	 * Feature tracks across many images.
+	 *
+	 * Pairwise matches are linked with union-find, so that every track
+	 * holds all observations of one physical point. Observations are
+	 * identified by their image and keypoint, or by their coordinates if
+	 * they have no keypoint (optical flow). Tracks that see the same image
+	 * twice are inconsistent and dropped.
+	 *
+	 * The tracks are stored as struct of arrays: the observations of
+	 * track t are [offsets[t], offsets[t + 1]), sorted by image.
+	 */
+	class Tracks {
+		public:
+			void add_match(unsigned int image1, int keypoint1, const cv::Point2f* pt1,
+				unsigned int image2, int keypoint2, const cv::Point2f* pt2);
+
+			// Groups all observations into tracks, must be called after the last match.
+			void build();
+
+			unsigned int size() const;
+			unsigned int observation_count() const;
+
+			// The track of an observation, or -1.
+			int find(unsigned int image, int keypoint, const cv::Point2f* pt) const;
+
+			/*
+			 * Triangulates all tracks from all their observations.
+			 *
+			 * cameras and poses are indexed by image. Tracks that cannot
+			 * be triangulated are marked as invalid.
+			 */
+			void triangulate(const std::vector<cv::Matx33d>* cameras, const std::vector<cv::Matx34d>* poses,
+				Scheduler* scheduler);
+
+			/*
+			 * Updates the reprojection errors after points or poses have
+			 * changed, e.g. by bundle adjustment. Tracks that are no longer
+			 * in front of all their cameras are marked as invalid.
+			 */
+			void reproject(const std::vector<cv::Matx33d>* cameras, const std::vector<cv::Matx34d>* poses,
+				Scheduler* scheduler);
+
+			std::vector<unsigned int> offsets;
+			std::vector<unsigned int> images;
+			std::vector<int> keypoints;
+			std::vector<cv::Point2f> coordinates;
+
+			// Results of triangulate() and reproject(), mean reprojection error in pixels.
+			std::vector<cv::Point3d> points;
+			std::vector<double> reprojection_errors;
+			std::vector<uchar> valid;
+
+		private:
+			// Observations as nodes of the union-find forest.
+			std::vector<unsigned int> node_images;
+			std::vector<int> node_keypoints;
+			std::vector<cv::Point2f> node_coordinates;
+
+			std::vector<unsigned int> parents;
+			std::vector<unsigned int> ranks;
+
+			std::unordered_map<uint64_t, unsigned int> keypoint_nodes;
+			std::map<std::pair<unsigned int, uint64_t>, unsigned int> coordinate_nodes;
+
+			// Track of every node after build(), or -1.
+			std::vector<int> node_tracks;
+
+			int find_node(unsigned int image, int keypoint, const cv::Point2f* pt) const;
+			unsigned int add_node(unsigned int image, int keypoint, const cv::Point2f* pt);
+			unsigned int find_root(unsigned int node);
+			void unite(unsigned int node1, unsigned int node2);
+	};
+};
+
+#endif
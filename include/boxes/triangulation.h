@@ -0,0 +1,78 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifndef BOXES_TRIANGULATION_H
+#define BOXES_TRIANGULATION_H
+
+#include <opencv2/opencv.hpp>
+
+// Number of points that are triangulated side by side.
+#define TRIANGULATION_BATCH_SIZE 8
+
+// Number of batches that one task of the scheduler triangulates.
+#define TRIANGULATION_BATCHES_PER_TASK 64
+
+namespace Boxes {
+	/*
+	 * Two-view triangulation.
+	 *
+	 * This is the iterative linear method of Hartley and Sturm. The 4x3
+	 * system is solved through its normal equations, which is accurate
+	 * enough on normalized image coordinates and needs no allocations.
+	 */
+
+	// Triangulates one correspondence given in normalized image coordinates.
+	// Returns false if the correspondence is degenerate (e.g. parallel rays).
+	bool triangulate_correspondence(const cv::Vec2d& x1, const cv::Matx34d& p1, const cv::Vec2d& x2, const cv::Matx34d& p2,
+		cv::Vec3d* point);
+
+	/*
+	 * Triangulates n correspondences given in pixel coordinates.
+	 *
+	 * Writes the points, their reprojection errors in the second image
+	 * and whether they could be triangulated at all to the n first
+	 * elements of points, reprojection_errors and valid. Degenerate
+	 * correspondences do not give a usable point and must be dropped.
+	 */
+	void triangulate_correspondences(const cv::Point2f* points1, const cv::Point2f* points2, unsigned int n,
+		const cv::Matx33d& camera1, const cv::Matx34d& p1, const cv::Matx33d& camera2, const cv::Matx34d& p2,
+		cv::Point3d* points, double* reprojection_errors, uchar* valid);
+
+	/*
+	 * Triangulates one point that is seen by n cameras.
+	 *
+	 * x holds the observations in normalized image coordinates and poses
+	 * the matching camera matrices. This is the same iterative linear
+	 * method as above with one pair of equations per camera. Returns
+	 * false if the point is degenerate or behind one of the cameras.
+	 */
+	bool triangulate_views(const cv::Vec2d* x, const cv::Matx34d* poses, unsigned int n, cv::Vec3d* point);
+
+	/*
+	 * Counts the correspondences that are in front of both cameras.
+	 *
+	 * The first camera is [I|0], every element of candidates is a
+	 * possible second camera. All correspondences are tested against all
+	 * candidates in one pass and the counts are written to counts.
+	 */
+	void count_points_in_front(const cv::Vec2d* x1, const cv::Vec2d* x2, unsigned int n,
+		const cv::Matx34d* candidates, unsigned int candidate_count, unsigned int* counts);
+};
+
+#endif
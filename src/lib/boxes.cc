@@ -18,7 +18,9 @@
 ***/
 
 #include <list>
+#include <mutex>
 #include <opencv2/opencv.hpp>
+#include <stdexcept>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -27,7 +29,9 @@
 #include <boxes/config.h>
 #include <boxes/feature_matcher.h>
 #include <boxes/feature_matcher_optical_flow.h>
+#include <boxes/feature_registry.h>
 #include <boxes/image.h>
+#include <boxes/scheduler.h>
 #include <boxes/util.h>
 
 namespace Boxes {
@@ -37,9 +41,14 @@ namespace Boxes {
 	 */
 	Boxes::Boxes() {
 		this->config = new Config();
+		this->features = new FeatureRegistry(this);
 	}
 
 	Boxes::~Boxes() {
+		if (this->scheduler)
+			delete this->scheduler;
+
+		delete this->features;
 		delete this->config;
 	}
 
@@ -86,6 +95,70 @@ namespace Boxes {
 		}
 	}
 
+	/*
+	 * Compiles the configuration into a typed snapshot. This must be
+	 * called again after the configuration has been changed.
+	 *
+	 * Throws std::runtime_error if the configuration is invalid.
+	 */
+	const Settings& Boxes::compile_settings() {
+		std::lock_guard<std::mutex> lock(this->settings_mutex);
+
+		Settings settings = this->config->compile();
+
+		if (!this->features->has_detector(settings.feature_detector))
+			throw std::runtime_error("Unknown feature detector: " + settings.feature_detector);
+
+		if (!this->features->has_extractor(settings.feature_detector_extractor))
+			throw std::runtime_error("Unknown descriptor extractor: " + settings.feature_detector_extractor);
+
+		this->settings = settings;
+		this->settings_compiled = true;
+
+		// Make sure that all detectors and extractors use the new settings.
+		this->features->reset();
+
+		// Start a new pool with the new number of threads.
+		{
+			std::lock_guard<std::mutex> lock(this->scheduler_mutex);
+
+			if (this->scheduler && this->scheduler_threads != settings.threads) {
+				delete this->scheduler;
+				this->scheduler = NULL;
+			}
+		}
+
+		return this->settings;
+	}
+
+	/*
+	 * The pool is created on first use and replaced, if the number of
+	 * threads changes. Both must not happen while tasks are running.
+	 */
+	Scheduler* Boxes::get_scheduler() {
+		int threads = this->get_settings().threads;
+
+		std::lock_guard<std::mutex> lock(this->scheduler_mutex);
+
+		if (!this->scheduler) {
+			this->scheduler = new Scheduler(threads);
+			this->scheduler_threads = threads;
+		}
+
+		return this->scheduler;
+	}
+
+	const Settings& Boxes::get_settings() {
+		{
+			std::lock_guard<std::mutex> lock(this->settings_mutex);
+
+			if (this->settings_compiled)
+				return this->settings;
+		}
+
+		return this->compile_settings();
+	}
+
 	/*
 	 *
 	 */
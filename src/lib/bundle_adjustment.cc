@@ -0,0 +1,461 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include <boxes/bundle_adjustment.h>
+#include <boxes/constants.h>
+#include <boxes/scheduler.h>
+
+namespace Boxes {
+	typedef cv::Matx<double, 2, 6> Matx26d;
+	typedef cv::Matx<double, 6, 3> Matx63d;
+
+	// Huber loss of a squared error.
+	static inline double robust_cost(double squared_error) {
+		const double delta = BUNDLE_ADJUSTMENT_HUBER_DELTA;
+
+		if (squared_error <= delta * delta)
+			return squared_error;
+
+		return 2.0 * delta * sqrt(squared_error) - delta * delta;
+	}
+
+	// Weight of an observation so that the normal equations minimize the Huber loss.
+	static inline double robust_weight(double squared_error) {
+		const double delta = BUNDLE_ADJUSTMENT_HUBER_DELTA;
+
+		if (squared_error <= delta * delta)
+			return 1.0;
+
+		return delta / sqrt(squared_error);
+	}
+
+	// Projects X with K * [R|t], returns false if it is not in front of the camera.
+	static inline bool project(const cv::Matx33d& R, const cv::Vec3d& t, const cv::Matx33d& K,
+			const cv::Vec3d& X, cv::Vec3d* Xc, cv::Vec2d* x) {
+		*Xc = R * X + t;
+
+		if ((*Xc)[2] <= 0.0)
+			return false;
+
+		double z = 1.0 / (*Xc)[2];
+		double u = (*Xc)[0] * z;
+		double v = (*Xc)[1] * z;
+
+		*x = cv::Vec2d(K(0,0) * u + K(0,1) * v + K(0,2), K(1,1) * v + K(1,2));
+
+		return true;
+	}
+
+	/*
+	 * Contructor.
+	 */
+	BundleAdjuster::BundleAdjuster(unsigned int max_iterations, Scheduler* scheduler) {
+		this->max_iterations = max_iterations;
+		this->scheduler = scheduler;
+	}
+
+	unsigned int BundleAdjuster::add_camera(const cv::Matx34d* pose, const cv::Matx33d* camera, bool fixed) {
+		const cv::Matx34d& P = *pose;
+
+		this->rotations.push_back(cv::Matx33d(
+			P(0,0), P(0,1), P(0,2),
+			P(1,0), P(1,1), P(1,2),
+			P(2,0), P(2,1), P(2,2)
+		));
+		this->translations.push_back(cv::Vec3d(P(0,3), P(1,3), P(2,3)));
+		this->intrinsics.push_back(*camera);
+		this->fixed.push_back(fixed);
+
+		return this->rotations.size() - 1;
+	}
+
+	unsigned int BundleAdjuster::add_point(const cv::Point3d* point) {
+		this->points.push_back(cv::Vec3d(point->x, point->y, point->z));
+
+		return this->points.size() - 1;
+	}
+
+	void BundleAdjuster::add_observation(unsigned int camera, unsigned int point, const cv::Point2f* pt) {
+		this->observation_cameras.push_back(camera);
+		this->observation_points.push_back(point);
+		this->observation_coordinates.push_back(cv::Vec2d(pt->x, pt->y));
+	}
+
+	cv::Matx34d BundleAdjuster::get_pose(unsigned int camera) const {
+		const cv::Matx33d& R = this->rotations[camera];
+		const cv::Vec3d& t = this->translations[camera];
+
+		return cv::Matx34d(
+			R(0,0), R(0,1), R(0,2), t[0],
+			R(1,0), R(1,1), R(1,2), t[1],
+			R(2,0), R(2,1), R(2,2), t[2]
+		);
+	}
+
+	cv::Point3d BundleAdjuster::get_point(unsigned int point) const {
+		const cv::Vec3d& X = this->points[point];
+
+		return cv::Point3d(X[0], X[1], X[2]);
+	}
+
+	// Sorts the observations by point and by camera with a counting sort.
+	static void group(const std::vector<unsigned int>* keys, unsigned int key_count,
+			std::vector<unsigned int>* offsets, std::vector<unsigned int>* indices) {
+		offsets->assign(key_count + 1, 0);
+		indices->resize(keys->size());
+
+		for (unsigned int i = 0; i < keys->size(); i++)
+			(*offsets)[(*keys)[i] + 1]++;
+
+		for (unsigned int i = 0; i < key_count; i++)
+			(*offsets)[i + 1] += (*offsets)[i];
+
+		std::vector<unsigned int> next(offsets->begin(), offsets->end() - 1);
+		for (unsigned int i = 0; i < keys->size(); i++)
+			(*indices)[next[(*keys)[i]]++] = i;
+	}
+
+	void BundleAdjuster::index_observations() {
+		group(&this->observation_points, this->points.size(), &this->point_offsets, &this->point_observations);
+		group(&this->observation_cameras, this->rotations.size(), &this->camera_offsets, &this->camera_observations);
+	}
+
+	/*
+	 * Returns the robust cost of the given parameters and writes the sum
+	 * of the plain squared reprojection errors to squared_error.
+	 */
+	double BundleAdjuster::evaluate(const std::vector<cv::Matx33d>* rotations, const std::vector<cv::Vec3d>* translations,
+			const std::vector<cv::Vec3d>* points, double* squared_error) const {
+		int n = this->observation_points.size();
+
+		std::vector<double> costs(n);
+		std::vector<double> errors(n);
+
+		this->scheduler->parallel_for(0, n, BUNDLE_ADJUSTMENT_OBSERVATIONS_PER_TASK, [&](unsigned int o) {
+			unsigned int camera = this->observation_cameras[o];
+
+			cv::Vec3d Xc;
+			cv::Vec2d x;
+
+			if (project((*rotations)[camera], (*translations)[camera], this->intrinsics[camera],
+					(*points)[this->observation_points[o]], &Xc, &x)) {
+				cv::Vec2d r = x - this->observation_coordinates[o];
+				errors[o] = r.dot(r);
+			} else {
+				errors[o] = REPROJECTION_ERROR_MAX * REPROJECTION_ERROR_MAX;
+			}
+
+			costs[o] = robust_cost(errors[o]);
+		});
+
+		double cost = 0.0;
+		*squared_error = 0.0;
+
+		for (int o = 0; o < n; o++) {
+			cost += costs[o];
+			*squared_error += errors[o];
+		}
+
+		return cost;
+	}
+
+	/*
+	 * Computes the residual, its weight and the Jacobians of every observation.
+	 *
+	 * The rotation is updated with R <- exp(w) * R, so the derivative of the
+	 * point in camera coordinates is -[R * X]x by w and I by t.
+	 */
+	void BundleAdjuster::linearize(std::vector<cv::Vec2d>* residuals, std::vector<double>* weights,
+			std::vector<Matx26d>* camera_jacobians, std::vector<cv::Matx23d>* point_jacobians) const {
+		int n = this->observation_points.size();
+
+		this->scheduler->parallel_for(0, n, BUNDLE_ADJUSTMENT_OBSERVATIONS_PER_TASK, [&](unsigned int o) {
+			unsigned int camera = this->observation_cameras[o];
+			const cv::Matx33d& R = this->rotations[camera];
+			const cv::Matx33d& K = this->intrinsics[camera];
+
+			cv::Vec3d Xc;
+			cv::Vec2d x;
+
+			// Points behind the camera do not take part in this step.
+			if (!project(R, this->translations[camera], K, this->points[this->observation_points[o]], &Xc, &x)) {
+				(*residuals)[o] = cv::Vec2d(0.0, 0.0);
+				(*weights)[o] = 0.0;
+				(*camera_jacobians)[o] = Matx26d::zeros();
+				(*point_jacobians)[o] = cv::Matx23d::zeros();
+				return;
+			}
+
+			cv::Vec2d r = x - this->observation_coordinates[o];
+			(*residuals)[o] = r;
+			(*weights)[o] = robust_weight(r.dot(r));
+
+			double z = 1.0 / Xc[2];
+			double u = Xc[0] * z;
+			double v = Xc[1] * z;
+
+			// Derivative of the projection by the point in camera coordinates.
+			cv::Matx23d J(
+				K(0,0) * z, K(0,1) * z, -(K(0,0) * u + K(0,1) * v) * z,
+				0.0,        K(1,1) * z, -K(1,1) * v * z
+			);
+
+			cv::Vec3d RX = Xc - this->translations[camera];
+			cv::Matx33d skew(
+				0.0,    RX[2], -RX[1],
+				-RX[2], 0.0,    RX[0],
+				RX[1], -RX[0],  0.0
+			);
+			cv::Matx23d Jw = J * skew;
+
+			(*camera_jacobians)[o] = Matx26d(
+				Jw(0,0), Jw(0,1), Jw(0,2), J(0,0), J(0,1), J(0,2),
+				Jw(1,0), Jw(1,1), Jw(1,2), J(1,0), J(1,1), J(1,2)
+			);
+			(*point_jacobians)[o] = J * R;
+		});
+	}
+
+	BundleAdjustmentResult BundleAdjuster::run() {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		BundleAdjustmentResult result;
+		result.cameras = this->rotations.size();
+		result.points = this->points.size();
+		result.observations = this->observation_points.size();
+
+		if (result.observations == 0)
+			return result;
+
+		this->index_observations();
+
+		// Only free cameras have unknowns, the first six rows belong to the first free camera.
+		std::vector<int> camera_index(result.cameras, -1);
+		int free_cameras = 0;
+		for (unsigned int c = 0; c < result.cameras; c++) {
+			if (!this->fixed[c])
+				camera_index[c] = free_cameras++;
+		}
+
+		int n = result.observations;
+		int point_count = result.points;
+
+		std::vector<cv::Vec2d> residuals(n);
+		std::vector<double> weights(n);
+		std::vector<Matx26d> camera_jacobians(n);
+		std::vector<cv::Matx23d> point_jacobians(n);
+		std::vector<Matx63d> W(n);
+		std::vector<Matx63d> Y(n);
+
+		std::vector<cv::Matx66d> U(result.cameras);
+		std::vector<cv::Vec6d> camera_gradients(result.cameras);
+		std::vector<cv::Matx33d> V(point_count);
+		std::vector<cv::Matx33d> V_inv(point_count);
+		std::vector<cv::Vec3d> point_gradients(point_count);
+
+		std::vector<cv::Matx33d> new_rotations(result.cameras);
+		std::vector<cv::Vec3d> new_translations(result.cameras);
+		std::vector<cv::Vec3d> new_points(point_count);
+
+		double squared_error;
+		double cost = this->evaluate(&this->rotations, &this->translations, &this->points, &squared_error);
+		result.initial_error = sqrt(squared_error / n);
+
+		double lambda = BUNDLE_ADJUSTMENT_INITIAL_LAMBDA;
+
+		while (result.iterations < this->max_iterations && !result.converged) {
+			result.iterations++;
+
+			this->linearize(&residuals, &weights, &camera_jacobians, &point_jacobians);
+
+			// Camera blocks of the normal equations.
+			this->scheduler->parallel_for(0, result.cameras, BUNDLE_ADJUSTMENT_CAMERAS_PER_TASK, [&](unsigned int c) {
+				U[c] = cv::Matx66d::zeros();
+				camera_gradients[c] = cv::Vec6d::all(0.0);
+
+				for (unsigned int i = this->camera_offsets[c]; i < this->camera_offsets[c + 1]; i++) {
+					unsigned int o = this->camera_observations[i];
+					Matx26d& Jc = camera_jacobians[o];
+
+					U[c] += weights[o] * (Jc.t() * Jc);
+					camera_gradients[c] -= weights[o] * (Jc.t() * residuals[o]);
+				}
+			});
+
+			// Point blocks and the blocks that couple points and cameras.
+			this->scheduler->parallel_for(0, point_count, BUNDLE_ADJUSTMENT_POINTS_PER_TASK, [&](unsigned int p) {
+				V[p] = cv::Matx33d::zeros();
+				point_gradients[p] = cv::Vec3d(0.0, 0.0, 0.0);
+
+				for (unsigned int i = this->point_offsets[p]; i < this->point_offsets[p + 1]; i++) {
+					unsigned int o = this->point_observations[i];
+					cv::Matx23d& Jp = point_jacobians[o];
+
+					V[p] += weights[o] * (Jp.t() * Jp);
+					point_gradients[p] -= weights[o] * (Jp.t() * residuals[o]);
+					W[o] = weights[o] * (camera_jacobians[o].t() * Jp);
+				}
+			});
+
+			// Try steps with more and more damping until one of them lowers the cost.
+			while (true) {
+				this->scheduler->parallel_for(0, point_count, BUNDLE_ADJUSTMENT_POINTS_PER_TASK, [&](unsigned int p) {
+					cv::Matx33d damped = V[p];
+					for (unsigned int k = 0; k < 3; k++)
+						damped(k,k) += lambda * damped(k,k) + BUNDLE_ADJUSTMENT_MIN_DAMPING;
+
+					V_inv[p] = damped.inv(cv::DECOMP_CHOLESKY);
+
+					for (unsigned int i = this->point_offsets[p]; i < this->point_offsets[p + 1]; i++) {
+						unsigned int o = this->point_observations[i];
+						Y[o] = W[o] * V_inv[p];
+					}
+				});
+
+				/*
+				 * Reduced camera system S * dc = b with
+				 *   S_jk = U_jk - sum_p W_pj * V_p^-1 * W_pk^T
+				 *   b_j  = g_j - sum_p W_pj * V_p^-1 * g_p
+				 * Every task fills the rows of one camera.
+				 */
+				cv::Mat_<double> S = cv::Mat_<double>::zeros(6 * free_cameras, 6 * free_cameras);
+				cv::Mat_<double> b = cv::Mat_<double>::zeros(6 * free_cameras, 1);
+
+				this->scheduler->parallel_for(0, result.cameras, BUNDLE_ADJUSTMENT_CAMERAS_PER_TASK, [&](unsigned int c) {
+					int j = camera_index[c];
+					if (j < 0)
+						return;
+
+					cv::Matx66d Ujj = U[c];
+					for (unsigned int k = 0; k < 6; k++)
+						Ujj(k,k) += lambda * Ujj(k,k) + BUNDLE_ADJUSTMENT_MIN_DAMPING;
+
+					cv::Vec6d bj = camera_gradients[c];
+
+					for (unsigned int i = this->camera_offsets[c]; i < this->camera_offsets[c + 1]; i++) {
+						unsigned int o = this->camera_observations[i];
+						unsigned int p = this->observation_points[o];
+
+						bj -= Y[o] * point_gradients[p];
+
+						for (unsigned int l = this->point_offsets[p]; l < this->point_offsets[p + 1]; l++) {
+							unsigned int q = this->point_observations[l];
+							int k = camera_index[this->observation_cameras[q]];
+							if (k < 0)
+								continue;
+
+							cv::Matx66d block = Y[o] * W[q].t();
+							for (unsigned int r = 0; r < 6; r++) {
+								for (unsigned int s = 0; s < 6; s++)
+									S(6 * j + r, 6 * k + s) -= block(r,s);
+							}
+						}
+					}
+
+					for (unsigned int r = 0; r < 6; r++) {
+						for (unsigned int s = 0; s < 6; s++)
+							S(6 * j + r, 6 * j + s) += Ujj(r,s);
+
+						b(6 * j + r) = bj[r];
+					}
+				});
+
+				cv::Mat_<double> dc;
+				bool solved = (free_cameras == 0) || cv::solve(S, b, dc, cv::DECOMP_CHOLESKY);
+
+				if (solved) {
+					// Update the cameras.
+					for (unsigned int c = 0; c < result.cameras; c++) {
+						int j = camera_index[c];
+
+						if (j < 0) {
+							new_rotations[c] = this->rotations[c];
+							new_translations[c] = this->translations[c];
+							continue;
+						}
+
+						cv::Vec3d w(dc(6 * j), dc(6 * j + 1), dc(6 * j + 2));
+						cv::Matx33d dR;
+						cv::Rodrigues(w, dR);
+
+						new_rotations[c] = dR * this->rotations[c];
+						new_translations[c] = this->translations[c] + cv::Vec3d(dc(6 * j + 3), dc(6 * j + 4), dc(6 * j + 5));
+					}
+
+					// Back substitution of the points.
+					this->scheduler->parallel_for(0, point_count, BUNDLE_ADJUSTMENT_POINTS_PER_TASK, [&](unsigned int p) {
+						cv::Vec3d g = point_gradients[p];
+
+						for (unsigned int i = this->point_offsets[p]; i < this->point_offsets[p + 1]; i++) {
+							unsigned int o = this->point_observations[i];
+							int j = camera_index[this->observation_cameras[o]];
+							if (j < 0)
+								continue;
+
+							cv::Vec6d dcj;
+							for (unsigned int k = 0; k < 6; k++)
+								dcj[k] = dc(6 * j + k);
+
+							g -= W[o].t() * dcj;
+						}
+
+						new_points[p] = this->points[p] + V_inv[p] * g;
+					});
+
+					double new_squared_error;
+					double new_cost = this->evaluate(&new_rotations, &new_translations, &new_points, &new_squared_error);
+
+					if (new_cost < cost) {
+						this->rotations.swap(new_rotations);
+						this->translations.swap(new_translations);
+						this->points.swap(new_points);
+
+						result.converged = (cost - new_cost < BUNDLE_ADJUSTMENT_TOLERANCE * cost);
+
+						cost = new_cost;
+						squared_error = new_squared_error;
+						lambda = std::max(lambda / 10.0, BUNDLE_ADJUSTMENT_MIN_LAMBDA);
+						break;
+					}
+				}
+
+				lambda *= 10.0;
+
+				// No step lowers the cost any more, so we are at a minimum.
+				if (lambda > BUNDLE_ADJUSTMENT_MAX_LAMBDA) {
+					result.converged = true;
+					break;
+				}
+			}
+		}
+
+		result.final_error = sqrt(squared_error / n);
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		result.seconds = elapsed.count();
+
+		return result;
+	}
+}
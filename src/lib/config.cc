@@ -18,6 +18,8 @@
 ***/
 
 #include <fstream>
+#include <iostream>
+#include <stdexcept>
 #include <string>
 
 #include <boxes/config.h>
@@ -25,16 +27,164 @@
 #include <boxes/util.h>
 
 namespace Boxes {
+	enum ConfigType {
+		CONFIG_TYPE_STRING,
+		CONFIG_TYPE_INT,
+		CONFIG_TYPE_DOUBLE,
+		CONFIG_TYPE_BOOL,
+	};
+
+	// All known keys and the type of their values.
+	static const std::map<std::string, ConfigType> config_keys = {
+		{ "FEATURE_DETECTOR",           CONFIG_TYPE_STRING },
+		{ "FEATURE_DETECTOR_EXTRACTOR", CONFIG_TYPE_STRING },
+		{ "MATCH_VALID_RATIO",          CONFIG_TYPE_DOUBLE },
+		{ "MATCH_SYMMETRIC",            CONFIG_TYPE_BOOL },
+		{ "MATCH_GUIDED",               CONFIG_TYPE_BOOL },
+		{ "MATCH_MAX_KEYPOINTS",        CONFIG_TYPE_INT },
+		{ "MATCHER",                    CONFIG_TYPE_STRING },
+		{ "MATCHER_CHECKS",             CONFIG_TYPE_INT },
+		{ "EPIPOLAR_DISTANCE_FACTOR",   CONFIG_TYPE_DOUBLE },
+		{ "POSE_ESTIMATOR",             CONFIG_TYPE_STRING },
+		{ "RANSAC_CONFIDENCE",          CONFIG_TYPE_DOUBLE },
+		{ "RANSAC_MAX_ITERATIONS",      CONFIG_TYPE_INT },
+		{ "RANSAC_PROSAC",              CONFIG_TYPE_BOOL },
+		{ "RANSAC_SPRT",                CONFIG_TYPE_BOOL },
+		{ "RANSAC_LOCAL_OPTIMIZATION",  CONFIG_TYPE_BOOL },
+		{ "BUNDLE_ADJUSTMENT_INTERVAL", CONFIG_TYPE_INT },
+		{ "BUNDLE_ADJUSTMENT_MAX_ITERATIONS", CONFIG_TYPE_INT },
+		{ "TRACKS",                     CONFIG_TYPE_BOOL },
+		{ "RECONSTRUCTION_CHUNK_SIZE",  CONFIG_TYPE_INT },
+		{ "THREADS",                    CONFIG_TYPE_INT },
+		{ "OPTICAL_FLOW_STRIDE",        CONFIG_TYPE_INT },
+		{ "OPTICAL_FLOW_MAX_ERROR",     CONFIG_TYPE_DOUBLE },
+		{ "OPTICAL_FLOW_ENGINE",        CONFIG_TYPE_STRING },
+		{ "FARNEBACK_PYRAMID_SCALE",    CONFIG_TYPE_DOUBLE },
+		{ "FARNEBACK_LEVELS",           CONFIG_TYPE_INT },
+		{ "FARNEBACK_WINDOW_SIZE",      CONFIG_TYPE_INT },
+		{ "FARNEBACK_ITERATIONS",       CONFIG_TYPE_INT },
+		{ "FARNEBACK_POLY_N",           CONFIG_TYPE_INT },
+		{ "FARNEBACK_POLY_SIGMA",       CONFIG_TYPE_DOUBLE },
+		{ "LK_WINDOW_SIZE",             CONFIG_TYPE_INT },
+		{ "LK_LEVELS",                  CONFIG_TYPE_INT },
+		{ "LK_MAX_ERROR",               CONFIG_TYPE_DOUBLE },
+		{ "LK_GFTT",                    CONFIG_TYPE_BOOL },
+		{ "PATCH_FLOW_SIZE",            CONFIG_TYPE_INT },
+		{ "PATCH_FLOW_STRIDE",          CONFIG_TYPE_INT },
+		{ "PATCH_FLOW_LEVELS",          CONFIG_TYPE_INT },
+		{ "PATCH_FLOW_ITERATIONS",      CONFIG_TYPE_INT },
+		{ "SEQUENCE_TRACKING",          CONFIG_TYPE_BOOL },
+		{ "TRACKING_MAX_FEATURES",      CONFIG_TYPE_INT },
+		{ "TRACKING_MIN_FEATURES",      CONFIG_TYPE_INT },
+		{ "SURF_MIN_HESSIAN",           CONFIG_TYPE_INT },
+	};
+
+	static bool parse_bool(std::string val, bool* result) {
+		// Convert to lowercase for easy comparison.
+		val = tolower(val);
+
+		if ((val == "true") || (val == "yes") || (val == "1")) {
+			*result = true;
+			return true;
+		}
+
+		if ((val == "false") || (val == "no") || (val == "0")) {
+			*result = false;
+			return true;
+		}
+
+		return false;
+	}
+
+	template <typename T>
+	static bool parse_number(const std::string val, T* result) {
+		std::istringstream value(val);
+		value >> *result;
+
+		// Fail if the value could not be parsed or if there is trailing garbage.
+		if (value.fail())
+			return false;
+
+		value >> std::ws;
+		return value.eof();
+	}
+
+	static void validate(const std::string key, const std::string val) {
+		std::map<std::string, ConfigType>::const_iterator type = config_keys.find(key);
+
+		if (type == config_keys.end())
+			throw std::runtime_error("Unknown configuration key: " + key);
+
+		bool valid = true;
+		bool b;
+		int i;
+		double d;
+
+		switch (type->second) {
+			case CONFIG_TYPE_STRING:
+				valid = !val.empty();
+				break;
+
+			case CONFIG_TYPE_INT:
+				valid = parse_number(val, &i);
+				break;
+
+			case CONFIG_TYPE_DOUBLE:
+				valid = parse_number(val, &d);
+				break;
+
+			case CONFIG_TYPE_BOOL:
+				valid = parse_bool(val, &b);
+				break;
+		}
+
+		if (!valid)
+			throw std::runtime_error("Invalid value for " + key + ": '" + val + "'");
+	}
+
 	Config::Config() {
 		// Initialize with default settings.
 		this->set("FEATURE_DETECTOR",           DEFAULT_FEATURE_DETECTOR);
 		this->set("FEATURE_DETECTOR_EXTRACTOR", DEFAULT_FEATURE_DETECTOR_EXTRACTOR);
 		this->set("MATCH_VALID_RATIO",		DEFAULT_MATCH_VALID_RATIO);
+		this->set("MATCH_SYMMETRIC",            DEFAULT_MATCH_SYMMETRIC);
+		this->set("MATCH_GUIDED",               DEFAULT_MATCH_GUIDED);
+		this->set("MATCH_MAX_KEYPOINTS",        DEFAULT_MATCH_MAX_KEYPOINTS);
+		this->set("MATCHER",                    DEFAULT_MATCHER);
+		this->set("MATCHER_CHECKS",             DEFAULT_MATCHER_CHECKS);
 		this->set("EPIPOLAR_DISTANCE_FACTOR",   DEFAULT_EPIPOLAR_DISTANCE_FACTOR);
-
-#ifdef BOXES_NONFREE
+		this->set("POSE_ESTIMATOR",             DEFAULT_POSE_ESTIMATOR);
+		this->set("RANSAC_CONFIDENCE",          DEFAULT_RANSAC_CONFIDENCE);
+		this->set("RANSAC_MAX_ITERATIONS",      DEFAULT_RANSAC_MAX_ITERATIONS);
+		this->set("RANSAC_PROSAC",              DEFAULT_RANSAC_PROSAC);
+		this->set("RANSAC_SPRT",                DEFAULT_RANSAC_SPRT);
+		this->set("RANSAC_LOCAL_OPTIMIZATION",  DEFAULT_RANSAC_LOCAL_OPTIMIZATION);
+		this->set("BUNDLE_ADJUSTMENT_INTERVAL", DEFAULT_BUNDLE_ADJUSTMENT_INTERVAL);
+		this->set("BUNDLE_ADJUSTMENT_MAX_ITERATIONS", DEFAULT_BUNDLE_ADJUSTMENT_MAX_ITERATIONS);
+		this->set("TRACKS",                     DEFAULT_TRACKS);
+		this->set("RECONSTRUCTION_CHUNK_SIZE",  DEFAULT_RECONSTRUCTION_CHUNK_SIZE);
+		this->set("THREADS",                    DEFAULT_THREADS);
+		this->set("OPTICAL_FLOW_STRIDE",        DEFAULT_OPTICAL_FLOW_STRIDE);
+		this->set("OPTICAL_FLOW_MAX_ERROR",     DEFAULT_OPTICAL_FLOW_MAX_ERROR);
+		this->set("OPTICAL_FLOW_ENGINE",        DEFAULT_OPTICAL_FLOW_ENGINE);
+		this->set("FARNEBACK_PYRAMID_SCALE",    DEFAULT_FARNEBACK_PYRAMID_SCALE);
+		this->set("FARNEBACK_LEVELS",           DEFAULT_FARNEBACK_LEVELS);
+		this->set("FARNEBACK_WINDOW_SIZE",      DEFAULT_FARNEBACK_WINDOW_SIZE);
+		this->set("FARNEBACK_ITERATIONS",       DEFAULT_FARNEBACK_ITERATIONS);
+		this->set("FARNEBACK_POLY_N",           DEFAULT_FARNEBACK_POLY_N);
+		this->set("FARNEBACK_POLY_SIGMA",       DEFAULT_FARNEBACK_POLY_SIGMA);
+		this->set("LK_WINDOW_SIZE",             DEFAULT_LK_WINDOW_SIZE);
+		this->set("LK_LEVELS",                  DEFAULT_LK_LEVELS);
+		this->set("LK_MAX_ERROR",               DEFAULT_LK_MAX_ERROR);
+		this->set("LK_GFTT",                    DEFAULT_LK_GFTT);
+		this->set("PATCH_FLOW_SIZE",            DEFAULT_PATCH_FLOW_SIZE);
+		this->set("PATCH_FLOW_STRIDE",          DEFAULT_PATCH_FLOW_STRIDE);
+		this->set("PATCH_FLOW_LEVELS",          DEFAULT_PATCH_FLOW_LEVELS);
+		this->set("PATCH_FLOW_ITERATIONS",      DEFAULT_PATCH_FLOW_ITERATIONS);
+		this->set("SEQUENCE_TRACKING",          DEFAULT_SEQUENCE_TRACKING);
+		this->set("TRACKING_MAX_FEATURES",      DEFAULT_TRACKING_MAX_FEATURES);
+		this->set("TRACKING_MIN_FEATURES",      DEFAULT_TRACKING_MIN_FEATURES);
 		this->set("SURF_MIN_HESSIAN",           DEFAULT_SURF_MIN_HESSIAN);
-#endif
 	}
 
 	void Config::dump() const {
@@ -47,67 +197,232 @@ namespace Boxes {
 		std::cout << std::endl;
 	}
 
-	std::string Config::get(std::string key) {
-		return this->map[key];
-	}
-
-	int Config::get_int(std::string key) {
-		int ret;
+	std::string Config::get(std::string key) const {
+		std::map<std::string, std::string>::const_iterator i = this->map.find(key);
 
-		std::istringstream value(this->get(key));
-		value >> ret;
+		if (i == this->map.end())
+			return "";
 
-		return ret;
+		return i->second;
 	}
 
-	double Config::get_double(std::string key) {
-		double ret;
-
-		std::istringstream value(this->get(key));
-		value >> ret;
+	int Config::get_int(std::string key) const {
+		int ret = 0;
+		parse_number(this->get(key), &ret);
 
 		return ret;
 	}
 
-	bool Config::get_bool(std::string key) {
-		std::string val = this->get(key);
+	double Config::get_double(std::string key) const {
+		double ret = 0.0;
+		parse_number(this->get(key), &ret);
 
-		// Convert to lowercase for easy comparison.
-		val = tolower(val);
+		return ret;
+	}
 
-		if ((val == "true") || (val == "yes") || (val == "1"))
-			return true;
+	bool Config::get_bool(std::string key) const {
+		bool ret = false;
+		parse_bool(this->get(key), &ret);
 
-		return false;
+		return ret;
 	}
 
 	void Config::set(std::string key, std::string value) {
+		// Throws an exception for unknown keys and malformed values.
+		validate(key, value);
+
 		this->map[key] = value;
 	}
 
 	void Config::read(const std::string filename) {
 		std::string line;
+		unsigned int lineno = 0;
 
+		// Files are only read when asked for, so a missing one is an error.
 		std::ifstream file(filename);
 		if (!file.is_open())
-			return;
+			throw std::runtime_error("Could not open configuration file " + filename);
 
 		while (std::getline(file, line)) {
-			this->parse_line(line);
+			lineno++;
+
+			// Skip empty lines and comments.
+			std::string stripped = strip(line);
+			if (stripped.empty() || stripped[0] == '#')
+				continue;
+
+			try {
+				this->parse_line(stripped);
+			} catch (std::runtime_error& e) {
+				std::ostringstream message;
+				message << filename << ":" << lineno << ": " << e.what();
+
+				throw std::runtime_error(message.str());
+			}
 		}
 
 		file.close();
 	}
 
 	void Config::parse_line(const std::string line) {
+		if (line.find("=") == std::string::npos)
+			throw std::runtime_error("Expected KEY=VALUE, got '" + line + "'");
+
 		std::pair<std::string, std::string> args = split_once(line, "=");
 
 		std::string key = strip(args.first);
 		std::string val = strip(args.second);
 
-		assert(!key.empty());
-		assert(!val.empty());
-
 		this->set(key, val);
 	}
+
+	Settings Config::compile() const {
+		Settings settings;
+
+		settings.feature_detector           = this->get("FEATURE_DETECTOR");
+		settings.feature_detector_extractor = this->get("FEATURE_DETECTOR_EXTRACTOR");
+
+		settings.match_valid_ratio          = this->get_double("MATCH_VALID_RATIO");
+		if (settings.match_valid_ratio <= 0.0 || settings.match_valid_ratio > 1.0)
+			throw std::runtime_error("MATCH_VALID_RATIO must be in (0, 1]");
+
+		settings.match_symmetric            = this->get_bool("MATCH_SYMMETRIC");
+		settings.match_guided               = this->get_bool("MATCH_GUIDED");
+
+		settings.match_max_keypoints        = this->get_int("MATCH_MAX_KEYPOINTS");
+		if (settings.match_max_keypoints < 0)
+			throw std::runtime_error("MATCH_MAX_KEYPOINTS must not be negative");
+
+		settings.matcher                    = this->get("MATCHER");
+		if (settings.matcher != MATCHER_AUTO && settings.matcher != MATCHER_BRUTE_FORCE &&
+				settings.matcher != MATCHER_HAMMING && settings.matcher != MATCHER_KDTREE &&
+				settings.matcher != MATCHER_LSH)
+			throw std::runtime_error("Unknown matcher: " + settings.matcher);
+
+		settings.matcher_checks             = this->get_int("MATCHER_CHECKS");
+		if (settings.matcher_checks <= 0)
+			throw std::runtime_error("MATCHER_CHECKS must be positive");
+
+		settings.epipolar_distance_factor   = this->get_double("EPIPOLAR_DISTANCE_FACTOR");
+		if (settings.epipolar_distance_factor <= 0.0)
+			throw std::runtime_error("EPIPOLAR_DISTANCE_FACTOR must be positive");
+
+		settings.pose_estimator             = this->get("POSE_ESTIMATOR");
+		if (settings.pose_estimator != POSE_ESTIMATOR_FUNDAMENTAL && settings.pose_estimator != POSE_ESTIMATOR_FIVE_POINT)
+			throw std::runtime_error("Unknown pose estimator: " + settings.pose_estimator);
+
+		settings.ransac_confidence          = this->get_double("RANSAC_CONFIDENCE");
+		if (settings.ransac_confidence <= 0.0 || settings.ransac_confidence >= 1.0)
+			throw std::runtime_error("RANSAC_CONFIDENCE must be in (0, 1)");
+
+		settings.ransac_max_iterations      = this->get_int("RANSAC_MAX_ITERATIONS");
+		if (settings.ransac_max_iterations <= 0)
+			throw std::runtime_error("RANSAC_MAX_ITERATIONS must be positive");
+
+		settings.ransac_prosac              = this->get_bool("RANSAC_PROSAC");
+		settings.ransac_sprt                = this->get_bool("RANSAC_SPRT");
+		settings.ransac_local_optimization  = this->get_bool("RANSAC_LOCAL_OPTIMIZATION");
+
+		settings.bundle_adjustment_interval = this->get_int("BUNDLE_ADJUSTMENT_INTERVAL");
+		if (settings.bundle_adjustment_interval < 0)
+			throw std::runtime_error("BUNDLE_ADJUSTMENT_INTERVAL must not be negative");
+
+		settings.bundle_adjustment_max_iterations = this->get_int("BUNDLE_ADJUSTMENT_MAX_ITERATIONS");
+		if (settings.bundle_adjustment_max_iterations <= 0)
+			throw std::runtime_error("BUNDLE_ADJUSTMENT_MAX_ITERATIONS must be positive");
+
+		settings.tracks                     = this->get_bool("TRACKS");
+
+		settings.reconstruction_chunk_size  = this->get_int("RECONSTRUCTION_CHUNK_SIZE");
+		if (settings.reconstruction_chunk_size < 0)
+			throw std::runtime_error("RECONSTRUCTION_CHUNK_SIZE must not be negative");
+
+		settings.threads                    = this->get_int("THREADS");
+		if (settings.threads < 0)
+			throw std::runtime_error("THREADS must not be negative");
+
+		settings.optical_flow_stride        = this->get_int("OPTICAL_FLOW_STRIDE");
+		if (settings.optical_flow_stride <= 0)
+			throw std::runtime_error("OPTICAL_FLOW_STRIDE must be positive");
+
+		settings.optical_flow_max_error     = this->get_double("OPTICAL_FLOW_MAX_ERROR");
+		if (settings.optical_flow_max_error < 0.0)
+			throw std::runtime_error("OPTICAL_FLOW_MAX_ERROR must not be negative");
+
+		settings.optical_flow_engine        = this->get("OPTICAL_FLOW_ENGINE");
+		if (settings.optical_flow_engine != OPTICAL_FLOW_ENGINE_FARNEBACK &&
+				settings.optical_flow_engine != OPTICAL_FLOW_ENGINE_LUCAS_KANADE &&
+				settings.optical_flow_engine != OPTICAL_FLOW_ENGINE_PATCH)
+			throw std::runtime_error("Unknown optical flow engine: " + settings.optical_flow_engine);
+
+		settings.farneback_pyramid_scale    = this->get_double("FARNEBACK_PYRAMID_SCALE");
+		if (settings.farneback_pyramid_scale <= 0.0 || settings.farneback_pyramid_scale >= 1.0)
+			throw std::runtime_error("FARNEBACK_PYRAMID_SCALE must be in (0, 1)");
+
+		settings.farneback_levels           = this->get_int("FARNEBACK_LEVELS");
+		if (settings.farneback_levels <= 0)
+			throw std::runtime_error("FARNEBACK_LEVELS must be positive");
+
+		settings.farneback_window_size      = this->get_int("FARNEBACK_WINDOW_SIZE");
+		if (settings.farneback_window_size <= 0)
+			throw std::runtime_error("FARNEBACK_WINDOW_SIZE must be positive");
+
+		settings.farneback_iterations       = this->get_int("FARNEBACK_ITERATIONS");
+		if (settings.farneback_iterations <= 0)
+			throw std::runtime_error("FARNEBACK_ITERATIONS must be positive");
+
+		settings.farneback_poly_n           = this->get_int("FARNEBACK_POLY_N");
+		if (settings.farneback_poly_n != 5 && settings.farneback_poly_n != 7)
+			throw std::runtime_error("FARNEBACK_POLY_N must be 5 or 7");
+
+		settings.farneback_poly_sigma       = this->get_double("FARNEBACK_POLY_SIGMA");
+		if (settings.farneback_poly_sigma <= 0.0)
+			throw std::runtime_error("FARNEBACK_POLY_SIGMA must be positive");
+
+		settings.lk_window_size             = this->get_int("LK_WINDOW_SIZE");
+		if (settings.lk_window_size <= 0)
+			throw std::runtime_error("LK_WINDOW_SIZE must be positive");
+
+		settings.lk_levels                  = this->get_int("LK_LEVELS");
+		if (settings.lk_levels < 0)
+			throw std::runtime_error("LK_LEVELS must not be negative");
+
+		settings.lk_max_error               = this->get_double("LK_MAX_ERROR");
+		if (settings.lk_max_error <= 0.0)
+			throw std::runtime_error("LK_MAX_ERROR must be positive");
+
+		settings.lk_gftt                    = this->get_bool("LK_GFTT");
+
+		settings.patch_flow_size            = this->get_int("PATCH_FLOW_SIZE");
+		if (settings.patch_flow_size < 2)
+			throw std::runtime_error("PATCH_FLOW_SIZE must be at least 2");
+
+		settings.patch_flow_stride          = this->get_int("PATCH_FLOW_STRIDE");
+		if (settings.patch_flow_stride <= 0 || settings.patch_flow_stride > settings.patch_flow_size)
+			throw std::runtime_error("PATCH_FLOW_STRIDE must be in [1, PATCH_FLOW_SIZE]");
+
+		settings.patch_flow_levels          = this->get_int("PATCH_FLOW_LEVELS");
+		if (settings.patch_flow_levels <= 0)
+			throw std::runtime_error("PATCH_FLOW_LEVELS must be positive");
+
+		settings.patch_flow_iterations      = this->get_int("PATCH_FLOW_ITERATIONS");
+		if (settings.patch_flow_iterations <= 0)
+			throw std::runtime_error("PATCH_FLOW_ITERATIONS must be positive");
+
+		settings.sequence_tracking          = this->get_bool("SEQUENCE_TRACKING");
+
+		settings.tracking_max_features      = this->get_int("TRACKING_MAX_FEATURES");
+		if (settings.tracking_max_features <= 0)
+			throw std::runtime_error("TRACKING_MAX_FEATURES must be positive");
+
+		settings.tracking_min_features      = this->get_int("TRACKING_MIN_FEATURES");
+		if (settings.tracking_min_features <= 0 || settings.tracking_min_features > settings.tracking_max_features)
+			throw std::runtime_error("TRACKING_MIN_FEATURES must be in [1, TRACKING_MAX_FEATURES]");
+
+		settings.surf_min_hessian           = this->get_int("SURF_MIN_HESSIAN");
+		if (settings.surf_min_hessian < 0)
+			throw std::runtime_error("SURF_MIN_HESSIAN must not be negative");
+
+		return settings;
+	}
 }
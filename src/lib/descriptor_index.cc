@@ -0,0 +1,327 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <math.h>
+#include <mutex>
+#include <opencv2/flann/flann.hpp>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boxes/config.h>
+#include <boxes/constants.h>
+#include <boxes/descriptor_index.h>
+#include <boxes/feature_matcher.h>
+#include <boxes/hamming.h>
+
+namespace Boxes {
+	/*
+	 * Contructor.
+	 */
+	DescriptorIndex::DescriptorIndex(const cv::Mat* descriptors) {
+		this->descriptors = descriptors;
+	}
+
+	const cv::Mat* DescriptorIndex::get_descriptors() const {
+		return this->descriptors;
+	}
+
+	bool DescriptorIndex::is_binary() const {
+		// Binary descriptors (ORB, BRISK, BRIEF) are stored as bytes.
+		return (this->descriptors->depth() == CV_8U);
+	}
+
+	int DescriptorIndex::get_norm_type() const {
+		if (this->is_binary())
+			return cv::NORM_HAMMING;
+
+		return cv::NORM_L2;
+	}
+
+	void DescriptorIndex::knn_match(const cv::Mat* query, std::vector<std::vector<cv::DMatch>>* matches, int k) {
+		// There is nothing to search if one of the sets is empty.
+		if (query->empty() || this->descriptors->empty()) {
+			matches->assign(query->rows, std::vector<cv::DMatch>());
+			return;
+		}
+
+		this->_knn_match(query, matches, k);
+	}
+
+	void DescriptorIndex::ratio_match(const cv::Mat* query, double ratio, std::vector<cv::DMatch>* matches) {
+		matches->clear();
+
+		if (query->empty() || this->descriptors->empty())
+			return;
+
+		this->_ratio_match(query, ratio, matches);
+	}
+
+	void DescriptorIndex::_ratio_match(const cv::Mat* query, double ratio, std::vector<cv::DMatch>* matches) {
+		std::vector<std::vector<cv::DMatch>> nearest_neighbours;
+		this->_knn_match(query, &nearest_neighbours, 2);
+
+		ratio_test(&nearest_neighbours, ratio, matches);
+	}
+
+	void DescriptorIndex::mutual_match(DescriptorIndex* query_index, double ratio, std::vector<cv::DMatch>* matches) {
+		matches->clear();
+
+		if (query_index->descriptors->empty() || this->descriptors->empty())
+			return;
+
+		this->_mutual_match(query_index, ratio, matches);
+	}
+
+	void DescriptorIndex::_mutual_match(DescriptorIndex* query_index, double ratio, std::vector<cv::DMatch>* matches) {
+		std::vector<cv::DMatch> forward;
+		std::vector<cv::DMatch> backward;
+
+		// Search both directions with the index of the respective image.
+		this->_ratio_match(query_index->descriptors, ratio, &forward);
+		query_index->_ratio_match(this->descriptors, ratio, &backward);
+
+		// Best query row of every train row.
+		std::vector<int> reverse(this->descriptors->rows, -1);
+		for (std::vector<cv::DMatch>::const_iterator m = backward.begin(); m != backward.end(); ++m)
+			reverse[m->queryIdx] = m->trainIdx;
+
+		for (std::vector<cv::DMatch>::const_iterator m = forward.begin(); m != forward.end(); ++m) {
+			if (reverse[m->trainIdx] == m->queryIdx)
+				matches->push_back(*m);
+		}
+	}
+
+	void DescriptorIndex::ratio_test(const std::vector<std::vector<cv::DMatch>>* nearest_neighbours,
+			double ratio, std::vector<cv::DMatch>* matches) {
+		const cv::DMatch* match1;
+		const cv::DMatch* match2;
+		for (std::vector<std::vector<cv::DMatch>>::const_iterator n = nearest_neighbours->begin(); n != nearest_neighbours->end(); ++n) {
+			unsigned int size = n->size();
+
+			switch (size) {
+				case 0:
+					continue;
+
+#ifdef FEATURE_MATCHER_USE_SINGLE_MATCHES
+				case 1:
+					match1 = &n->at(0);
+					break;
+#endif
+
+#ifdef FEATURE_MATCHER_USE_DOUBLE_MATCHES
+				default:
+					match1 = &n->at(0);
+					match2 = &n->at(1);
+					if (match1->distance > match2->distance * ratio)
+						continue;
+					break;
+#endif
+			}
+
+			matches->push_back(*match1);
+		}
+	}
+
+	std::string DescriptorIndex::resolve_type(const std::string type, const cv::Mat* descriptors) {
+		if (type != MATCHER_AUTO)
+			return type;
+
+		// Use LSH for binary descriptors and KD-trees for float descriptors.
+		if (descriptors->depth() == CV_8U)
+			return MATCHER_LSH;
+
+		return MATCHER_KDTREE;
+	}
+
+	DescriptorIndex* DescriptorIndex::create(const std::string type, const cv::Mat* descriptors, const Settings& settings) {
+		std::string t = resolve_type(type, descriptors);
+
+		if (t == MATCHER_BRUTE_FORCE)
+			return new BruteForceIndex(descriptors);
+
+		if (t == MATCHER_HAMMING) {
+			if (descriptors->depth() != CV_8U)
+				throw std::runtime_error("The HAMMING matcher only works with binary descriptors");
+
+			return new HammingIndex(descriptors);
+		}
+
+		if (t == MATCHER_LSH) {
+			if (descriptors->depth() != CV_8U)
+				throw std::runtime_error("The LSH matcher only works with binary descriptors");
+
+			cv::flann::LshIndexParams params(MATCHER_LSH_TABLES, MATCHER_LSH_KEY_SIZE, MATCHER_LSH_MULTI_PROBE_LEVEL);
+			return new FlannIndex(descriptors, params, settings.matcher_checks);
+		}
+
+		if (t == MATCHER_KDTREE) {
+			if (descriptors->depth() != CV_32F)
+				throw std::runtime_error("The KDTREE matcher only works with float descriptors");
+
+			cv::flann::KDTreeIndexParams params(MATCHER_KDTREE_TREES);
+			return new FlannIndex(descriptors, params, settings.matcher_checks);
+		}
+
+		throw std::runtime_error("Unknown matcher: " + type);
+	}
+
+	void BruteForceIndex::_knn_match(const cv::Mat* query, std::vector<std::vector<cv::DMatch>>* matches, int k) {
+		cv::BFMatcher matcher = cv::BFMatcher(this->get_norm_type());
+
+		matcher.knnMatch(*query, *this->descriptors, *matches, k);
+	}
+
+	/*
+	 * Contructor.
+	 */
+	HammingIndex::HammingIndex(const cv::Mat* descriptors) :
+			DescriptorIndex(descriptors) {
+	}
+
+	void HammingIndex::knn2(const cv::Mat* query, std::vector<HammingNeighbours>* neighbours) const {
+		hamming_knn2(query->ptr<uint8_t>(), query->rows, query->step,
+			this->descriptors->ptr<uint8_t>(), this->descriptors->rows, this->descriptors->step,
+			query->cols * query->elemSize(), neighbours);
+	}
+
+	void HammingIndex::_knn_match(const cv::Mat* query, std::vector<std::vector<cv::DMatch>>* matches, int k) {
+		// The kernel only keeps the two best candidates.
+		if (k > 2) {
+			BruteForceIndex index(this->descriptors);
+			index.knn_match(query, matches, k);
+			return;
+		}
+
+		std::vector<HammingNeighbours> neighbours;
+		this->knn2(query, &neighbours);
+
+		matches->assign(query->rows, std::vector<cv::DMatch>());
+
+		for (int i = 0; i < query->rows; i++) {
+			const HammingNeighbours* n = &neighbours[i];
+
+			if (n->idx != HAMMING_NO_MATCH)
+				matches->at(i).push_back(cv::DMatch(i, n->idx, n->best));
+
+			if (k > 1 && n->second_idx != HAMMING_NO_MATCH)
+				matches->at(i).push_back(cv::DMatch(i, n->second_idx, n->second));
+		}
+	}
+
+	void HammingIndex::_ratio_match(const cv::Mat* query, double ratio, std::vector<cv::DMatch>* matches) {
+		std::vector<HammingNeighbours> neighbours;
+		this->knn2(query, &neighbours);
+
+		uint32_t r = hamming_ratio(ratio);
+
+		for (int i = 0; i < query->rows; i++) {
+			const HammingNeighbours* n = &neighbours[i];
+
+			if (hamming_ratio_test(n, r))
+				matches->push_back(cv::DMatch(i, n->idx, n->best));
+		}
+	}
+
+	void HammingIndex::_mutual_match(DescriptorIndex* query_index, double ratio, std::vector<cv::DMatch>* matches) {
+		const cv::Mat* query = query_index->get_descriptors();
+
+		// The kernel can only compare binary descriptors of the same length.
+		if (query->depth() != CV_8U || query->cols != this->descriptors->cols) {
+			DescriptorIndex::_mutual_match(query_index, ratio, matches);
+			return;
+		}
+
+		std::vector<HammingNeighbours> query_neighbours;
+		std::vector<HammingNeighbours> train_neighbours;
+
+		hamming_knn2_symmetric(query->ptr<uint8_t>(), query->rows, query->step,
+			this->descriptors->ptr<uint8_t>(), this->descriptors->rows, this->descriptors->step,
+			query->cols * query->elemSize(), &query_neighbours, &train_neighbours);
+
+		uint32_t r = hamming_ratio(ratio);
+
+		for (int i = 0; i < query->rows; i++) {
+			const HammingNeighbours* n = &query_neighbours[i];
+
+			if (!hamming_ratio_test(n, r))
+				continue;
+
+			// The query row must also be the best match of the train row.
+			const HammingNeighbours* m = &train_neighbours[n->idx];
+			if (m->idx != i || !hamming_ratio_test(m, r))
+				continue;
+
+			matches->push_back(cv::DMatch(i, n->idx, n->best));
+		}
+	}
+
+	/*
+	 * Contructor.
+	 */
+	FlannIndex::FlannIndex(const cv::Mat* descriptors, const cv::flann::IndexParams& params, int checks) :
+			DescriptorIndex(descriptors) {
+		this->checks = checks;
+
+		// Build the index right away, when it is empty, there is nothing to search.
+		if (!this->descriptors->empty())
+			this->index.build(*this->descriptors, params, this->is_binary() ?
+				cvflann::FLANN_DIST_HAMMING : cvflann::FLANN_DIST_L2);
+	}
+
+	void FlannIndex::_knn_match(const cv::Mat* query, std::vector<std::vector<cv::DMatch>>* matches, int k) {
+		cv::Mat indices;
+		cv::Mat distances;
+
+		// We cannot find more neighbours than there are in the index.
+		k = MIN(k, this->descriptors->rows);
+
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+
+			this->index.knnSearch(*query, indices, distances, k, cv::flann::SearchParams(this->checks));
+		}
+
+		matches->assign(query->rows, std::vector<cv::DMatch>());
+
+		for (int i = 0; i < query->rows; i++) {
+			std::vector<cv::DMatch>* neighbours = &matches->at(i);
+
+			for (int j = 0; j < k; j++) {
+				int idx = indices.at<int>(i, j);
+
+				// LSH might not find enough neighbours.
+				if (idx < 0)
+					break;
+
+				float distance;
+				if (distances.type() == CV_32S) {
+					distance = distances.at<int>(i, j);
+
+				// FLANN returns squared L2 distances.
+				} else {
+					distance = sqrtf(distances.at<float>(i, j));
+				}
+
+				neighbours->push_back(cv::DMatch(i, idx, distance));
+			}
+		}
+	}
+}
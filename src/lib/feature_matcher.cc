@@ -17,24 +17,40 @@
 	along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <algorithm>
+#include <float.h>
 #include <list>
+#include <memory>
+#include <stdint.h>
+#include <string.h>
 #include <opencv2/opencv.hpp>
+#include <stdexcept>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
+#include <boxes/boxes.h>
 #include <boxes/camera_matrix.h>
 #include <boxes/constants.h>
 #include <boxes/converters.h>
+#include <boxes/descriptor_index.h>
 #include <boxes/feature_matcher.h>
+#include <boxes/hamming.h>
 #include <boxes/image.h>
+#include <boxes/point_grid.h>
+#include <boxes/ransac.h>
+#include <boxes/ransac_estimators.h>
+#include <boxes/scheduler.h>
 #include <boxes/structs.h>
+#include <boxes/triangulation.h>
 
 namespace Boxes {
 	/*
 	 * Contructor.
 	 */
-	FeatureMatcher::FeatureMatcher(Boxes* boxes, Image* image1, Image* image2) {
+	FeatureMatcher::FeatureMatcher(Boxes* boxes, Image* image1, Image* image2) :
+			settings(boxes->get_settings()) {
 		this->boxes = boxes;
 
 		this->image1 = image1;
@@ -48,80 +64,183 @@ namespace Boxes {
 	}
 
 	void FeatureMatcher::match() {
-		std::vector<cv::KeyPoint>* keypoints1 = this->image1->get_keypoints();
-		std::vector<cv::KeyPoint>* keypoints2 = this->image2->get_keypoints();
+		// Remove any stale matches that might be in here.
+		this->matches.clear();
+
+		std::vector<cv::DMatch> good_matches;
+
+		// Match a few strong keypoints first and add the rest after the epipolar geometry is known.
+		// This builds indices of its own, so the ones of the images are not needed.
+		if (this->settings.match_guided && this->settings.match_max_keypoints > 0) {
+			this->match_strongest(this->settings.match_max_keypoints, &good_matches);
+
+		// Only keep matches that are the best ones in both directions.
+		// Descriptors and indices are cached by the images, so we must not free them here.
+		} else if (this->settings.match_symmetric) {
+			DescriptorIndex* index1 = this->image1->get_descriptor_index();
+			DescriptorIndex* index2 = this->image2->get_descriptor_index();
+
+			index2->mutual_match(index1, this->settings.match_valid_ratio, &good_matches);
+		} else {
+			const cv::Mat* descriptors1 = this->image1->get_descriptors();
+			DescriptorIndex* index2 = this->image2->get_descriptor_index();
+
+			index2->ratio_match(descriptors1, this->settings.match_valid_ratio, &good_matches);
+		}
 
-		cv::Mat* descriptors1 = this->image1->get_descriptors(keypoints1);
-		cv::Mat* descriptors2 = this->image2->get_descriptors(keypoints2);
+		this->add_matches(&good_matches);
 
-		this->_match(descriptors1, descriptors2);
+		// Prepare the fundamental matrix.
+		// This will also modify the match, hence it needs to be done here.
+		this->calculate_fundamental_matrix();
 
-		delete descriptors1;
-		delete descriptors2;
+		if (this->settings.match_guided)
+			this->guided_match();
 	}
 
-	void FeatureMatcher::_match(const cv::Mat* descriptors1, const cv::Mat* descriptors2, const std::vector<MatchPoint>* match_points, int match_type, int norm_type) {
-		// Remove any stale matches that might be in here.
-		this->matches.clear();
+	// Returns the indices of the n keypoints with the strongest response.
+	static std::vector<int> select_strongest_keypoints(const std::vector<cv::KeyPoint>* keypoints, unsigned int n) {
+		std::vector<int> indices(keypoints->size());
+		for (unsigned int i = 0; i < indices.size(); i++)
+			indices[i] = i;
+
+		if (n < indices.size()) {
+			std::nth_element(indices.begin(), indices.begin() + n, indices.end(), [keypoints](int a, int b) {
+				return keypoints->at(a).response > keypoints->at(b).response;
+			});
+
+			indices.resize(n);
+		}
+
+		return indices;
+	}
+
+	static cv::Mat select_rows(const cv::Mat* mat, const std::vector<int>* rows) {
+		cv::Mat selection(rows->size(), mat->cols, mat->type());
+
+		for (unsigned int i = 0; i < rows->size(); i++)
+			mat->row(rows->at(i)).copyTo(selection.row(i));
+
+		return selection;
+	}
+
+	void FeatureMatcher::match_strongest(unsigned int n, std::vector<cv::DMatch>* good_matches) {
+		// The extractor may drop some keypoints, so these are the ones that have descriptors.
+		const cv::Mat* all_descriptors1 = this->image1->get_descriptors();
+		const cv::Mat* all_descriptors2 = this->image2->get_descriptors();
 
 		const std::vector<cv::KeyPoint>* keypoints1 = this->image1->get_keypoints();
 		const std::vector<cv::KeyPoint>* keypoints2 = this->image2->get_keypoints();
 
-		// Create matcher
-		std::vector<std::vector<cv::DMatch>> nearest_neighbours;
-		cv::BFMatcher matcher = cv::BFMatcher(norm_type);
+		std::vector<int> selection1 = select_strongest_keypoints(keypoints1, n);
+		std::vector<int> selection2 = select_strongest_keypoints(keypoints2, n);
+
+		cv::Mat descriptors1 = select_rows(all_descriptors1, &selection1);
+		cv::Mat descriptors2 = select_rows(all_descriptors2, &selection2);
 
-		// Match.
-		switch (match_type) {
-			case MATCH_TYPE_NORMAL:
-				matcher.knnMatch(*descriptors1, *descriptors2, nearest_neighbours, 2);
-				break;
+		// These indices are only used once, so they are not cached.
+		std::unique_ptr<DescriptorIndex> index2(DescriptorIndex::create(this->settings.matcher, &descriptors2, this->settings));
 
-			case MATCH_TYPE_RADIUS:
-				matcher.radiusMatch(*descriptors1, *descriptors2, nearest_neighbours, OF_RADIUS_MATCH);
-				break;
+		if (this->settings.match_symmetric) {
+			std::unique_ptr<DescriptorIndex> index1(DescriptorIndex::create(this->settings.matcher, &descriptors1, this->settings));
 
-			default:
-				return;
+			index2->mutual_match(index1.get(), this->settings.match_valid_ratio, good_matches);
+		} else {
+			index2->ratio_match(&descriptors1, this->settings.match_valid_ratio, good_matches);
 		}
 
-		cv::DMatch* match1;
-		cv::DMatch* match2;
-		for (std::vector<std::vector<cv::DMatch>>::iterator n = nearest_neighbours.begin(); n != nearest_neighbours.end(); ++n) {
-			unsigned int size = n->size();
+		// Translate the indices back to the full sets of keypoints.
+		for (std::vector<cv::DMatch>::iterator match = good_matches->begin(); match != good_matches->end(); ++match) {
+			match->queryIdx = selection1[match->queryIdx];
+			match->trainIdx = selection2[match->trainIdx];
+		}
+	}
 
-			switch (size) {
-				case 0:
-					continue;
+	void FeatureMatcher::guided_match() {
+		if (this->fundamental_matrix.rows != 3 || this->fundamental_matrix.cols != 3)
+			return;
+
+		const cv::Mat* descriptors1 = this->image1->get_descriptors();
+		const cv::Mat* descriptors2 = this->image2->get_descriptors();
+
+		const std::vector<cv::KeyPoint>* keypoints1 = this->image1->get_keypoints();
+		const std::vector<cv::KeyPoint>* keypoints2 = this->image2->get_keypoints();
+
+		std::vector<cv::Point2f> points2 = convertKeyPoints(keypoints2);
+		PointGrid grid = PointGrid(&points2);
 
-#ifdef FEATURE_MATCHER_USE_SINGLE_MATCHES
-				case 1:
-					match1 = &n->at(0);
-					break;
-#endif
-
-#ifdef FEATURE_MATCHER_USE_DOUBLE_MATCHES
-				default:
-					match1 = &n->at(0);
-					match2 = &n->at(1);
-					double match_ratio = this->boxes->config->get_double("MATCH_VALID_RATIO");
-					if (match1->distance > match2->distance * match_ratio)
-						continue;
-					break;
-#endif
+		cv::Matx33d F = this->fundamental_matrix;
+
+		bool binary = (descriptors1->depth() == CV_8U);
+		unsigned int bytes = descriptors1->cols * descriptors1->elemSize();
+
+		// Best match of every keypoint of image2.
+		std::vector<cv::DMatch> best_matches(keypoints2->size(), cv::DMatch(-1, -1, FLT_MAX));
+
+		std::vector<int> candidates;
+		for (unsigned int i = 0; i < keypoints1->size(); i++) {
+			const cv::Point2f* pt1 = &keypoints1->at(i).pt;
+
+			// Only search the keypoints close to the epipolar line of pt1.
+			cv::Vec3d line = F * cv::Vec3d(pt1->x, pt1->y, 1.0);
+			grid.query_line(line, this->epipolar_distance, &candidates);
+
+			float best = FLT_MAX;
+			float second = FLT_MAX;
+			int best_idx = -1;
+
+			for (std::vector<int>::const_iterator j = candidates.begin(); j != candidates.end(); ++j) {
+				float distance;
+
+				if (binary)
+					distance = hamming_distance(descriptors1->ptr<uint8_t>(i), descriptors2->ptr<uint8_t>(*j), bytes);
+				else
+					distance = cv::norm(descriptors1->row(i), descriptors2->row(*j), cv::NORM_L2);
+
+				if (distance < best) {
+					second = best;
+					best = distance;
+					best_idx = *j;
+
+				} else if (distance < second) {
+					second = distance;
+				}
 			}
 
-			MatchPoint mp;
-			mp.pt1 = keypoints1->at(match1->queryIdx).pt;
-			mp.pt2 = keypoints2->at(match1->trainIdx).pt;
-			mp.distance = match1->distance;
+			if (best_idx < 0)
+				continue;
+
+			// Ratio test, a single candidate is accepted.
+			if (best > second * this->settings.match_valid_ratio)
+				continue;
 
-			this->matches.push_back(mp);
+			if (best < best_matches[best_idx].distance)
+				best_matches[best_idx] = cv::DMatch(i, best_idx, best);
 		}
 
-		// Prepare the fundamental matrix.
-		// This will also modify the match, hence it needs to be done here.
-		this->calculate_fundamental_matrix();
+		// Each keypoint of image2 is only used once.
+		std::vector<cv::DMatch> good_matches;
+		for (std::vector<cv::DMatch>::const_iterator match = best_matches.begin(); match != best_matches.end(); ++match) {
+			if (match->queryIdx >= 0)
+				good_matches.push_back(*match);
+		}
+
+		this->matches.clear();
+		this->add_matches(&good_matches);
+
+		this->update_match_index();
+	}
+
+	void FeatureMatcher::add_matches(const std::vector<cv::DMatch>* good_matches) {
+		const std::vector<cv::KeyPoint>* keypoints1 = this->image1->get_keypoints();
+		const std::vector<cv::KeyPoint>* keypoints2 = this->image2->get_keypoints();
+
+		this->matches.reserve(this->matches.size() + good_matches->size());
+
+		for (std::vector<cv::DMatch>::const_iterator match = good_matches->begin(); match != good_matches->end(); ++match) {
+			this->matches.add(keypoints1->at(match->queryIdx).pt, keypoints2->at(match->trainIdx).pt,
+				match->queryIdx, match->trainIdx, match->distance);
+		}
 	}
 
 	void FeatureMatcher::draw_matches(const std::string filename) {
@@ -134,14 +253,19 @@ namespace Boxes {
 		const std::vector<cv::KeyPoint>* keypoints2 = this->image2->get_keypoints();
 
 		std::vector<cv::DMatch> matches;
-		for (MatchPoint mp: this->matches) {
-			cv::DMatch match = match_point_to_dmatch(&mp, keypoints1, keypoints2);
-			matches.push_back(match);
+		matches.reserve(this->matches.size());
+
+		for (unsigned int i = 0; i < this->matches.size(); i++) {
+			if (!this->matches.has_keypoints(i))
+				continue;
+
+			matches.push_back(cv::DMatch(this->matches.query_indices[i], this->matches.train_indices[i],
+				this->matches.distances[i]));
 		}
 
 		cv::drawMatches(*image1, *keypoints1, *image2, *keypoints2, matches, img_matches);
 
-		Image image = Image(this->boxes, img_matches);
+		Image image(this->boxes, img_matches);
 		image.write(filename);
 	}
 
@@ -150,36 +274,90 @@ namespace Boxes {
 	}
 
 	void FeatureMatcher::calculate_fundamental_matrix() {
-		std::vector<cv::Point2f> match_points1;
-		std::vector<cv::Point2f> match_points2;
-		for (std::vector<MatchPoint>::const_iterator i = this->matches.begin(); i != this->matches.end(); i++) {
-			match_points1.push_back(i->pt1);
-			match_points2.push_back(i->pt2);
-		}
-
 		double val_min = 0.0, val_max = 0.0;
-		cv::minMaxIdx(match_points1, &val_min, &val_max);
+		cv::minMaxIdx(this->matches.points1, &val_min, &val_max);
 
-		double epipolar_distance_factor = this->boxes->config->get_double("EPIPOLAR_DISTANCE_FACTOR");
 		// Snavely
-		double epipolar_distance = epipolar_distance_factor * val_max;
+		this->epipolar_distance = this->settings.epipolar_distance_factor * val_max;
+
+		std::vector<uchar> status;
+		this->putative_matches = this->matches.size();
+
+		// PROSAC draws the matches with the smallest descriptor distance first.
+		std::vector<unsigned int> order;
+		ransac_order(&this->matches.distances, &order);
+
+		if (this->settings.pose_estimator == POSE_ESTIMATOR_FIVE_POINT) {
+			this->estimate_essential_matrix(&order, &status);
+		} else {
+			FundamentalEstimator estimator(&this->matches.points1, &this->matches.points2);
+			Ransac ransac(&estimator, RansacParameters(this->settings, this->epipolar_distance), this->boxes->get_scheduler());
 
-		std::vector<uchar> status(this->matches.size());
+			RansacModel model;
+			this->ransac_result = ransac.run(&model, &status, &order);
 
-		this->fundamental_matrix = cv::findFundamentalMat(match_points1, match_points2, status,
-			cv::FM_RANSAC, epipolar_distance, 0.99);
+			if (this->ransac_result.inliers > 0)
+				this->fundamental_matrix = cv::Mat(model.matrix);
+			else
+				this->fundamental_matrix = cv::Mat();
+
+			this->essential_matrix = cv::Mat();
+		}
 
 		// Sort out bad matches.
-		std::vector<MatchPoint> best_matches;
-		for(unsigned int i = 0; i < status.size(); i++) {
-			if (status[i] == 1)
-				best_matches.push_back(this->matches[i]);
+		this->matches.filter(&status);
+		this->inlier_matches = this->matches.size();
+
+		this->update_match_index();
+	}
+
+	unsigned int FeatureMatcher::get_putative_matches() const {
+		return this->putative_matches;
+	}
+
+	double FeatureMatcher::get_inlier_ratio() const {
+		if (this->putative_matches == 0)
+			return 0.0;
+
+		return (double)this->inlier_matches / this->putative_matches;
+	}
+
+	const RansacResult* FeatureMatcher::get_ransac_result() const {
+		return &this->ransac_result;
+	}
+
+	void FeatureMatcher::estimate_essential_matrix(const std::vector<unsigned int>* order, std::vector<uchar>* status) {
+		cv::Matx33d c1 = this->image1->get_camera();
+		cv::Matx33d c2 = this->image2->get_camera();
+
+		// The estimator works on normalized image coordinates.
+		EssentialEstimator estimator(&this->matches.points1, &this->matches.points2, &c1, &c2);
+
+		// Convert the threshold in pixels with the mean focal length.
+		double focal_length = (c1(0,0) + c1(1,1) + c2(0,0) + c2(1,1)) / 4.0;
+		Ransac ransac(&estimator, RansacParameters(this->settings, this->epipolar_distance / focal_length),
+			this->boxes->get_scheduler());
+
+		RansacModel model;
+		this->ransac_result = ransac.run(&model, status, order);
+
+		if (this->ransac_result.inliers == 0) {
+			this->essential_matrix = cv::Mat();
+			this->fundamental_matrix = cv::Mat();
+			return;
 		}
 
-		this->matches = best_matches;
+		this->essential_matrix = cv::Mat(model.matrix);
+
+		// Guided matching and drawing still need the fundamental matrix.
+		this->fundamental_matrix = cv::Mat(c2.inv().t() * model.matrix * c1.inv());
 	}
 
 	cv::Mat FeatureMatcher::calculate_essential_matrix() {
+		// The five-point estimator has found it directly.
+		if (!this->essential_matrix.empty())
+			return this->essential_matrix;
+
 		cv::Mat camera = this->image1->get_camera();
 
 		return camera.t() * this->fundamental_matrix * camera;
@@ -250,27 +428,46 @@ namespace Boxes {
 		std::vector<CameraMatrix*> camera_matrices = \
 			this->calculate_possible_camera_matrices(&essential_matrix);
 
-		cv::Matx34d P0 = cv::Matx34d::eye();
+		// Only coherent rotation matrices are candidates.
+		std::vector<CameraMatrix*> candidates;
+		std::vector<cv::Matx34d> candidate_matrices;
 
-		CameraMatrix* best_matrix = NULL;
 		for (std::vector<CameraMatrix*>::iterator i = camera_matrices.begin(); i != camera_matrices.end(); ++i) {
-			CameraMatrix* camera_matrix = *i;
-
-			// Check for coherency of the rotation matrix.
-			if (!camera_matrix->rotation_is_coherent())
+			if (!(*i)->rotation_is_coherent())
 				continue;
 
-			// Pick first matrix as the best one until we know better.
-			if (!best_matrix)
-				best_matrix = &(*camera_matrix);
+			candidates.push_back(*i);
+			candidate_matrices.push_back((*i)->matrix);
+		}
 
-			// Triangulate.
-			this->triangulate_points(&P0, &(camera_matrix->matrix), camera_matrix->point_cloud);
+		if (candidates.empty()) {
+			for (std::vector<CameraMatrix*>::iterator i = camera_matrices.begin(); i != camera_matrices.end(); ++i)
+				delete *i;
 
-			// Count all points that are "in front of the camera".
-			if (camera_matrix->percentage_of_points_in_front_of_camera() > best_matrix->percentage_of_points_in_front_of_camera()) {
-				best_matrix = &(*camera_matrix);
-				continue;
+			throw std::runtime_error("Could not find a coherent camera matrix");
+		}
+
+		/*
+		 * Only the right pose has the points in front of both cameras.
+		 * A small random sample of the matches is enough to tell which one
+		 * it is, so we do not need to triangulate all points four times.
+		 */
+		std::vector<cv::Vec2d> x1;
+		std::vector<cv::Vec2d> x2;
+		this->sample_normalized_matches(CHEIRALITY_SAMPLE_SIZE, &x1, &x2);
+
+		std::vector<unsigned int> counts(candidates.size());
+		count_points_in_front(x1.data(), x2.data(), x1.size(),
+			&candidate_matrices[0], candidate_matrices.size(), &counts[0]);
+
+		// Pick the first matrix on a tie.
+		CameraMatrix* best_matrix = candidates[0];
+		unsigned int best_count = counts[0];
+
+		for (unsigned int i = 1; i < candidates.size(); i++) {
+			if (counts[i] > best_count) {
+				best_matrix = candidates[i];
+				best_count = counts[i];
 			}
 		}
 
@@ -282,13 +479,53 @@ namespace Boxes {
 			delete *i;
 		}
 
+		// Triangulate the winning pose only.
+		cv::Matx34d P0 = cv::Matx34d::eye();
+		this->triangulate_points(&P0, &(best_matrix->matrix), best_matrix->point_cloud);
+
 		this->point_cloud->clear();
 		this->point_cloud->merge(best_matrix->point_cloud);
-		this->image2->update_camera_matrix(best_matrix);
 
 		return best_matrix;
 	}
 
+	void FeatureMatcher::sample_normalized_matches(unsigned int n, std::vector<cv::Vec2d>* x1, std::vector<cv::Vec2d>* x2) const {
+		cv::Matx33d c1 = this->image1->get_camera();
+		cv::Matx33d c2 = this->image2->get_camera();
+
+		cv::Matx33d c1_inv = c1.inv();
+		cv::Matx33d c2_inv = c2.inv();
+
+		unsigned int size = this->matches.size();
+
+		// Use all matches if there are only a few.
+		bool sample = (size > n);
+		if (sample)
+			size = n;
+
+		x1->resize(size);
+		x2->resize(size);
+
+		// Always draw the same sample, so that results are reproducible.
+		cv::RNG rng(CHEIRALITY_SEED);
+
+		for (unsigned int i = 0; i < size; i++) {
+			unsigned int j = sample ? rng.uniform(0, (int)this->matches.size()) : i;
+
+			const cv::Point2f* pt1 = &this->matches.points1[j];
+			const cv::Point2f* pt2 = &this->matches.points2[j];
+
+			(*x1)[i] = cv::Vec2d(
+				c1_inv(0,0) * pt1->x + c1_inv(0,1) * pt1->y + c1_inv(0,2),
+				c1_inv(1,0) * pt1->x + c1_inv(1,1) * pt1->y + c1_inv(1,2)
+			);
+			(*x2)[i] = cv::Vec2d(
+				c2_inv(0,0) * pt2->x + c2_inv(0,1) * pt2->y + c2_inv(0,2),
+				c2_inv(1,0) * pt2->x + c2_inv(1,1) * pt2->y + c2_inv(1,2)
+			);
+		}
+	}
+
 	double FeatureMatcher::triangulate_points() {
 		return this->triangulate_points(
 			&this->image1->camera_matrix->matrix,
@@ -298,131 +535,129 @@ namespace Boxes {
 	}
 
 	double FeatureMatcher::triangulate_points(const cv::Matx34d* p1, const cv::Matx34d* p2, PointCloud* point_cloud) {
-		cv::Mat c1 = this->image1->get_camera();
-		cv::Mat c1_inv = c1.inv();
-		cv::Mat c2 = this->image2->get_camera();
-		cv::Mat c2_inv = c2.inv();
+		cv::Matx33d c1 = this->image1->get_camera();
+		cv::Matx33d c2 = this->image2->get_camera();
 
-		cv::Mat_<double> KP2 = c2 * cv::Mat(*p2);
+		int n = this->matches.size();
+		int batches = (n + TRIANGULATION_BATCH_SIZE - 1) / TRIANGULATION_BATCH_SIZE;
 
-		#pragma omp parallel for
-		for (unsigned int i = 0; i < this->matches.size(); i++) {
-			const MatchPoint* match = &this->matches[i];
+		/*
+		 * Every batch writes to its own range of the output, so no thread
+		 * has to wait for another one and the order of the points does not
+		 * depend on the number of threads.
+		 */
+		std::vector<cv::Point3d> points(n);
+		std::vector<double> reprojection_errors(n);
+		std::vector<uchar> valid(n);
+
+		// Number of valid points per batch, shifted by one for the prefix sum.
+		std::vector<int> offsets(batches + 1, 0);
 
-			// Create CloudPoint object.
-			CloudPoint cloud_point;
-			cloud_point.pt1 = match->pt1;
-			cloud_point.pt2 = match->pt2;
+		Scheduler* scheduler = this->boxes->get_scheduler();
 
-			cv::Point3d match_point_3d1(cloud_point.pt1.x, cloud_point.pt1.y, 1.0);
-			cv::Point3d match_point_3d2(cloud_point.pt2.x, cloud_point.pt2.y, 1.0);
+		scheduler->parallel_for(0, batches, TRIANGULATION_BATCHES_PER_TASK, [&](unsigned int batch) {
+			int start = batch * TRIANGULATION_BATCH_SIZE;
+			int size = std::min(n - start, TRIANGULATION_BATCH_SIZE);
 
-			cv::Mat_<double> match_point_3d1i = c1_inv * cv::Mat_<double>(match_point_3d1);
-			cv::Mat_<double> match_point_3d2i = c2_inv * cv::Mat_<double>(match_point_3d2);
+			triangulate_correspondences(&this->matches.points1[start], &this->matches.points2[start], size,
+				c1, *p1, c2, *p2, &points[start], &reprojection_errors[start], &valid[start]);
 
-			match_point_3d1.x = match_point_3d1i(0);
-			match_point_3d1.y = match_point_3d1i(1);
-			match_point_3d1.z = match_point_3d1i(2);
+			int count = 0;
+			for (int i = start; i < start + size; i++) {
+				if (valid[i])
+					count++;
+			}
+			offsets[batch + 1] = count;
+		});
+
+		for (int batch = 0; batch < batches; batch++)
+			offsets[batch + 1] += offsets[batch];
 
-			match_point_3d2.x = match_point_3d2i(0);
-			match_point_3d2.y = match_point_3d2i(1);
-			match_point_3d2.z = match_point_3d2i(2);
+		// Compact all valid points into the final order.
+		std::vector<CloudPoint> cloud_points(offsets[batches]);
 
-			// Triangulate one point.
-			cv::Mat_<double> X = this->triangulate_one_point(&match_point_3d1, p1, &match_point_3d2, p2);
+		scheduler->parallel_for(0, batches, TRIANGULATION_BATCHES_PER_TASK, [&](unsigned int batch) {
+			int start = batch * TRIANGULATION_BATCH_SIZE;
+			int size = std::min(n - start, TRIANGULATION_BATCH_SIZE);
 
-			// Reproject X.
-			cv::Mat_<double> X_reproj = KP2 * X;
-			cv::Point2f X_reproj_point = cv::Point2f(X_reproj(0) / X_reproj(2), X_reproj(1) / X_reproj(2));
+			CloudPoint* cloud_point = &cloud_points[offsets[batch]];
+
+			for (int i = start; i < start + size; i++) {
+				// Drop points of degenerate correspondences.
+				if (!valid[i])
+					continue;
 
-			cloud_point.pt = cv::Point3d(X(0), X(1), X(2));
-			cloud_point.set_colour_from_image(this->image2);
+				cloud_point->pt1 = this->matches.points1[i];
+				cloud_point->pt2 = this->matches.points2[i];
+				cloud_point->queryIdx = this->matches.query_indices[i];
+				cloud_point->trainIdx = this->matches.train_indices[i];
 
-			// Calculate the reprojection error.
-			cloud_point.reprojection_error = cv::norm(X_reproj_point - cloud_point.pt2);
+				cloud_point->pt = points[i];
+				cloud_point->set_colour_from_image(this->image2);
 
-			#pragma omp critical
-			{
-				point_cloud->add_point(cloud_point);
-				#pragma omp flush(point_cloud)
+				cloud_point->reprojection_error = reprojection_errors[i];
+				cloud_point++;
 			}
-		}
+		});
 
-		// Calculate mean reprojection error.
-		std::vector<double> reproj_errors(point_cloud->size());
-		const std::vector<CloudPoint>* points = point_cloud->get_points();
+		point_cloud->add_points(&cloud_points);
 
-		for (std::vector<CloudPoint>::const_iterator i = points->begin(); i != points->end(); ++i) {
-			reproj_errors.push_back(i->reprojection_error);
-		}
+		// Calculate mean reprojection error, always summed up in the same order.
+		double sum = 0.0;
+		for (std::vector<CloudPoint>::const_iterator i = cloud_points.begin(); i != cloud_points.end(); ++i)
+			sum += i->reprojection_error;
 
-		cv::Scalar mse = cv::mean(reproj_errors);
-		this->reprojection_error = mse[0];
-		return mse[0];
+		this->reprojection_error = cloud_points.empty() ? 0.0 : sum / cloud_points.size();
+		return this->reprojection_error;
 	}
 
-	cv::Mat_<double> FeatureMatcher::triangulate_one_point(const cv::Point3d* p1, const cv::Matx34d* c1, const cv::Point3d* p2, const cv::Matx34d* c2) {
-		cv::Mat_<double> X;
+	// Packs the coordinates of a point into one key, so that equal points have equal keys.
+	static inline uint64_t point_key(const cv::Point2f* pt) {
+		uint32_t x, y;
+		memcpy(&x, &pt->x, sizeof(x));
+		memcpy(&y, &pt->y, sizeof(y));
 
-		// Initialize weights
-		double weight1 = 1.0;
-		double weight2 = 1.0;
+		return ((uint64_t)x << 32) | y;
+	}
 
-		X = this->_triangulate_one_point(p1, c1, p2, c2);
+	void FeatureMatcher::update_match_index() {
+		this->keypoint_matches.clear();
+		this->coordinate_matches.clear();
 
-		// It is suggested to run 10 iterations at most.
-		for (unsigned int i = 0; i < TRIANGULATION_MAX_ITERATIONS; i++) {
-			// Recalculate weights
-			double weight1_ = cv::Mat_<double>(cv::Mat_<double>(*c1).row(2) * X)(0);
-			double weight2_ = cv::Mat_<double>(cv::Mat_<double>(*c2).row(2) * X)(0);
+		for (unsigned int i = 0; i < this->matches.size(); i++) {
+			int keypoint_idx = this->matches.query_indices[i];
 
-			// Stop the loop, if the gained precision is smaller than epsilon.
-			if ((fabsf(weight1 - weight1_) <= TRIANGULATION_EPSILON) && (fabsf(weight2 - weight2_) <= TRIANGULATION_EPSILON))
-				break;
+			// Optical flow matches do not have any keypoints.
+			if (keypoint_idx == MATCH_NO_KEYPOINT) {
+				this->coordinate_matches.insert(std::make_pair(point_key(&this->matches.points1[i]), i));
+				continue;
+			}
 
-			// Otherwise use new weights and re-weight the equations.
-			weight1 = weight1_;
-			weight2 = weight2_;
+			if ((unsigned int)keypoint_idx >= this->keypoint_matches.size())
+				this->keypoint_matches.resize(keypoint_idx + 1, -1);
 
-			X = this->_triangulate_one_point(p1, c1, p2, c2, weight1, weight2);
+			if (this->keypoint_matches[keypoint_idx] < 0)
+				this->keypoint_matches[keypoint_idx] = i;
 		}
-
-		return X;
 	}
 
-	cv::Mat_<double> FeatureMatcher::_triangulate_one_point(const cv::Point3d* p1, const cv::Matx34d* c1, const cv::Point3d* p2, const cv::Matx34d* c2, double weight1, double weight2) {
-		cv::Matx43d A(
-			(p1->x * (*c1)(2,0) - (*c1)(0,0)) / weight1, (p1->x * (*c1)(2,1) - (*c1)(0,1)) / weight1, (p1->x * (*c1)(2,2) - (*c1)(0,2)) / weight1,
-			(p1->y * (*c1)(2,0) - (*c1)(1,0)) / weight1, (p1->y * (*c1)(2,1) - (*c1)(1,1)) / weight1, (p1->y * (*c1)(2,2) - (*c1)(1,2)) / weight1,
-			(p2->x * (*c2)(2,0) - (*c2)(0,0)) / weight2, (p2->x * (*c2)(2,1) - (*c2)(0,1)) / weight2, (p2->x * (*c2)(2,2) - (*c2)(0,2)) / weight2,
-			(p2->y * (*c2)(2,0) - (*c2)(1,0)) / weight2, (p2->y * (*c2)(2,1) - (*c2)(1,1)) / weight2, (p2->y * (*c2)(2,2) - (*c2)(1,2)) / weight2
-		);
-
-		cv::Matx41d B(
-			-(p1->x * (*c1)(2,3) - (*c1)(0,3)) / weight1,
-			-(p1->y * (*c1)(2,3) - (*c1)(1,3)) / weight1,
-			-(p2->x * (*c2)(2,3) - (*c2)(0,3)) / weight2,
-			-(p2->y * (*c2)(2,3) - (*c2)(1,3)) / weight2
-		);
-
-		cv::Mat_<double> X;
-		cv::solve(A, B, X, cv::DECOMP_SVD);
-
-		cv::Mat_<double> Y(4,1);
-		Y(0) = X(0);
-		Y(1) = X(1);
-		Y(2) = X(2);
-		Y(3) = 1.0;
-
-		return Y;
+	const MatchTable* FeatureMatcher::get_matches() const {
+		return &this->matches;
 	}
 
-	cv::Point2f* FeatureMatcher::find_corresponding_keypoint_coordinates(cv::Point2f* pt1) const {
-		for (MatchPoint match: this->matches) {
-			if (match.pt1 == *pt1)
-				return new cv::Point2f(match.pt2);
+	int FeatureMatcher::find_match(int keypoint_idx, const cv::Point2f* pt1) const {
+		if (keypoint_idx != MATCH_NO_KEYPOINT) {
+			if ((unsigned int)keypoint_idx < this->keypoint_matches.size() && this->keypoint_matches[keypoint_idx] >= 0)
+				return this->keypoint_matches[keypoint_idx];
 		}
 
-		return NULL;
+		if (this->coordinate_matches.empty())
+			return -1;
+
+		std::unordered_map<uint64_t, int>::const_iterator i = this->coordinate_matches.find(point_key(pt1));
+		if (i == this->coordinate_matches.end())
+			return -1;
+
+		return i->second;
 	}
 }
@@ -17,89 +17,177 @@
 	along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <math.h>
+#include <memory>
 #include <opencv2/opencv.hpp>
 #include <vector>
 
+#include <boxes/config.h>
 #include <boxes/constants.h>
 #include <boxes/converters.h>
+#include <boxes/descriptor_index.h>
 #include <boxes/feature_matcher_optical_flow.h>
+#include <boxes/optical_flow.h>
+#include <boxes/point_grid.h>
+#include <boxes/scheduler.h>
 
 namespace Boxes {
 	void FeatureMatcherOpticalFlow::match() {
 		// Remove any stale matches that might be in here.
 		this->matches.clear();
 
-#ifdef OPTICAL_FLOW_ALGO_FARNEBACK
-		cv::Mat flow;
-		cv::Mat greyscale1 = *this->image1->get_greyscale_mat();
-		cv::Mat greyscale2 = *this->image2->get_greyscale_mat();
+		std::unique_ptr<OpticalFlow> optical_flow(
+			OpticalFlow::create(this->settings, this->boxes->get_scheduler()));
 
-		cv::calcOpticalFlowFarneback(greyscale1, greyscale2, flow, 0.5, 3, 15, 3, 5, 1.2, 0);
+		if (optical_flow->is_dense())
+			this->match_dense(optical_flow.get());
+		else
+			this->match_sparse(optical_flow.get());
+	}
+
+	void FeatureMatcherOpticalFlow::match_dense(const OpticalFlow* optical_flow) {
+		const Settings& settings = this->settings;
+
+		// The flow back from the second image tells which flow vectors can be trusted.
+		bool check = (settings.optical_flow_max_error > 0.0);
+
+		Scheduler* scheduler = this->boxes->get_scheduler();
+		TaskGroup group;
+
+		// Both images are most likely part of another pair, too, which may build their pyramids.
+		const std::vector<cv::Mat>* pyramid1 = NULL;
+		const std::vector<cv::Mat>* pyramid2 = NULL;
+
+		scheduler->run(&group, [&]() {
+			pyramid1 = optical_flow->get_pyramid(this->image1);
+		});
+		scheduler->run(&group, [&]() {
+			pyramid2 = optical_flow->get_pyramid(this->image2);
+		});
+
+		scheduler->wait(&group);
+
+		cv::Mat forward;
+		cv::Mat backward;
+
+		scheduler->run(&group, [&]() {
+			optical_flow->calculate(pyramid1, pyramid2, &forward);
+		});
+
+		if (check) {
+			scheduler->run(&group, [&]() {
+				optical_flow->calculate(pyramid2, pyramid1, &backward);
+			});
+		}
+
+		scheduler->wait(&group);
+
+		/*
+		 * Only every stride-th pixel in both directions becomes a match,
+		 * and only if following the flow there and back again ends close
+		 * to where it started. The distance of a match is that error.
+		 */
+		int stride = settings.optical_flow_stride;
+		float max_error2 = settings.optical_flow_max_error * settings.optical_flow_max_error;
+
+		this->matches.reserve(((forward.rows + stride - 1) / stride) * ((forward.cols + stride - 1) / stride));
+
+		for (int y = 0; y < forward.rows; y += stride) {
+			const cv::Point2f* f = forward.ptr<cv::Point2f>(y);
+
+			for (int x = 0; x < forward.cols; x += stride) {
+				cv::Point2f pt1(x, y);
+				cv::Point2f pt2 = pt1 + f[x];
+				float error2 = 0.0;
+
+				if (check) {
+					int x2 = cvRound(pt2.x);
+					int y2 = cvRound(pt2.y);
+
+					// Flow that leaves the second image cannot be checked.
+					if (x2 < 0 || y2 < 0 || x2 >= backward.cols || y2 >= backward.rows)
+						continue;
 
-		for (int y = 0; y < flow.rows; y++) {
-			for (int x = 0; x < flow.cols; x++) {
-				cv::Point2f f = flow.at<cv::Point2f>(y, x);
+					cv::Point2f d = f[x] + backward.at<cv::Point2f>(y2, x2);
 
-				MatchPoint mp;
-				mp.pt1 = cv::Point2f(x, y);
-				mp.pt2 = cv::Point2f(x + f.x, y + f.y);
-				this->matches.push_back(mp);
+					error2 = d.x * d.x + d.y * d.y;
+					if (error2 > max_error2)
+						continue;
+				}
+
+				// Dense flow does not belong to any keypoints.
+				this->matches.add(pt1, pt2, MATCH_NO_KEYPOINT, MATCH_NO_KEYPOINT, sqrt(error2));
 			}
 		}
 
 		this->calculate_fundamental_matrix();
+	}
+
+	void FeatureMatcherOpticalFlow::match_sparse(const OpticalFlow* optical_flow) {
+		const Settings& settings = this->settings;
+
+		const std::vector<cv::Mat>* pyramid1 = optical_flow->get_pyramid(this->image1);
+		const std::vector<cv::Mat>* pyramid2 = optical_flow->get_pyramid(this->image2);
+
+		std::vector<cv::Point2f> points1;
+		if (settings.lk_gftt)
+			points1 = this->image1->get_good_features_to_track();
+		else
+			points1 = convertKeyPoints(this->image1->get_keypoints());
 
-#else
-		// Convert images to greyscale.
-		cv::Mat greyscale1 = *this->image1->get_greyscale_mat();
-		cv::Mat greyscale2 = *this->image2->get_greyscale_mat();
+		// Calculate how each point1 moved across the two images.
+		std::vector<cv::Point2f> tracked_points;
+		std::vector<uchar> status;
 
-		std::vector<MatchPoint> match_points;
+		optical_flow->track(pyramid1, pyramid2, &points1, &tracked_points, &status);
+
+		// Good features to track do not belong to any keypoints.
+		if (settings.lk_gftt) {
+			for (unsigned int i = 0; i < status.size(); i++) {
+				if (status[i])
+					this->matches.add(points1[i], tracked_points[i], MATCH_NO_KEYPOINT, MATCH_NO_KEYPOINT, 0.0);
+			}
+
+			this->calculate_fundamental_matrix();
+			return;
+		}
 
-# ifdef OPTICAL_FLOW_USE_GFTT
-		std::vector<cv::Point2f> points1 = this->image1->get_good_features_to_track();
-		std::vector<cv::Point2f> points2 = this->image2->get_good_features_to_track();
-# else
-		std::vector<cv::KeyPoint>* keypoints1 = this->image1->get_keypoints();
-		std::vector<cv::KeyPoint>* keypoints2 = this->image2->get_keypoints();
+		/*
+		 * Each tracked point becomes the keypoint of the second image that is
+		 * closest to it, unless another keypoint is almost as close.
+		 */
+		const std::vector<cv::KeyPoint>* keypoints2 = this->image2->get_keypoints();
 
-		std::vector<cv::Point2f> points1 = convertKeyPoints(keypoints1);
 		std::vector<cv::Point2f> points2 = convertKeyPoints(keypoints2);
-# endif
-		std::vector<cv::Point2f> points2x(points1.size());
+		PointGrid grid(&points2);
 
-		cv::Size search_window_size = cv::Size(OF_SEARCH_WINDOW_SIZE, OF_SEARCH_WINDOW_SIZE);
+		std::vector<std::vector<cv::DMatch>> nearest_neighbours;
+		nearest_neighbours.reserve(status.size());
 
-		std::vector<uchar> vstatus;
-		std::vector<float> verror;
+		for (unsigned int i = 0; i < status.size(); i++) {
+			if (!status[i])
+				continue;
 
-		// Calculate the optical flow field, i.e. how each point1 moved across the two images
-		cv::calcOpticalFlowPyrLK(greyscale1, greyscale2, points1, points2x, vstatus, verror,
-			search_window_size, OF_MAX_PYRAMIDS);
+			std::vector<cv::DMatch> neighbours;
+			grid.query_nearest(tracked_points[i], OF_RADIUS_MATCH, 2, &neighbours);
 
-		// First, filter out the points with high error.
-		for (unsigned int i = 0; i < vstatus.size(); i++) {
-			// Save good points with a low error rate.
-			if (vstatus[i] && verror[i] < OF_MAX_VERROR) {
-				MatchPoint match_point;
-				match_point.pt1 = points1[i];
-				match_point.pt2 = points2x[i];
+			for (std::vector<cv::DMatch>::iterator neighbour = neighbours.begin(); neighbour != neighbours.end(); ++neighbour)
+				neighbour->queryIdx = i;
 
-				match_points.push_back(match_point);
-			}
+			nearest_neighbours.push_back(neighbours);
 		}
 
-		std::vector<cv::Point2f> good_points1;
-		for (std::vector<MatchPoint>::const_iterator i = match_points.begin(); i != match_points.end(); ++i) {
-			good_points1.push_back(i->pt1);
-		}
+		std::vector<cv::DMatch> good_matches;
+		DescriptorIndex::ratio_test(&nearest_neighbours, settings.match_valid_ratio, &good_matches);
+
+		this->matches.reserve(good_matches.size());
 
-		// Format appropriate data structures.
-		cv::Mat good_points1_flat = cv::Mat(good_points1).reshape(1, good_points1.size());
-		cv::Mat points2_flat = cv::Mat(points2).reshape(1, points2.size());
+		for (std::vector<cv::DMatch>::const_iterator match = good_matches.begin(); match != good_matches.end(); ++match) {
+			this->matches.add(points1[match->queryIdx], keypoints2->at(match->trainIdx).pt,
+				match->queryIdx, match->trainIdx, match->distance);
+		}
 
-		this->_match(&good_points1_flat, &points2_flat, &match_points, MATCH_TYPE_RADIUS, CV_L2);
-#endif
+		this->calculate_fundamental_matrix();
 	}
 
 	void FeatureMatcherOpticalFlow::draw_matches(const std::string filename) {
@@ -110,16 +198,12 @@ namespace Boxes {
 
 		const int step = 4;
 
-		int counter = 0;
-		for (MatchPoint mp: this->matches) {
-			if (counter++ % step)
-				continue;
-
-			cv::line(img_matches, mp.pt1, mp.pt2, colour1);
-			cv::circle(img_matches, mp.pt1, 2, colour2, -1);
+		for (unsigned int i = 0; i < this->matches.size(); i += step) {
+			cv::line(img_matches, this->matches.points1[i], this->matches.points2[i], colour1);
+			cv::circle(img_matches, this->matches.points1[i], 2, colour2, -1);
 		}
 
-		Image image = Image(this->boxes, img_matches);
+		Image image(this->boxes, img_matches);
 		image.write(filename);
 	}
 }
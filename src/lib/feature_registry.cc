@@ -0,0 +1,168 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <opencv2/features2d/features2d.hpp>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <string>
+
+#ifdef BOXES_NONFREE
+# include <opencv2/nonfree/features2d.hpp>
+#endif
+
+#include <boxes/boxes.h>
+#include <boxes/config.h>
+#include <boxes/constants.h>
+#include <boxes/feature_registry.h>
+
+namespace Boxes {
+	/*
+	 * Contructor.
+	 */
+	FeatureRegistry::FeatureRegistry(Boxes* boxes) {
+		this->boxes = boxes;
+
+		this->register_defaults();
+	}
+
+	FeatureRegistry::~FeatureRegistry() {
+		this->reset();
+	}
+
+	void FeatureRegistry::register_defaults() {
+		// Detectors
+
+		this->register_detector(FEATURE_DETECTOR_FAST, [](const Settings& settings) {
+			return cv::Ptr<cv::FeatureDetector>(new cv::FastFeatureDetector());
+		});
+
+		this->register_detector(FEATURE_DETECTOR_GFTT, [](const Settings& settings) {
+			return cv::Ptr<cv::FeatureDetector>(new cv::GoodFeaturesToTrackDetector());
+		});
+
+		this->register_detector(FEATURE_DETECTOR_ORB, [](const Settings& settings) {
+			return cv::Ptr<cv::FeatureDetector>(new cv::OrbFeatureDetector());
+		});
+
+		this->register_detector(FEATURE_DETECTOR_PYRAMID_FAST, [](const Settings& settings) {
+			cv::Ptr<cv::FeatureDetector> detector = cv::Ptr<cv::FeatureDetector>(new cv::FastFeatureDetector());
+
+			return cv::Ptr<cv::FeatureDetector>(new cv::PyramidAdaptedFeatureDetector(detector));
+		});
+
+#ifdef BOXES_NONFREE
+		this->register_detector(FEATURE_DETECTOR_SIFT, [](const Settings& settings) {
+			return cv::Ptr<cv::FeatureDetector>(new cv::SiftFeatureDetector());
+		});
+
+		this->register_detector(FEATURE_DETECTOR_SURF, [](const Settings& settings) {
+			return cv::Ptr<cv::FeatureDetector>(new cv::SurfFeatureDetector(settings.surf_min_hessian));
+		});
+#endif
+
+		// Extractors
+
+		this->register_extractor(FEATURE_DETECTOR_EXTRACTOR_ORB, [](const Settings& settings) {
+			return cv::Ptr<cv::DescriptorExtractor>(new cv::OrbDescriptorExtractor());
+		});
+
+#ifdef BOXES_NONFREE
+		this->register_extractor(FEATURE_DETECTOR_EXTRACTOR_SIFT, [](const Settings& settings) {
+			return cv::Ptr<cv::DescriptorExtractor>(new cv::SiftDescriptorExtractor(48, 16, true));
+		});
+
+		this->register_extractor(FEATURE_DETECTOR_EXTRACTOR_SURF, [](const Settings& settings) {
+			return cv::Ptr<cv::DescriptorExtractor>(new cv::SurfDescriptorExtractor());
+		});
+#endif
+	}
+
+	void FeatureRegistry::register_detector(const std::string name, FeatureDetectorFactory factory) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		this->detector_factories[name] = factory;
+	}
+
+	void FeatureRegistry::register_extractor(const std::string name, DescriptorExtractorFactory factory) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		this->extractor_factories[name] = factory;
+	}
+
+	bool FeatureRegistry::has_detector(const std::string name) const {
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		return (this->detector_factories.find(name) != this->detector_factories.end());
+	}
+
+	bool FeatureRegistry::has_extractor(const std::string name) const {
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		return (this->extractor_factories.find(name) != this->extractor_factories.end());
+	}
+
+	cv::FeatureDetector* FeatureRegistry::get_detector(const std::string name) {
+		// Fetch the settings before locking, to keep the lock order of Boxes::compile_settings().
+		const Settings& settings = this->boxes->get_settings();
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		std::pair<std::thread::id, std::string> key = std::make_pair(std::this_thread::get_id(), name);
+
+		cv::Ptr<cv::FeatureDetector>& detector = this->detectors[key];
+		if (detector.empty()) {
+			std::map<std::string, FeatureDetectorFactory>::const_iterator factory = this->detector_factories.find(name);
+
+			if (factory == this->detector_factories.end())
+				throw std::runtime_error("Unknown feature detector: " + name);
+
+			detector = factory->second(settings);
+		}
+
+		return detector;
+	}
+
+	cv::DescriptorExtractor* FeatureRegistry::get_extractor(const std::string name) {
+		// Fetch the settings before locking, to keep the lock order of Boxes::compile_settings().
+		const Settings& settings = this->boxes->get_settings();
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		std::pair<std::thread::id, std::string> key = std::make_pair(std::this_thread::get_id(), name);
+
+		cv::Ptr<cv::DescriptorExtractor>& extractor = this->extractors[key];
+		if (extractor.empty()) {
+			std::map<std::string, DescriptorExtractorFactory>::const_iterator factory = this->extractor_factories.find(name);
+
+			if (factory == this->extractor_factories.end())
+				throw std::runtime_error("Unknown descriptor extractor: " + name);
+
+			extractor = factory->second(settings);
+		}
+
+		return extractor;
+	}
+
+	void FeatureRegistry::reset() {
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		this->detectors.clear();
+		this->extractors.clear();
+	}
+}
@@ -0,0 +1,183 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include <boxes/config.h>
+#include <boxes/constants.h>
+#include <boxes/feature_tracker.h>
+#include <boxes/image.h>
+#include <boxes/optical_flow.h>
+#include <boxes/structs.h>
+
+namespace Boxes {
+	/*
+	 * Contructor.
+	 */
+	FeatureTracker::FeatureTracker(Boxes* boxes) {
+		this->boxes = boxes;
+
+		this->optical_flow = new OpticalFlowLucasKanade(this->boxes->get_settings(), this->boxes->get_scheduler());
+	}
+
+	FeatureTracker::~FeatureTracker() {
+		delete this->optical_flow;
+	}
+
+	void FeatureTracker::start(Image* image) {
+		this->image = image;
+		this->image_index = 0;
+
+		this->tracks.clear();
+		this->live.clear();
+
+		this->detect();
+	}
+
+	void FeatureTracker::track(Image* image, std::vector<MatchPoint>* match_points) {
+		const Settings& settings = this->boxes->get_settings();
+
+		match_points->clear();
+
+		const std::vector<cv::Mat>* pyramid1 = this->optical_flow->get_pyramid(this->image);
+		const std::vector<cv::Mat>* pyramid2 = this->optical_flow->get_pyramid(image);
+
+		std::vector<cv::Point2f> points1;
+		points1.reserve(this->live.size());
+
+		for (std::vector<unsigned int>::const_iterator t = this->live.begin(); t != this->live.end(); ++t)
+			points1.push_back(this->tracks[*t].points.back());
+
+		std::vector<cv::Point2f> points2;
+		std::vector<uchar> status;
+
+		this->optical_flow->track(pyramid1, pyramid2, &points1, &points2, &status);
+
+		// Tracking back to the last image tells which tracks can be trusted.
+		std::vector<cv::Point2f> points1_back;
+		std::vector<uchar> status_back;
+
+		bool check = (settings.optical_flow_max_error > 0.0);
+		if (check)
+			this->optical_flow->track(pyramid2, pyramid1, &points2, &points1_back, &status_back);
+
+		cv::Size size = image->size();
+
+		std::vector<unsigned int> survivors;
+		survivors.reserve(this->live.size());
+		match_points->reserve(this->live.size());
+
+		for (unsigned int i = 0; i < status.size(); i++) {
+			if (!status[i])
+				continue;
+
+			const cv::Point2f& pt2 = points2[i];
+			if (pt2.x < 0 || pt2.y < 0 || pt2.x > size.width - 1 || pt2.y > size.height - 1)
+				continue;
+
+			double error = 0.0;
+
+			if (check) {
+				if (!status_back[i])
+					continue;
+
+				cv::Point2f d = points1_back[i] - points1[i];
+
+				error = sqrt(d.x * d.x + d.y * d.y);
+				if (error > settings.optical_flow_max_error)
+					continue;
+			}
+
+			unsigned int t = this->live[i];
+			this->tracks[t].points.push_back(pt2);
+
+			MatchPoint match_point;
+			match_point.pt1 = points1[i];
+			match_point.pt2 = pt2;
+			match_point.distance = error;
+
+			match_points->push_back(match_point);
+			survivors.push_back(t);
+		}
+
+		this->live.swap(survivors);
+
+		// Tracks never go back, so a long sequence only keeps two pyramids around.
+		this->optical_flow->release_pyramid(this->image);
+
+		this->image = image;
+		this->image_index++;
+
+		// Only look for new features when too many have been lost.
+		if (this->live.size() < (unsigned int)settings.tracking_min_features)
+			this->detect();
+	}
+
+	void FeatureTracker::detect() {
+		const Settings& settings = this->boxes->get_settings();
+
+		int max_corners = settings.tracking_max_features - this->live.size();
+		if (max_corners <= 0)
+			return;
+
+		// Regions around the live tracks are taken.
+		cv::Mat mask(this->image->size(), CV_8U, cv::Scalar(255));
+
+		for (std::vector<unsigned int>::const_iterator t = this->live.begin(); t != this->live.end(); ++t)
+			cv::circle(mask, this->tracks[*t].points.back(), TRACKING_MIN_DISTANCE, cv::Scalar(0), -1);
+
+		std::vector<cv::Point2f> corners = this->image->get_good_features_to_track(max_corners,
+			TRACKING_QUALITY_LEVEL, TRACKING_MIN_DISTANCE, &mask);
+
+		for (std::vector<cv::Point2f>::const_iterator corner = corners.begin(); corner != corners.end(); ++corner) {
+			FeatureTrack track;
+			track.first = this->image_index;
+			track.points.push_back(*corner);
+
+			this->live.push_back(this->tracks.size());
+			this->tracks.push_back(track);
+		}
+	}
+
+	const std::vector<FeatureTrack>* FeatureTracker::get_tracks() const {
+		return &this->tracks;
+	}
+
+	unsigned int FeatureTracker::live_size() const {
+		return this->live.size();
+	}
+
+	void FeatureMatcherTracked::set_match_points(const std::vector<MatchPoint>* match_points) {
+		this->match_points = *match_points;
+	}
+
+	void FeatureMatcherTracked::match() {
+		// Remove any stale matches that might be in here.
+		this->matches.clear();
+		this->matches.reserve(this->match_points.size());
+
+		// Tracked features do not belong to any keypoints.
+		for (std::vector<MatchPoint>::const_iterator i = this->match_points.begin(); i != this->match_points.end(); ++i)
+			this->matches.add(i->pt1, i->pt2, MATCH_NO_KEYPOINT, MATCH_NO_KEYPOINT, i->distance);
+
+		this->calculate_fundamental_matrix();
+	}
+}
@@ -0,0 +1,707 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <string.h>
+#include <vector>
+
+#include <boxes/converters.h>
+#include <boxes/five_point.h>
+
+// Polynomials in x, y and z up to degree three have 20 monomials.
+#define FIVE_POINT_MONOMIALS        20
+
+// The solution polynomial in z has degree ten.
+#define FIVE_POINT_DEGREE           10
+
+#define FIVE_POINT_EPSILON          1e-12
+#define FIVE_POINT_ROOT_ITERATIONS  100
+#define FIVE_POINT_REFINE_ITERATIONS  2
+
+namespace Boxes {
+	/*
+	 * Exponents of x, y and z of all monomials in the order of Nistér's
+	 * paper. After Gauss-Jordan elimination of the constraints, the ten
+	 * leading monomials can be eliminated with the help of z.
+	 */
+	static const int monomials[FIVE_POINT_MONOMIALS][3] = {
+		{ 3, 0, 0 }, { 0, 3, 0 }, { 2, 1, 0 }, { 1, 2, 0 }, { 2, 0, 1 },
+		{ 2, 0, 0 }, { 0, 2, 1 }, { 0, 2, 0 }, { 1, 1, 1 }, { 1, 1, 0 },
+		{ 1, 0, 2 }, { 1, 0, 1 }, { 1, 0, 0 }, { 0, 1, 2 }, { 0, 1, 1 },
+		{ 0, 1, 0 }, { 0, 0, 3 }, { 0, 0, 2 }, { 0, 0, 1 }, { 0, 0, 0 },
+	};
+
+	enum {
+		MONOMIAL_X = 12,
+		MONOMIAL_Y = 15,
+		MONOMIAL_Z = 18,
+		MONOMIAL_ONE = 19,
+	};
+
+	// A polynomial in x, y and z up to degree three.
+	struct Polynomial {
+		double c[FIVE_POINT_MONOMIALS];
+	};
+
+	// Position of the product of two monomials, or -1 if its degree is larger than three.
+	struct MonomialProducts {
+		int index[FIVE_POINT_MONOMIALS][FIVE_POINT_MONOMIALS];
+
+		MonomialProducts() {
+			for (int i = 0; i < FIVE_POINT_MONOMIALS; i++) {
+				for (int j = 0; j < FIVE_POINT_MONOMIALS; j++) {
+					this->index[i][j] = -1;
+
+					for (int k = 0; k < FIVE_POINT_MONOMIALS; k++) {
+						if (monomials[k][0] == monomials[i][0] + monomials[j][0]
+								&& monomials[k][1] == monomials[i][1] + monomials[j][1]
+								&& monomials[k][2] == monomials[i][2] + monomials[j][2])
+							this->index[i][j] = k;
+					}
+				}
+			}
+		}
+	};
+
+	static const MonomialProducts monomial_products;
+
+	// r = a * b, the product must not have a degree larger than three.
+	static void multiply(const Polynomial& a, const Polynomial& b, Polynomial* r) {
+		for (int k = 0; k < FIVE_POINT_MONOMIALS; k++)
+			r->c[k] = 0.0;
+
+		for (int i = 0; i < FIVE_POINT_MONOMIALS; i++) {
+			if (IS_ZERO(a.c[i]))
+				continue;
+
+			for (int j = 0; j < FIVE_POINT_MONOMIALS; j++) {
+				if (IS_ZERO(b.c[j]))
+					continue;
+
+				r->c[monomial_products.index[i][j]] += a.c[i] * b.c[j];
+			}
+		}
+	}
+
+	// r += a * b
+	static void multiply_add(const Polynomial& a, const Polynomial& b, double scale, Polynomial* r) {
+		Polynomial product;
+		multiply(a, b, &product);
+
+		for (int k = 0; k < FIVE_POINT_MONOMIALS; k++)
+			r->c[k] += scale * product.c[k];
+	}
+
+	/*
+	 * Computes four vectors that span the null space of the 5x9 epipolar
+	 * constraint matrix with Gauss-Jordan elimination and full pivoting.
+	 */
+	static bool null_space(const cv::Vec2d* x1, const cv::Vec2d* x2, double basis[4][9]) {
+		double A[5][9];
+		int columns[9] = { 0, 1, 2, 3, 4, 5, 6, 7, 8 };
+
+		for (int i = 0; i < 5; i++) {
+			A[i][0] = x2[i][0] * x1[i][0];
+			A[i][1] = x2[i][0] * x1[i][1];
+			A[i][2] = x2[i][0];
+			A[i][3] = x2[i][1] * x1[i][0];
+			A[i][4] = x2[i][1] * x1[i][1];
+			A[i][5] = x2[i][1];
+			A[i][6] = x1[i][0];
+			A[i][7] = x1[i][1];
+			A[i][8] = 1.0;
+		}
+
+		for (int r = 0; r < 5; r++) {
+			// Find the largest remaining element.
+			int pivot_row = r, pivot_col = r;
+			for (int i = r; i < 5; i++) {
+				for (int j = r; j < 9; j++) {
+					if (fabs(A[i][j]) > fabs(A[pivot_row][pivot_col])) {
+						pivot_row = i;
+						pivot_col = j;
+					}
+				}
+			}
+
+			// The correspondences are degenerate.
+			if (fabs(A[pivot_row][pivot_col]) < FIVE_POINT_EPSILON)
+				return false;
+
+			for (int j = 0; j < 9; j++)
+				std::swap(A[r][j], A[pivot_row][j]);
+
+			for (int i = 0; i < 5; i++)
+				std::swap(A[i][r], A[i][pivot_col]);
+			std::swap(columns[r], columns[pivot_col]);
+
+			double scale = 1.0 / A[r][r];
+			for (int j = r; j < 9; j++)
+				A[r][j] *= scale;
+
+			for (int i = 0; i < 5; i++) {
+				if (i == r)
+					continue;
+
+				double factor = A[i][r];
+				for (int j = r; j < 9; j++)
+					A[i][j] -= factor * A[r][j];
+			}
+		}
+
+		// A is [I | B] now, every free column gives one vector.
+		for (int k = 0; k < 4; k++) {
+			for (int j = 0; j < 9; j++)
+				basis[k][j] = 0.0;
+
+			basis[k][columns[5 + k]] = 1.0;
+
+			for (int r = 0; r < 5; r++)
+				basis[k][columns[r]] = -A[r][5 + k];
+		}
+
+		// An orthonormal basis keeps the constraints well conditioned.
+		for (int k = 0; k < 4; k++) {
+			for (int l = 0; l < k; l++) {
+				double dot = 0.0;
+				for (int j = 0; j < 9; j++)
+					dot += basis[k][j] * basis[l][j];
+
+				for (int j = 0; j < 9; j++)
+					basis[k][j] -= dot * basis[l][j];
+			}
+
+			double norm = 0.0;
+			for (int j = 0; j < 9; j++)
+				norm += basis[k][j] * basis[k][j];
+
+			norm = 1.0 / sqrt(norm);
+			for (int j = 0; j < 9; j++)
+				basis[k][j] *= norm;
+		}
+
+		return true;
+	}
+
+	/*
+	 * Builds the ten cubic constraints on x, y and z for
+	 * E = x * X + y * Y + z * Z + W: det(E) = 0 and
+	 * 2 * E * E^T * E - trace(E * E^T) * E = 0.
+	 */
+	static void build_constraints(const double basis[4][9], double constraints[10][FIVE_POINT_MONOMIALS]) {
+		Polynomial E[3][3];
+
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				Polynomial* e = &E[i][j];
+
+				for (int k = 0; k < FIVE_POINT_MONOMIALS; k++)
+					e->c[k] = 0.0;
+
+				e->c[MONOMIAL_X] = basis[0][i * 3 + j];
+				e->c[MONOMIAL_Y] = basis[1][i * 3 + j];
+				e->c[MONOMIAL_Z] = basis[2][i * 3 + j];
+				e->c[MONOMIAL_ONE] = basis[3][i * 3 + j];
+			}
+		}
+
+		// The determinant.
+		Polynomial minor, det;
+		for (int k = 0; k < FIVE_POINT_MONOMIALS; k++)
+			det.c[k] = 0.0;
+
+		for (int j = 0; j < 3; j++) {
+			int j1 = (j + 1) % 3;
+			int j2 = (j + 2) % 3;
+
+			multiply(E[1][j1], E[2][j2], &minor);
+			multiply_add(E[1][j2], E[2][j1], -1.0, &minor);
+
+			multiply_add(E[0][j], minor, 1.0, &det);
+		}
+
+		for (int k = 0; k < FIVE_POINT_MONOMIALS; k++)
+			constraints[0][k] = det.c[k];
+
+		// E * E^T and its trace.
+		Polynomial EEt[3][3];
+		for (int i = 0; i < 3; i++) {
+			for (int j = i; j < 3; j++) {
+				multiply(E[i][0], E[j][0], &EEt[i][j]);
+				multiply_add(E[i][1], E[j][1], 1.0, &EEt[i][j]);
+				multiply_add(E[i][2], E[j][2], 1.0, &EEt[i][j]);
+
+				EEt[j][i] = EEt[i][j];
+			}
+		}
+
+		Polynomial trace;
+		for (int k = 0; k < FIVE_POINT_MONOMIALS; k++)
+			trace.c[k] = EEt[0][0].c[k] + EEt[1][1].c[k] + EEt[2][2].c[k];
+
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				Polynomial c;
+
+				multiply(trace, E[i][j], &c);
+				for (int k = 0; k < FIVE_POINT_MONOMIALS; k++)
+					c.c[k] = -c.c[k];
+
+				for (int l = 0; l < 3; l++)
+					multiply_add(EEt[i][l], E[l][j], 2.0, &c);
+
+				for (int k = 0; k < FIVE_POINT_MONOMIALS; k++)
+					constraints[1 + i * 3 + j][k] = c.c[k];
+			}
+		}
+	}
+
+	// Reduces the first ten columns to the identity.
+	static bool gauss_jordan(double A[10][FIVE_POINT_MONOMIALS]) {
+		for (int r = 0; r < 10; r++) {
+			int pivot = r;
+			for (int i = r + 1; i < 10; i++) {
+				if (fabs(A[i][r]) > fabs(A[pivot][r]))
+					pivot = i;
+			}
+
+			if (fabs(A[pivot][r]) < FIVE_POINT_EPSILON)
+				return false;
+
+			if (pivot != r) {
+				for (int j = r; j < FIVE_POINT_MONOMIALS; j++)
+					std::swap(A[r][j], A[pivot][j]);
+			}
+
+			double scale = 1.0 / A[r][r];
+			for (int j = r; j < FIVE_POINT_MONOMIALS; j++)
+				A[r][j] *= scale;
+
+			for (int i = 0; i < 10; i++) {
+				if (i == r)
+					continue;
+
+				double factor = A[i][r];
+				if (IS_ZERO(factor))
+					continue;
+
+				for (int j = r; j < FIVE_POINT_MONOMIALS; j++)
+					A[i][j] -= factor * A[r][j];
+			}
+		}
+
+		return true;
+	}
+
+	// Polynomials in z, given by their coefficients from z^0 upwards.
+
+	static double evaluate(const double* p, int degree, double z) {
+		double value = p[degree];
+
+		for (int i = degree - 1; i >= 0; i--)
+			value = value * z + p[i];
+
+		return value;
+	}
+
+	// -1, 0 or 1 by the sign of value.
+	static inline int sign(double value) {
+		return (value > 0.0) - (value < 0.0);
+	}
+
+	static void multiply(const double* a, int degree_a, const double* b, int degree_b, double* r) {
+		for (int k = 0; k <= degree_a + degree_b; k++)
+			r[k] = 0.0;
+
+		for (int i = 0; i <= degree_a; i++) {
+			for (int j = 0; j <= degree_b; j++)
+				r[i + j] += a[i] * b[j];
+		}
+	}
+
+	// Lowers the degree as long as the leading coefficient is negligible.
+	static int trim(const double* p, int degree, double scale) {
+		while (degree > 0 && fabs(p[degree]) <= FIVE_POINT_EPSILON * scale)
+			degree--;
+
+		return degree;
+	}
+
+	/*
+	 * Sturm sequence of a polynomial.
+	 *
+	 * The number of distinct real roots in (a, b] is the number of sign
+	 * changes of the sequence at a minus the one at b.
+	 */
+	struct SturmSequence {
+		double p[FIVE_POINT_DEGREE + 1][FIVE_POINT_DEGREE + 1];
+		int degree[FIVE_POINT_DEGREE + 1];
+		int length = 0;
+
+		SturmSequence(const double* polynomial, int d) {
+			for (int i = 0; i <= d; i++)
+				this->p[0][i] = polynomial[i];
+			this->degree[0] = d;
+
+			// The derivative.
+			for (int i = 1; i <= d; i++)
+				this->p[1][i - 1] = i * polynomial[i];
+			this->degree[1] = d - 1;
+
+			this->length = 2;
+
+			while (this->length <= FIVE_POINT_DEGREE && this->degree[this->length - 1] > 0) {
+				const double* a = this->p[this->length - 2];
+				const double* b = this->p[this->length - 1];
+				int degree_a = this->degree[this->length - 2];
+				int degree_b = this->degree[this->length - 1];
+
+				// The negated remainder of a / b.
+				double r[FIVE_POINT_DEGREE + 1];
+				double scale = 0.0;
+				for (int i = 0; i <= degree_a; i++) {
+					r[i] = a[i];
+					scale = std::max(scale, fabs(a[i]));
+				}
+
+				for (int i = degree_a - degree_b; i >= 0; i--) {
+					double q = r[i + degree_b] / b[degree_b];
+
+					for (int j = 0; j <= degree_b; j++)
+						r[i + j] -= q * b[j];
+				}
+
+				int degree_r = trim(r, degree_b - 1, scale);
+
+				// The remainder vanishes for multiple roots.
+				if (degree_r == 0 && fabs(r[0]) <= FIVE_POINT_EPSILON * scale)
+					break;
+
+				double* next = this->p[this->length];
+				for (int i = 0; i <= degree_r; i++)
+					next[i] = -r[i];
+
+				this->degree[this->length++] = degree_r;
+			}
+		}
+
+		int sign_changes(double z) const {
+			int changes = 0;
+			int last = 0;
+
+			for (int i = 0; i < this->length; i++) {
+				int s = sign(evaluate(this->p[i], this->degree[i], z));
+
+				// Zeros do not count.
+				if (s == 0)
+					continue;
+
+				if (last != 0 && s != last)
+					changes++;
+
+				last = s;
+			}
+
+			return changes;
+		}
+	};
+
+	// Finds a root in an interval where the polynomial changes its sign.
+	static double bisect(const double* p, int degree, double a, double b) {
+		double fa = evaluate(p, degree, a);
+
+		for (int i = 0; i < FIVE_POINT_ROOT_ITERATIONS; i++) {
+			double m = 0.5 * (a + b);
+			if (m <= a || m >= b)
+				break;
+
+			double fm = evaluate(p, degree, m);
+			if (sign(fm) == 0)
+				return m;
+
+			if ((fm > 0.0) == (fa > 0.0)) {
+				a = m;
+				fa = fm;
+			} else {
+				b = m;
+			}
+		}
+
+		return 0.5 * (a + b);
+	}
+
+	// Finds all real roots of a polynomial in z.
+	static int real_roots(const double* polynomial, int degree, double* roots) {
+		// A small leading coefficient only means that some roots are large,
+		// but one that is too small to divide by is no coefficient at all.
+		while (degree > 0 && fabs(polynomial[degree]) < DBL_MIN)
+			degree--;
+
+		if (degree < 1)
+			return 0;
+
+		/*
+		 * Substitute z = s * u, so that the roots are around one. The Sturm
+		 * sequence loses precision quickly for large roots.
+		 */
+		double s = 1.0;
+		if (fabs(polynomial[0]) >= DBL_MIN)
+			s = pow(fabs(polynomial[0] / polynomial[degree]), 1.0 / degree);
+
+		// Make the polynomial monic.
+		double p[FIVE_POINT_DEGREE + 1];
+		double bound = 0.0;
+		for (int i = 0; i <= degree; i++) {
+			p[i] = polynomial[i] * pow(s, i - degree) / polynomial[degree];
+
+			if (i < degree)
+				bound = std::max(bound, fabs(p[i]));
+		}
+
+		// All roots are within the Cauchy bound.
+		bound += 1.0;
+
+		SturmSequence sturm(p, degree);
+
+		struct Interval {
+			double a, b;
+			int changes_a, changes_b;
+		};
+
+		Interval stack[FIVE_POINT_ROOT_ITERATIONS];
+		int size = 0;
+		int count = 0;
+
+		stack[size++] = { -bound, bound, sturm.sign_changes(-bound), sturm.sign_changes(bound) };
+
+		while (size > 0) {
+			Interval interval = stack[--size];
+			int n = interval.changes_a - interval.changes_b;
+
+			if (n <= 0)
+				continue;
+
+			double fa = evaluate(p, degree, interval.a);
+			double fb = evaluate(p, degree, interval.b);
+
+			// One root that can be found by bisection.
+			if (n == 1 && (fa > 0.0) != (fb > 0.0)) {
+				roots[count++] = bisect(p, degree, interval.a, interval.b);
+				continue;
+			}
+
+			double m = 0.5 * (interval.a + interval.b);
+
+			// The interval cannot be split any further.
+			if (m <= interval.a || m >= interval.b || size + 2 > FIVE_POINT_ROOT_ITERATIONS) {
+				roots[count++] = m;
+				continue;
+			}
+
+			int changes_m = sturm.sign_changes(m);
+
+			stack[size++] = { interval.a, m, interval.changes_a, changes_m };
+			stack[size++] = { m, interval.b, changes_m, interval.changes_b };
+		}
+
+		for (int i = 0; i < count; i++)
+			roots[i] *= s;
+
+		return count;
+	}
+
+	/*
+	 * Polishes a solution with a few Gauss-Newton steps on the original
+	 * constraints. The elimination and clustered roots of the polynomial
+	 * in z may cost a few digits.
+	 */
+	static void refine(const double constraints[10][FIVE_POINT_MONOMIALS], double* x, double* y, double* z) {
+		for (int iteration = 0; iteration < FIVE_POINT_REFINE_ITERATIONS; iteration++) {
+			double px[4] = { 1.0, *x, *x * *x, *x * *x * *x };
+			double py[4] = { 1.0, *y, *y * *y, *y * *y * *y };
+			double pz[4] = { 1.0, *z, *z * *z, *z * *z * *z };
+
+			// The values and gradients of all monomials.
+			double m[FIVE_POINT_MONOMIALS][4];
+			for (int k = 0; k < FIVE_POINT_MONOMIALS; k++) {
+				int a = monomials[k][0], b = monomials[k][1], c = monomials[k][2];
+
+				m[k][0] = px[a] * py[b] * pz[c];
+				m[k][1] = a ? a * px[a - 1] * py[b] * pz[c] : 0.0;
+				m[k][2] = b ? b * px[a] * py[b - 1] * pz[c] : 0.0;
+				m[k][3] = c ? c * px[a] * py[b] * pz[c - 1] : 0.0;
+			}
+
+			// Normal equations J^T * J * d = -J^T * f.
+			double N[3][3] = { { 0.0 } };
+			double r[3] = { 0.0 };
+
+			for (int i = 0; i < 10; i++) {
+				double f = 0.0, J[3] = { 0.0, 0.0, 0.0 };
+
+				for (int k = 0; k < FIVE_POINT_MONOMIALS; k++) {
+					f += constraints[i][k] * m[k][0];
+
+					for (int j = 0; j < 3; j++)
+						J[j] += constraints[i][k] * m[k][j + 1];
+				}
+
+				for (int j = 0; j < 3; j++) {
+					r[j] -= J[j] * f;
+
+					for (int l = 0; l < 3; l++)
+						N[j][l] += J[j] * J[l];
+				}
+			}
+
+			cv::Matx33d normal(N[0][0], N[0][1], N[0][2], N[1][0], N[1][1], N[1][2], N[2][0], N[2][1], N[2][2]);
+
+			double det = cv::determinant(normal);
+			if (fabs(det) < DBL_MIN)
+				return;
+
+			cv::Vec3d d = normal.inv() * cv::Vec3d(r[0], r[1], r[2]);
+
+			*x += d[0];
+			*y += d[1];
+			*z += d[2];
+		}
+	}
+
+	unsigned int five_point_solve(const cv::Vec2d* x1, const cv::Vec2d* x2, cv::Matx33d* essential_matrices) {
+		double basis[4][9];
+		if (!null_space(x1, x2, basis))
+			return 0;
+
+		double constraints[10][FIVE_POINT_MONOMIALS];
+		build_constraints(basis, constraints);
+
+		double A[10][FIVE_POINT_MONOMIALS];
+		memcpy(A, constraints, sizeof(A));
+
+		if (!gauss_jordan(A))
+			return 0;
+
+		/*
+		 * Subtracting z times the rows of x^2, y^2 and x*y from the rows of
+		 * x^2*z, y^2*z and x*y*z leaves three equations that are linear in
+		 * x, y and 1:
+		 *
+		 *   B(z) * (x, y, 1)^T = 0
+		 *
+		 * The row of a monomial m reads m + (the columns from 10 on) = 0.
+		 */
+		double B[3][3][5];
+		int degree[3] = { 3, 3, 4 };
+
+		for (int i = 0; i < 3; i++) {
+			const double* e = A[4 + 2 * i];
+			const double* f = A[5 + 2 * i];
+
+			// The coefficients of x: x*z^2, x*z, x.
+			B[i][0][0] = e[12];
+			B[i][0][1] = e[11] - f[12];
+			B[i][0][2] = e[10] - f[11];
+			B[i][0][3] = -f[10];
+
+			// The coefficients of y: y*z^2, y*z, y.
+			B[i][1][0] = e[15];
+			B[i][1][1] = e[14] - f[15];
+			B[i][1][2] = e[13] - f[14];
+			B[i][1][3] = -f[13];
+
+			// The remaining coefficients: z^3, z^2, z, 1.
+			B[i][2][0] = e[19];
+			B[i][2][1] = e[18] - f[19];
+			B[i][2][2] = e[17] - f[18];
+			B[i][2][3] = e[16] - f[17];
+			B[i][2][4] = -f[16];
+		}
+
+		// The determinant of B(z) has degree ten.
+		double polynomial[FIVE_POINT_DEGREE + 1] = { 0.0 };
+
+		for (int j = 0; j < 3; j++) {
+			int j1 = (j + 1) % 3;
+			int j2 = (j + 2) % 3;
+
+			double a[8], b[8], c[FIVE_POINT_DEGREE + 1];
+
+			multiply(B[1][j1], degree[j1], B[2][j2], degree[j2], a);
+			multiply(B[1][j2], degree[j2], B[2][j1], degree[j1], b);
+
+			int degree_minor = degree[j1] + degree[j2];
+			for (int k = 0; k <= degree_minor; k++)
+				a[k] -= b[k];
+
+			multiply(B[0][j], degree[j], a, degree_minor, c);
+
+			for (int k = 0; k <= degree[j] + degree_minor; k++)
+				polynomial[k] += c[k];
+		}
+
+		double roots[FIVE_POINT_DEGREE];
+		int count = real_roots(polynomial, FIVE_POINT_DEGREE, roots);
+
+		unsigned int solutions = 0;
+
+		for (int r = 0; r < count; r++) {
+			double z = roots[r];
+
+			cv::Vec3d rows[3];
+			for (int i = 0; i < 3; i++) {
+				for (int j = 0; j < 3; j++)
+					rows[i][j] = evaluate(B[i][j], degree[j], z);
+			}
+
+			// (x, y, 1) is orthogonal to all rows, use the most stable pair.
+			cv::Vec3d v = rows[0].cross(rows[1]);
+			cv::Vec3d v2 = rows[0].cross(rows[2]);
+			cv::Vec3d v3 = rows[1].cross(rows[2]);
+
+			if (cv::norm(v2) > cv::norm(v))
+				v = v2;
+			if (cv::norm(v3) > cv::norm(v))
+				v = v3;
+
+			if (fabs(v[2]) < FIVE_POINT_EPSILON)
+				continue;
+
+			double x = v[0] / v[2];
+			double y = v[1] / v[2];
+
+			refine(constraints, &x, &y, &z);
+
+			cv::Matx33d E;
+			double norm = 0.0;
+
+			for (int k = 0; k < 9; k++) {
+				E.val[k] = x * basis[0][k] + y * basis[1][k] + z * basis[2][k] + basis[3][k];
+				norm += E.val[k] * E.val[k];
+			}
+
+			essential_matrices[solutions++] = E * (1.0 / sqrt(norm));
+		}
+
+		return solutions;
+	}
+}
@@ -0,0 +1,358 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+# define HAMMING_X86
+#endif
+
+#include <boxes/hamming.h>
+
+namespace Boxes {
+	/*
+	 * Distance functions.
+	 *
+	 * Each one may stop as soon as the partial distance reaches limit,
+	 * because the candidate cannot be one of the two best any more.
+	 * The returned value is then only guaranteed to be >= limit.
+	 */
+
+	static inline uint64_t load64(const uint8_t* p) {
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+
+		return v;
+	}
+
+	static inline uint32_t popcount_tail(const uint8_t* a, const uint8_t* b, unsigned int bytes) {
+		uint32_t distance = 0;
+
+		for (unsigned int i = 0; i < bytes; i++)
+			distance += __builtin_popcount(a[i] ^ b[i]);
+
+		return distance;
+	}
+
+	struct DistancePopcount {
+		static inline uint32_t distance(const uint8_t* a, const uint8_t* b, unsigned int bytes, uint32_t limit) {
+			uint32_t distance = 0;
+			unsigned int i = 0;
+
+			// Compare 32 bytes at a time and check the limit in between.
+			for (; i + 32 <= bytes; i += 32) {
+				distance += __builtin_popcountll(load64(a + i)      ^ load64(b + i));
+				distance += __builtin_popcountll(load64(a + i + 8)  ^ load64(b + i + 8));
+				distance += __builtin_popcountll(load64(a + i + 16) ^ load64(b + i + 16));
+				distance += __builtin_popcountll(load64(a + i + 24) ^ load64(b + i + 24));
+
+				if (distance >= limit)
+					return distance;
+			}
+
+			for (; i + 8 <= bytes; i += 8)
+				distance += __builtin_popcountll(load64(a + i) ^ load64(b + i));
+
+			return distance + popcount_tail(a + i, b + i, bytes - i);
+		}
+	};
+
+#ifdef HAMMING_X86
+	struct DistanceAVX2 {
+		__attribute__((target("avx2")))
+		static inline uint32_t distance(const uint8_t* a, const uint8_t* b, unsigned int bytes, uint32_t limit) {
+			// Population count of every nibble.
+			const __m256i lookup = _mm256_setr_epi8(
+				0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+				0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+			);
+			const __m256i mask = _mm256_set1_epi8(0x0f);
+
+			uint32_t distance = 0;
+			unsigned int i = 0;
+
+			for (; i + 32 <= bytes; i += 32) {
+				__m256i v = _mm256_xor_si256(
+					_mm256_loadu_si256((const __m256i*)(a + i)),
+					_mm256_loadu_si256((const __m256i*)(b + i))
+				);
+
+				__m256i lo = _mm256_and_si256(v, mask);
+				__m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+
+				__m256i count = _mm256_add_epi8(
+					_mm256_shuffle_epi8(lookup, lo),
+					_mm256_shuffle_epi8(lookup, hi)
+				);
+
+				// Sum up all bytes into four 64 bit integers.
+				__m256i sum = _mm256_sad_epu8(count, _mm256_setzero_si256());
+
+				distance += _mm256_extract_epi64(sum, 0) + _mm256_extract_epi64(sum, 1)
+					+ _mm256_extract_epi64(sum, 2) + _mm256_extract_epi64(sum, 3);
+
+				if (distance >= limit)
+					return distance;
+			}
+
+			for (; i + 8 <= bytes; i += 8)
+				distance += __builtin_popcountll(load64(a + i) ^ load64(b + i));
+
+			return distance + popcount_tail(a + i, b + i, bytes - i);
+		}
+	};
+#endif
+
+	/*
+	 * The search kernel.
+	 *
+	 * Queries and train descriptors are processed in tiles, so that a
+	 * block of train descriptors is reused from cache for a whole block
+	 * of queries.
+	 */
+	template <typename D>
+	static inline void knn2_kernel(const uint8_t* query, unsigned int query_rows, size_t query_step,
+			const uint8_t* train, unsigned int train_rows, size_t train_step,
+			unsigned int bytes, HammingNeighbours* result) {
+		for (unsigned int q0 = 0; q0 < query_rows; q0 += HAMMING_TILE_QUERIES) {
+			unsigned int q1 = q0 + HAMMING_TILE_QUERIES;
+			if (q1 > query_rows)
+				q1 = query_rows;
+
+			for (unsigned int t0 = 0; t0 < train_rows; t0 += HAMMING_TILE_TRAIN) {
+				unsigned int t1 = t0 + HAMMING_TILE_TRAIN;
+				if (t1 > train_rows)
+					t1 = train_rows;
+
+				for (unsigned int q = q0; q < q1; q++) {
+					const uint8_t* a = query + q * query_step;
+					HammingNeighbours* n = &result[q];
+
+					// Keep the current results in registers.
+					uint32_t best = n->best;
+					uint32_t second = n->second;
+					int idx = n->idx;
+					int second_idx = n->second_idx;
+
+					for (unsigned int t = t0; t < t1; t++) {
+						uint32_t distance = D::distance(a, train + t * train_step, bytes, second);
+
+						if (distance < best) {
+							second = best;
+							second_idx = idx;
+
+							best = distance;
+							idx = t;
+
+						} else if (distance < second) {
+							second = distance;
+							second_idx = t;
+						}
+					}
+
+					n->best = best;
+					n->second = second;
+					n->idx = idx;
+					n->second_idx = second_idx;
+				}
+			}
+		}
+	}
+
+	static inline void insert(HammingNeighbours* n, uint32_t distance, int idx) {
+		if (distance < n->best) {
+			n->second = n->best;
+			n->second_idx = n->idx;
+
+			n->best = distance;
+			n->idx = idx;
+
+		} else if (distance < n->second) {
+			n->second = distance;
+			n->second_idx = idx;
+		}
+	}
+
+	/*
+	 * Like knn2_kernel, but every distance is also used to update the
+	 * two best queries of the train descriptor, so that both directions
+	 * are searched in one pass.
+	 */
+	template <typename D>
+	static inline void knn2_symmetric_kernel(const uint8_t* query, unsigned int query_rows, size_t query_step,
+			const uint8_t* train, unsigned int train_rows, size_t train_step,
+			unsigned int bytes, HammingNeighbours* query_result, HammingNeighbours* train_result) {
+		for (unsigned int q0 = 0; q0 < query_rows; q0 += HAMMING_TILE_QUERIES) {
+			unsigned int q1 = q0 + HAMMING_TILE_QUERIES;
+			if (q1 > query_rows)
+				q1 = query_rows;
+
+			for (unsigned int t0 = 0; t0 < train_rows; t0 += HAMMING_TILE_TRAIN) {
+				unsigned int t1 = t0 + HAMMING_TILE_TRAIN;
+				if (t1 > train_rows)
+					t1 = train_rows;
+
+				for (unsigned int q = q0; q < q1; q++) {
+					const uint8_t* a = query + q * query_step;
+					HammingNeighbours n = query_result[q];
+
+					for (unsigned int t = t0; t < t1; t++) {
+						HammingNeighbours* m = &train_result[t];
+
+						// The distance is only needed if it can change one of both sides.
+						uint32_t limit = (n.second > m->second) ? n.second : m->second;
+
+						uint32_t distance = D::distance(a, train + t * train_step, bytes, limit);
+						if (distance >= limit)
+							continue;
+
+						insert(&n, distance, t);
+						insert(m, distance, q);
+					}
+
+					query_result[q] = n;
+				}
+			}
+		}
+	}
+
+	typedef void (*knn2_function)(const uint8_t* query, unsigned int query_rows, size_t query_step,
+		const uint8_t* train, unsigned int train_rows, size_t train_step,
+		unsigned int bytes, HammingNeighbours* result);
+
+	typedef void (*knn2_symmetric_function)(const uint8_t* query, unsigned int query_rows, size_t query_step,
+		const uint8_t* train, unsigned int train_rows, size_t train_step,
+		unsigned int bytes, HammingNeighbours* query_result, HammingNeighbours* train_result);
+
+	static void knn2_generic(const uint8_t* query, unsigned int query_rows, size_t query_step,
+			const uint8_t* train, unsigned int train_rows, size_t train_step,
+			unsigned int bytes, HammingNeighbours* result) {
+		knn2_kernel<DistancePopcount>(query, query_rows, query_step, train, train_rows, train_step, bytes, result);
+	}
+
+	static void knn2_symmetric_generic(const uint8_t* query, unsigned int query_rows, size_t query_step,
+			const uint8_t* train, unsigned int train_rows, size_t train_step,
+			unsigned int bytes, HammingNeighbours* query_result, HammingNeighbours* train_result) {
+		knn2_symmetric_kernel<DistancePopcount>(query, query_rows, query_step, train, train_rows, train_step,
+			bytes, query_result, train_result);
+	}
+
+#ifdef HAMMING_X86
+	__attribute__((target("popcnt"), flatten))
+	static void knn2_popcnt(const uint8_t* query, unsigned int query_rows, size_t query_step,
+			const uint8_t* train, unsigned int train_rows, size_t train_step,
+			unsigned int bytes, HammingNeighbours* result) {
+		knn2_kernel<DistancePopcount>(query, query_rows, query_step, train, train_rows, train_step, bytes, result);
+	}
+
+	__attribute__((target("avx2,popcnt"), flatten))
+	static void knn2_avx2(const uint8_t* query, unsigned int query_rows, size_t query_step,
+			const uint8_t* train, unsigned int train_rows, size_t train_step,
+			unsigned int bytes, HammingNeighbours* result) {
+		knn2_kernel<DistanceAVX2>(query, query_rows, query_step, train, train_rows, train_step, bytes, result);
+	}
+
+	__attribute__((target("popcnt"), flatten))
+	static void knn2_symmetric_popcnt(const uint8_t* query, unsigned int query_rows, size_t query_step,
+			const uint8_t* train, unsigned int train_rows, size_t train_step,
+			unsigned int bytes, HammingNeighbours* query_result, HammingNeighbours* train_result) {
+		knn2_symmetric_kernel<DistancePopcount>(query, query_rows, query_step, train, train_rows, train_step,
+			bytes, query_result, train_result);
+	}
+
+	__attribute__((target("avx2,popcnt"), flatten))
+	static void knn2_symmetric_avx2(const uint8_t* query, unsigned int query_rows, size_t query_step,
+			const uint8_t* train, unsigned int train_rows, size_t train_step,
+			unsigned int bytes, HammingNeighbours* query_result, HammingNeighbours* train_result) {
+		knn2_symmetric_kernel<DistanceAVX2>(query, query_rows, query_step, train, train_rows, train_step,
+			bytes, query_result, train_result);
+	}
+#endif
+
+	struct HammingImplementation {
+		const char* name;
+		knn2_function knn2;
+		knn2_symmetric_function knn2_symmetric;
+	};
+
+	// Picks the fastest implementation for this CPU.
+	static HammingImplementation select_implementation() {
+		HammingImplementation impl = { "generic", knn2_generic, knn2_symmetric_generic };
+
+#ifdef HAMMING_X86
+		__builtin_cpu_init();
+
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+			impl.name = "AVX2";
+			impl.knn2 = knn2_avx2;
+			impl.knn2_symmetric = knn2_symmetric_avx2;
+
+		} else if (__builtin_cpu_supports("popcnt")) {
+			impl.name = "POPCNT";
+			impl.knn2 = knn2_popcnt;
+			impl.knn2_symmetric = knn2_symmetric_popcnt;
+		}
+#endif
+
+		return impl;
+	}
+
+	static const HammingImplementation* get_implementation() {
+		static const HammingImplementation impl = select_implementation();
+
+		return &impl;
+	}
+
+	void hamming_knn2(const uint8_t* query, unsigned int query_rows, size_t query_step,
+			const uint8_t* train, unsigned int train_rows, size_t train_step,
+			unsigned int bytes, std::vector<HammingNeighbours>* result) {
+		result->assign(query_rows, HammingNeighbours());
+
+		if (query_rows == 0 || train_rows == 0)
+			return;
+
+		get_implementation()->knn2(query, query_rows, query_step,
+			train, train_rows, train_step, bytes, &result->at(0));
+	}
+
+	void hamming_knn2_symmetric(const uint8_t* query, unsigned int query_rows, size_t query_step,
+			const uint8_t* train, unsigned int train_rows, size_t train_step, unsigned int bytes,
+			std::vector<HammingNeighbours>* query_result, std::vector<HammingNeighbours>* train_result) {
+		query_result->assign(query_rows, HammingNeighbours());
+		train_result->assign(train_rows, HammingNeighbours());
+
+		if (query_rows == 0 || train_rows == 0)
+			return;
+
+		get_implementation()->knn2_symmetric(query, query_rows, query_step,
+			train, train_rows, train_step, bytes, &query_result->at(0), &train_result->at(0));
+	}
+
+	uint32_t hamming_distance(const uint8_t* a, const uint8_t* b, unsigned int bytes) {
+		return DistancePopcount::distance(a, b, bytes, UINT32_MAX);
+	}
+
+	const char* hamming_implementation() {
+		return get_implementation()->name;
+	}
+}
@@ -25,12 +25,10 @@
 #include <string>
 #include <vector>
 
-#ifdef BOXES_NONFREE
-# include <opencv2/nonfree/features2d.hpp>
-#endif
-
 #include <boxes/boxes.h>
 #include <boxes/constants.h>
+#include <boxes/descriptor_index.h>
+#include <boxes/feature_registry.h>
 #include <boxes/image.h>
 
 #include <moges/Types.h>
@@ -107,12 +105,6 @@ namespace Boxes {
 		if (this->curve)
 			delete this->curve;
 
-		// Delete all cached keypoints.
-		for (std::map<const std::string, std::vector<cv::KeyPoint>*>::iterator i = this->keypoints.begin();
-				i != this->keypoints.end(); i++) {
-			delete i->second;
-		}
-
 		if (this->camera_matrix)
 			delete this->camera_matrix;
 	}
@@ -200,132 +192,137 @@ namespace Boxes {
 		return &this->mat;
 	}
 
-	const cv::Mat* Image::get_mat(int code) const {
-		if (this->mat.type() == code) {
+	const cv::Mat* Image::get_mat(int code) {
+		std::ostringstream key;
+		key << code;
+
+		return this->mats.get(key.str(), [&]() {
+			cv::Mat* new_mat = new cv::Mat();
+			cv::cvtColor(this->mat, *new_mat, code);
+
+			return new_mat;
+		});
+	}
+
+	const cv::Mat* Image::get_greyscale_mat() {
+		if (this->mat.channels() == 1)
 			return &this->mat;
-		}
 
-		cv::Mat* new_mat = new cv::Mat();
-		cv::cvtColor(this->mat, *new_mat, code);
+		// Images are read in BGR order.
+		return this->get_mat(CV_BGR2GRAY);
+	}
 
-		return new_mat;
+	const std::vector<cv::Mat>* Image::get_pyramid(const std::string key,
+			std::function<std::vector<cv::Mat>*()> compute) {
+		return this->pyramids.get(key, compute);
 	}
 
-	const cv::Mat* Image::get_greyscale_mat() const {
-		return this->get_mat(CV_RGB2GRAY);
+	void Image::release_pyramid(const std::string key) {
+		this->pyramids.erase(key);
 	}
 
 	cv::Size Image::size() const {
 		return this->mat.size();
 	}
 
-	std::vector<cv::KeyPoint>* Image::get_keypoints() {
-		std::string detector_type = this->boxes->config->get("FEATURE_DETECTOR");
+	const std::vector<cv::KeyPoint>* Image::get_keypoints() {
+		const Settings& settings = this->boxes->get_settings();
 
-		return this->get_keypoints(detector_type);
+		return this->get_keypoints(settings.feature_detector, settings.feature_detector_extractor);
 	}
 
-	std::vector<cv::KeyPoint>* Image::get_keypoints(const std::string detector_type) {
-		std::vector<cv::KeyPoint>* keypoints;
-
-		#pragma omp critical
-		{
-			keypoints = this->keypoints[detector_type];
-
-			if (!keypoints) {
-				keypoints = this->compute_keypoints(detector_type);
-				this->keypoints[detector_type] = keypoints;
-			}
-		}
+	const std::vector<cv::KeyPoint>* Image::get_keypoints(const std::string detector_type) {
+		return this->keypoints.get(detector_type, [&]() {
+			return this->compute_keypoints(detector_type);
+		});
+	}
 
-		return keypoints;
+	const std::vector<cv::KeyPoint>* Image::get_keypoints(const std::string detector_type, const std::string extractor_type) {
+		return &this->get_features(detector_type, extractor_type)->keypoints;
 	}
 
 	std::vector<cv::KeyPoint>* Image::compute_keypoints(const std::string detector_type) const {
 		std::vector<cv::KeyPoint>* output = new std::vector<cv::KeyPoint>();
 
-		cv::FeatureDetector* detector = NULL;
-
-		// FAST
-		if (detector_type == FEATURE_DETECTOR_FAST) {
-			detector = new cv::FastFeatureDetector();
-
-		// GFTT
-		} else if (detector_type == FEATURE_DETECTOR_GFTT) {
-			detector = new cv::GoodFeaturesToTrackDetector();
-
-		// ORB
-		} else if (detector_type == FEATURE_DETECTOR_ORB) {
-			detector = new cv::OrbFeatureDetector();
+		cv::FeatureDetector* detector = this->boxes->features->get_detector(detector_type);
+		detector->detect(this->mat, *output);
 
-		// PyradmidFast
-		} else if (detector_type == FEATURE_DETECTOR_PYRAMID_FAST) {
-			cv::Ptr<cv::FeatureDetector> _detector = cv::Ptr<cv::FeatureDetector>(new cv::FastFeatureDetector());
+		return output;
+	}
 
-			detector = new cv::PyramidAdaptedFeatureDetector(_detector);
+	const cv::Mat* Image::get_descriptors() {
+		const Settings& settings = this->boxes->get_settings();
 
-#ifdef BOXES_NONFREE
-		// SIFT
-		} else if (detector_type == FEATURE_DETECTOR_SIFT) {
-			detector = new cv::SiftFeatureDetector();
+		return this->get_descriptors(settings.feature_detector, settings.feature_detector_extractor);
+	}
 
-		// SURF
-		} else if (detector_type == FEATURE_DETECTOR_SURF) {
-			int min_hessian = this->boxes->config->get_int("SURF_MIN_HESSIAN");
+	const cv::Mat* Image::get_descriptors(const std::string detector_type, const std::string extractor_type) {
+		return &this->get_features(detector_type, extractor_type)->descriptors;
+	}
 
-			detector = new cv::SurfFeatureDetector(min_hessian);
-#endif
-		}
+	Image::Features* Image::get_features(const std::string detector_type, const std::string extractor_type) {
+		// Get the keypoints first, which might need to be computed, too.
+		const std::vector<cv::KeyPoint>* keypoints = this->get_keypoints(detector_type);
 
-		assert(detector);
+		return this->features.get(detector_type + "-" + extractor_type, [&]() {
+			return this->compute_features(keypoints, extractor_type);
+		});
+	}
 
-		detector->detect(this->mat, *output);
-		delete detector;
+	unsigned int Image::get_descriptor_cache_hits() const {
+		return this->features.hits();
+	}
 
-		return output;
+	unsigned int Image::get_descriptor_cache_misses() const {
+		return this->features.misses();
 	}
 
-	cv::Mat* Image::get_descriptors(std::vector<cv::KeyPoint>* keypoints) const {
-		std::string detector_type = this->boxes->config->get("FEATURE_DETECTOR_EXTRACTOR");
+	DescriptorIndex* Image::get_descriptor_index() {
+		const Settings& settings = this->boxes->get_settings();
 
-		return this->get_descriptors(keypoints, detector_type);
+		return this->get_descriptor_index(settings.feature_detector,
+			settings.feature_detector_extractor, settings.matcher);
 	}
 
-	cv::Mat* Image::get_descriptors(std::vector<cv::KeyPoint>* keypoints, const std::string detector_type) const {
-		cv::Mat* descriptors = new cv::Mat();
+	DescriptorIndex* Image::get_descriptor_index(const std::string detector_type, const std::string extractor_type,
+			const std::string matcher_type) {
+		const cv::Mat* descriptors = this->get_descriptors(detector_type, extractor_type);
 
-		#pragma omp critical
-		{
-			// Extract descriptors.
-			cv::DescriptorExtractor* extractor = NULL;
+		std::string key = detector_type + "-" + extractor_type + "-" + matcher_type;
 
-			if (detector_type == FEATURE_DETECTOR_EXTRACTOR_ORB) {
-				extractor = new cv::OrbDescriptorExtractor();
+		return this->descriptor_indices.get(key, [&]() {
+			return DescriptorIndex::create(matcher_type, descriptors, this->boxes->get_settings());
+		});
+	}
 
-#ifdef BOXES_NONFREE
-			} else if (detector_type == FEATURE_DETECTOR_EXTRACTOR_SIFT) {
-				extractor = new cv::SiftDescriptorExtractor(48, 16, true);
+	Image::Features* Image::compute_features(const std::vector<cv::KeyPoint>* keypoints, const std::string extractor_type) const {
+		Features* features = new Features();
 
-			} else if (detector_type == FEATURE_DETECTOR_EXTRACTOR_SURF) {
-				extractor = new cv::SurfDescriptorExtractor();
-#endif
-			}
-			assert(extractor);
+		cv::DescriptorExtractor* extractor = this->boxes->features->get_extractor(extractor_type);
 
-			extractor->compute(this->mat, *keypoints, *descriptors);
-			delete extractor;
-		}
+		/* The extractor removes all keypoints for which no descriptor could
+		 * be computed, so it works on a copy and the detected keypoints
+		 * in the cache stay untouched. The rows of the descriptors match
+		 * the indices of the keypoints that are stored next to them. */
+		features->keypoints = *keypoints;
+		extractor->compute(this->mat, features->keypoints, features->descriptors);
 
-		return descriptors;
+		return features;
 	}
 
-	std::vector<cv::Point2f> Image::get_good_features_to_track(int max_corners, double quality_level, double min_distance) {
+	std::vector<cv::Point2f> Image::get_good_features_to_track(int max_corners, double quality_level, double min_distance,
+			const cv::Mat* mask) {
 		const cv::Mat* mat = this->get_greyscale_mat();
 
 		std::vector<cv::Point2f> corners = std::vector<cv::Point2f>();
 
 		// Find all good features to track.
-		cv::goodFeaturesToTrack(*mat, corners, max_corners, quality_level, min_distance);
+		cv::goodFeaturesToTrack(*mat, corners, max_corners, quality_level, min_distance,
+			mask ? *mask : cv::noArray());
+
+		// Nothing to refine.
+		if (corners.empty())
+			return corners;
 
 		// Increase the precision of the result.
 		cv::cornerSubPix(*mat, corners, cv::Size(15, 15), cv::Size(-1, -1),
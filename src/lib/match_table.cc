@@ -0,0 +1,100 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include <boxes/match_table.h>
+#include <boxes/structs.h>
+
+namespace Boxes {
+	unsigned int MatchTable::size() const {
+		return this->points1.size();
+	}
+
+	bool MatchTable::empty() const {
+		return this->points1.empty();
+	}
+
+	void MatchTable::clear() {
+		this->points1.clear();
+		this->points2.clear();
+		this->query_indices.clear();
+		this->train_indices.clear();
+		this->distances.clear();
+	}
+
+	void MatchTable::reserve(unsigned int n) {
+		this->points1.reserve(n);
+		this->points2.reserve(n);
+		this->query_indices.reserve(n);
+		this->train_indices.reserve(n);
+		this->distances.reserve(n);
+	}
+
+	void MatchTable::add(const MatchPoint* match) {
+		this->add(match->pt1, match->pt2, match->queryIdx, match->trainIdx, match->distance);
+	}
+
+	void MatchTable::add(const cv::Point2f& pt1, const cv::Point2f& pt2, int queryIdx, int trainIdx, float distance) {
+		this->points1.push_back(pt1);
+		this->points2.push_back(pt2);
+		this->query_indices.push_back(queryIdx);
+		this->train_indices.push_back(trainIdx);
+		this->distances.push_back(distance);
+	}
+
+	MatchPoint MatchTable::get(unsigned int i) const {
+		MatchPoint match;
+		match.pt1 = this->points1[i];
+		match.pt2 = this->points2[i];
+		match.queryIdx = this->query_indices[i];
+		match.trainIdx = this->train_indices[i];
+		match.distance = this->distances[i];
+
+		return match;
+	}
+
+	bool MatchTable::has_keypoints(unsigned int i) const {
+		return (this->query_indices[i] != MATCH_NO_KEYPOINT && this->train_indices[i] != MATCH_NO_KEYPOINT);
+	}
+
+	void MatchTable::filter(const std::vector<uchar>* mask) {
+		unsigned int n = 0;
+
+		// Move all matches that are kept to the front.
+		for (unsigned int i = 0; i < this->size(); i++) {
+			if (i >= mask->size() || !mask->at(i))
+				continue;
+
+			this->points1[n] = this->points1[i];
+			this->points2[n] = this->points2[i];
+			this->query_indices[n] = this->query_indices[i];
+			this->train_indices[n] = this->train_indices[i];
+			this->distances[n] = this->distances[i];
+			n++;
+		}
+
+		this->points1.resize(n);
+		this->points2.resize(n);
+		this->query_indices.resize(n);
+		this->train_indices.resize(n);
+		this->distances.resize(n);
+	}
+}
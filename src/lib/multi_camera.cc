@@ -17,7 +17,13 @@
 	along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <math.h>
 #include <sstream>
+#include <stdexcept>
 #include <vector>
 
 #include <boxes/suppress_warnings.h>
@@ -27,11 +33,17 @@ INCLUDE_IGNORE_WARNINGS_BEGIN
 INCLUDE_IGNORE_WARNINGS_END
 
 #include <boxes/boxes.h>
+#include <boxes/bundle_adjustment.h>
 #include <boxes/converters.h>
 #include <boxes/feature_matcher.h>
 #include <boxes/feature_matcher_optical_flow.h>
+#include <boxes/feature_tracker.h>
 #include <boxes/multi_camera.h>
 #include <boxes/image.h>
+#include <boxes/ransac.h>
+#include <boxes/ransac_estimators.h>
+#include <boxes/scheduler.h>
+#include <boxes/tracks.h>
 #include <boxes/util.h>
 
 namespace Boxes {
@@ -48,6 +60,7 @@ namespace Boxes {
 		for (FeatureMatcher* feature_matcher: this->feature_matchers)
 			delete feature_matcher;
 
+		delete this->feature_tracker;
 		delete this->point_cloud;
 	}
 
@@ -82,7 +95,14 @@ namespace Boxes {
 		return this->feature_matchers[index];
 	}
 
+	FeatureTracker* MultiCamera::get_feature_tracker() const {
+		return this->feature_tracker;
+	}
+
 	void MultiCamera::run(bool use_optical_flow) {
+		// Compile the configuration once before anything runs in parallel.
+		this->boxes->compile_settings();
+
 		// Create feature matchers for each image pair.
 		for (std::pair<Image*, Image*> image_pair: this->image_pairs) {
 			Image* image1 = image_pair.first;
@@ -93,76 +113,234 @@ namespace Boxes {
 			this->feature_matchers.push_back(matcher);
 		}
 
-		// Calculate matches in parallel.
-		#pragma omp parallel for
-		for (unsigned int i = 0; i < this->feature_matchers.size(); i++) {
-			FeatureMatcher* matcher = feature_matchers[i];
+		const Settings& settings = this->boxes->get_settings();
+		this->bundle_adjustment_results.clear();
 
-			matcher->match();
+		unsigned int pairs = this->feature_matchers.size();
+
+		// Every pair starts with the image the previous one ended with.
+		for (unsigned int i = 1; i < pairs; i++) {
+			if (this->feature_matchers[i]->image1 != this->feature_matchers[i - 1]->image2)
+				throw std::runtime_error("The image pairs do not form a sequence");
 		}
 
-		FeatureMatcher* last_matcher = NULL;
+		/*
+		 * Split the sequence into chunks of consecutive pairs, which are
+		 * reconstructed independently of each other. The last image of a
+		 * chunk is the first image of the next one, so that both chunks
+		 * can be aligned by the points they see in that image.
+		 */
+		unsigned int chunk_size = settings.reconstruction_chunk_size;
+		if (chunk_size == 0)
+			chunk_size = pairs;
+
+		std::vector<ReconstructionChunk> chunks;
+		for (unsigned int first = 0; first < pairs; first += chunk_size) {
+			ReconstructionChunk chunk;
+			chunk.first = first;
+			chunk.last = std::min(first + chunk_size, pairs);
+
+			chunks.push_back(chunk);
+		}
 
-		for (FeatureMatcher* matcher: this->feature_matchers) {
-			Image* image1 = matcher->image1;
-			Image* image2 = matcher->image2;
+		/*
+		 * Match all pairs and chain their poses as one task graph. The pose
+		 * of a pair only waits for its own matches and the pose of the pair
+		 * before it in the same chunk, so that the chain runs while the
+		 * remaining pairs are still being matched.
+		 *
+		 * Errors are kept by pair and thrown in order afterwards.
+		 */
+		Scheduler* scheduler = this->boxes->get_scheduler();
+		TaskGroup group;
+
+		std::vector<std::exception_ptr> errors(pairs);
+
+		// Number of tasks the pose of every pair still waits for.
+		std::vector<ReconstructionChunk*> pair_chunks(pairs);
+		std::vector<std::atomic<unsigned int>> waiting(pairs);
+
+		for (ReconstructionChunk& chunk: chunks) {
+			for (unsigned int i = chunk.first; i < chunk.last; i++) {
+				pair_chunks[i] = &chunk;
+				waiting[i] = (i == chunk.first) ? 1 : 2;
+			}
+		}
 
-			// For the first match, find the best camera matrix of the image
-			// pair and initialize the point cloud.
-			if (last_matcher == NULL) {
-				matcher->calculate_camera_matrix();
-			} else {
-				std::vector<cv::Point3f> local_point_cloud;
-				std::vector<cv::Point2f> image_points;
+		std::function<void(unsigned int)> release = [&](unsigned int i) {
+			if (--waiting[i] > 0)
+				return;
 
-				for (std::vector<CloudPoint>::iterator i = last_matcher->point_cloud->begin(); i != last_matcher->point_cloud->end(); i++) {
-					cv::Point2f* point = matcher->find_corresponding_keypoint_coordinates(&i->pt2);
+			scheduler->run(&group, [&, i]() {
+				ReconstructionChunk* chunk = pair_chunks[i];
 
-					if (point) {
-						local_point_cloud.push_back(i->pt);
-						image_points.push_back(*point);
+				// A pair that failed breaks the chain of its chunk.
+				if (errors[i])
+					chunk->failed = true;
 
-						delete point;
+				if (!chunk->failed) {
+					try {
+						this->reconstruct_pair(chunk, i);
+					} catch (...) {
+						errors[i] = std::current_exception();
+						chunk->failed = true;
 					}
 				}
 
-				cv::Mat_<double> rvec;
-				cv::Mat_<double> translation;
-				std::vector<double> distortion_coeff;
-				std::vector<int> inliers;
+				if (i + 1 < chunk->last)
+					release(i + 1);
+			});
+		};
 
-				cv::solvePnPRansac(local_point_cloud, image_points, image1->get_camera(),
-					distortion_coeff, rvec, translation, false, 100, 8.0, 100, inliers);
+		std::function<void(unsigned int)> match = [&](unsigned int i) {
+			scheduler->run(&group, [&, i]() {
+				try {
+					this->feature_matchers[i]->match();
+				} catch (...) {
+					errors[i] = std::current_exception();
+				}
 
-				cv::Mat_<double> rotation;
-				cv::Rodrigues(rvec, rotation);
+				release(i);
+			});
+		};
 
-				// Compose combined rotation and translation matrix.
-				cv::Matx34d matrix = merge_rotation_and_translation_matrix(&rotation, &translation);
+		if (settings.sequence_tracking) {
+			delete this->feature_tracker;
+			this->feature_tracker = new FeatureTracker(this->boxes);
 
-				CameraMatrix camera_matrix = CameraMatrix(this->boxes, matrix);
-				image2->update_camera_matrix(&camera_matrix);
+			/*
+			 * The tracker has to follow the sequence in order, but every pair
+			 * it is done with is handed on to be matched and reconstructed
+			 * while it tracks the next one.
+			 */
+			scheduler->run(&group, [&]() {
+				unsigned int i = 0;
 
-				matcher->triangulate_points();
-			}
+				try {
+					this->feature_tracker->start(this->chain_image(0));
 
+					std::vector<MatchPoint> match_points;
+					for (; i < pairs; i++) {
+						this->feature_tracker->track(this->chain_image(i + 1), &match_points);
 
-			/* Strip all points from the point cloud, if they are not within the
-			 * NURBS curve (if that one is available).
-			 */
-			matcher->point_cloud->cut_curve(image2);
+						FeatureMatcherTracked* matcher = static_cast<FeatureMatcherTracked*>(this->feature_matchers[i]);
+						matcher->set_match_points(&match_points);
 
-			last_matcher = matcher;
+						match(i);
+					}
+				} catch (...) {
+					// All remaining pairs fail with the tracker.
+					for (unsigned int j = i; j < pairs; j++) {
+						errors[j] = std::current_exception();
+						release(j);
+					}
+				}
+			});
+		} else {
+			for (unsigned int i = 0; i < pairs; i++)
+				match(i);
+		}
+
+		scheduler->wait(&group);
+
+		for (std::exception_ptr error: errors) {
+			if (error)
+				std::rethrow_exception(error);
+		}
+
+		// Every similarity maps a chunk into the coordinate system of the chunk before.
+		std::vector<RansacModel> similarities(chunks.size());
+
+		scheduler->parallel_for(1, chunks.size(), 1, [&](unsigned int i) {
+			similarities[i] = this->align_chunks(&chunks[i - 1], &chunks[i]);
+		});
+
+		// Chain them, so that they map into the coordinate system of the first chunk.
+		for (unsigned int i = 2; i < chunks.size(); i++) {
+			similarities[i].translation = similarities[i - 1].matrix * similarities[i].translation + similarities[i - 1].translation;
+			similarities[i].matrix = similarities[i - 1].matrix * similarities[i].matrix;
+		}
+
+		scheduler->parallel_for(1, chunks.size(), 1, [&](unsigned int i) {
+			this->transform_chunk(&chunks[i], &similarities[i]);
+		});
+
+		// The shared image of two chunks belongs to the first one of them.
+		ReconstructionChunk sequence;
+		sequence.first = 0;
+		sequence.last = pairs;
+
+		for (const ReconstructionChunk& chunk: chunks) {
+			unsigned int skip = sequence.poses.empty() ? 0 : 1;
+			sequence.poses.insert(sequence.poses.end(), chunk.poses.begin() + skip, chunk.poses.end());
+
+			this->bundle_adjustment_results.insert(this->bundle_adjustment_results.end(),
+				chunk.bundle_adjustment_results.begin(), chunk.bundle_adjustment_results.end());
+		}
+
+		// Close the seams between the chunks.
+		if (chunks.size() > 1 && settings.bundle_adjustment_interval > 0) {
+			this->bundle_adjust(&sequence, pairs);
+
+			this->bundle_adjustment_results.insert(this->bundle_adjustment_results.end(),
+				sequence.bundle_adjustment_results.begin(), sequence.bundle_adjustment_results.end());
+		}
+
+		for (unsigned int i = 0; i < sequence.poses.size(); i++) {
+			CameraMatrix camera_matrix = CameraMatrix(this->boxes, sequence.poses[i]);
+			this->chain_image(i)->update_camera_matrix(&camera_matrix);
 		}
 
 		this->mean_reprojection_error = 0;
-		for (FeatureMatcher* matcher: this->feature_matchers) {
-			this->point_cloud->merge(matcher->point_cloud);
 
-			//caluating mean reprojection errror
-			mean_reprojection_error += matcher->reprojection_error;			
+		if (settings.tracks) {
+			/*
+			 * The last bundle adjustment refined every physical point together
+			 * with the poses, which is kept. Without it, every point is
+			 * triangulated once from all images that see it.
+			 */
+			Tracks tracks;
+
+			if (settings.bundle_adjustment_interval > 0)
+				tracks = (chunks.size() > 1) ? sequence.tracks : chunks[0].tracks;
+			else
+				this->build_tracks(&sequence, pairs, &tracks);
+
+			std::vector<CloudPoint> cloud_points;
+			cloud_points.reserve(tracks.size());
+
+			for (unsigned int t = 0; t < tracks.size(); t++) {
+				if (!tracks.valid[t])
+					continue;
+
+				unsigned int first = tracks.offsets[t];
+
+				CloudPoint cloud_point;
+				cloud_point.pt = tracks.points[t];
+				cloud_point.pt1 = tracks.coordinates[first];
+				cloud_point.pt2 = tracks.coordinates[first + 1];
+				cloud_point.queryIdx = tracks.keypoints[first];
+				cloud_point.trainIdx = tracks.keypoints[first + 1];
+				cloud_point.set_colour_from_image(this->chain_image(tracks.images[first + 1]));
+				cloud_point.reprojection_error = tracks.reprojection_errors[t];
+
+				cloud_points.push_back(cloud_point);
+				this->mean_reprojection_error += cloud_point.reprojection_error;
+			}
+
+			this->point_cloud->add_points(&cloud_points);
+
+			if (!cloud_points.empty())
+				this->mean_reprojection_error /= (double)cloud_points.size();
+		} else {
+			for (FeatureMatcher* matcher: this->feature_matchers) {
+				this->point_cloud->merge(matcher->point_cloud);
+
+				//caluating mean reprojection errror
+				mean_reprojection_error += matcher->reprojection_error;			
+			}
+			mean_reprojection_error /= (double)this->feature_matchers.size();
 		}
-		mean_reprojection_error /= (double)this->feature_matchers.size();
 		// calculate scaling only if a distance in the images was found
 		Image* image = this->images[0];
 
@@ -180,7 +358,11 @@ namespace Boxes {
 	FeatureMatcher* MultiCamera::match(Image* image1, Image* image2, bool optical_flow) const {
 		FeatureMatcher* feature_matcher;
 
-		if (optical_flow)
+		const Settings& settings = this->boxes->get_settings();
+
+		if (settings.sequence_tracking)
+			feature_matcher = new FeatureMatcherTracked(this->boxes, image1, image2);
+		else if (optical_flow)
 			feature_matcher = new FeatureMatcherOpticalFlow(this->boxes, image1, image2);
 		else
 			feature_matcher = new FeatureMatcher(this->boxes, image1, image2);
@@ -192,6 +374,318 @@ namespace Boxes {
 		return this->point_cloud;
 	}
 
+	Image* MultiCamera::chain_image(unsigned int index) const {
+		if (index == 0)
+			return this->feature_matchers[0]->image1;
+
+		return this->feature_matchers[index - 1]->image2;
+	}
+
+	void MultiCamera::reconstruct_pair(ReconstructionChunk* chunk, unsigned int n) {
+		const Settings& settings = this->boxes->get_settings();
+
+		FeatureMatcher* matcher = this->feature_matchers[n];
+		Image* image1 = matcher->image1;
+		Image* image2 = matcher->image2;
+
+		// Number of pairs of the chunk that have a pose, including this one.
+		unsigned int matched = n - chunk->first;
+
+		// For the first match, find the best camera matrix of the image
+		// pair and initialize the point cloud.
+		if (n == chunk->first) {
+			// The first image of the chunk defines its coordinate system.
+			chunk->poses.assign(1, cv::Matx34d::eye());
+			chunk->bundle_adjustment_results.clear();
+
+			CameraMatrix* camera_matrix = matcher->calculate_camera_matrix();
+			chunk->poses.push_back(camera_matrix->matrix);
+
+			delete camera_matrix;
+		} else {
+			FeatureMatcher* last_matcher = this->feature_matchers[n - 1];
+
+			std::vector<cv::Point3f> local_point_cloud;
+			std::vector<cv::Point2f> image_points;
+
+			local_point_cloud.reserve(last_matcher->point_cloud->size());
+			image_points.reserve(last_matcher->point_cloud->size());
+
+			const MatchTable* matches = matcher->get_matches();
+
+			// The second keypoint of the last pair is the first keypoint of this pair.
+			for (std::vector<CloudPoint>::iterator i = last_matcher->point_cloud->begin(); i != last_matcher->point_cloud->end(); i++) {
+				int match = matcher->find_match(i->trainIdx, &i->pt2);
+
+				if (match >= 0) {
+					local_point_cloud.push_back(i->pt);
+					image_points.push_back(matches->points2[match]);
+				}
+			}
+
+			cv::Matx33d camera = image1->get_camera();
+
+			PnPEstimator estimator(&local_point_cloud, &image_points, &camera);
+			Ransac ransac(&estimator, RansacParameters(settings, PNP_REPROJECTION_ERROR), this->boxes->get_scheduler());
+
+			RansacModel model;
+			std::vector<uchar> inliers;
+
+			RansacResult result = ransac.run(&model, &inliers);
+			if (result.inliers > 0) {
+				cv::Mat_<double> rotation = cv::Mat(model.matrix);
+				cv::Mat_<double> translation = cv::Mat(model.translation);
+
+				// Compose combined rotation and translation matrix.
+				chunk->poses.push_back(merge_rotation_and_translation_matrix(&rotation, &translation));
+			} else {
+				// Too few points are shared with the last pair, but the sequence goes on.
+				chunk->poses.push_back(this->chain_relative_pose(chunk, n));
+			}
+
+			matcher->triangulate_points(&chunk->poses[matched], &chunk->poses[matched + 1], matcher->point_cloud);
+		}
+
+
+		/* Strip all points from the point cloud, if they are not within the
+		 * NURBS curve (if that one is available).
+		 */
+		matcher->point_cloud->cut_curve(image2);
+
+		matched++;
+
+		// Refine all poses so far before the next one is chained to them, and the whole chunk at its end.
+		if (settings.bundle_adjustment_interval > 0 &&
+				(matched % settings.bundle_adjustment_interval == 0 || n + 1 == chunk->last))
+			this->bundle_adjust(chunk, matched);
+	}
+
+	cv::Matx34d MultiCamera::chain_relative_pose(const ReconstructionChunk* chunk, unsigned int n) const {
+		unsigned int matched = n - chunk->first;
+
+		CameraMatrix* camera_matrix = this->feature_matchers[n]->calculate_camera_matrix();
+		cv::Matx34d relative = camera_matrix->matrix;
+
+		delete camera_matrix;
+
+		const cv::Matx34d& pose = chunk->poses[matched];
+		const cv::Matx34d& last_pose = chunk->poses[matched - 1];
+
+		cv::Matx33d R1 = pose.get_minor<3, 3>(0, 0);
+		cv::Vec3d t1 = cv::Vec3d(pose(0, 3), pose(1, 3), pose(2, 3));
+
+		cv::Matx33d R0 = last_pose.get_minor<3, 3>(0, 0);
+		cv::Vec3d t0 = cv::Vec3d(last_pose(0, 3), last_pose(1, 3), last_pose(2, 3));
+
+		// The relative translation has unit length, so it takes on the baseline of the pair before.
+		double baseline = cv::norm(R1.t() * t1 - R0.t() * t0);
+
+		cv::Matx33d Rr = relative.get_minor<3, 3>(0, 0);
+		cv::Vec3d tr = cv::Vec3d(relative(0, 3), relative(1, 3), relative(2, 3));
+
+		cv::Matx33d R = Rr * R1;
+		cv::Vec3d t = Rr * t1 + tr * baseline;
+
+		return cv::Matx34d(
+			R(0,0), R(0,1), R(0,2), t[0],
+			R(1,0), R(1,1), R(1,2), t[1],
+			R(2,0), R(2,1), R(2,2), t[2]
+		);
+	}
+
+	RansacModel MultiCamera::align_chunks(const ReconstructionChunk* chunk1, const ReconstructionChunk* chunk2) const {
+		FeatureMatcher* matcher1 = this->feature_matchers[chunk1->last - 1];
+		FeatureMatcher* matcher2 = this->feature_matchers[chunk2->first];
+
+		// The cloud point of every match of the first pair of the second chunk.
+		const std::vector<CloudPoint>* cloud2 = matcher2->point_cloud->get_points();
+		std::vector<int> match_points(matcher2->get_matches()->size(), -1);
+
+		for (unsigned int i = 0; i < cloud2->size(); i++) {
+			int match = matcher2->find_match((*cloud2)[i].queryIdx, &(*cloud2)[i].pt1);
+
+			if (match >= 0)
+				match_points[match] = i;
+		}
+
+		// Points of both chunks that were triangulated from the same keypoint of the shared image.
+		std::vector<cv::Point3d> points1;
+		std::vector<cv::Point3d> points2;
+
+		for (std::vector<CloudPoint>::iterator i = matcher1->point_cloud->begin(); i != matcher1->point_cloud->end(); i++) {
+			int match = matcher2->find_match(i->trainIdx, &i->pt2);
+
+			if (match < 0 || match_points[match] < 0)
+				continue;
+
+			points1.push_back(i->pt);
+			points2.push_back((*cloud2)[match_points[match]].pt);
+		}
+
+		SimilarityEstimator estimator(&points2, &points1);
+		if (estimator.size() < estimator.sample_size())
+			throw std::runtime_error("The chunks of the reconstruction do not share enough points");
+
+		// The threshold is relative to the extent of the points of the first chunk.
+		cv::Point3d centroid;
+		for (const cv::Point3d& point: points1)
+			centroid += point;
+		centroid *= 1.0 / points1.size();
+
+		double extent = 0.0;
+		for (const cv::Point3d& point: points1)
+			extent += cv::norm(point - centroid);
+		extent /= points1.size();
+
+		Ransac ransac(&estimator, RansacParameters(this->boxes->get_settings(), RECONSTRUCTION_CHUNK_ALIGNMENT_ERROR * extent),
+			this->boxes->get_scheduler());
+
+		RansacModel model;
+		std::vector<uchar> inliers;
+
+		RansacResult result = ransac.run(&model, &inliers);
+		if (result.inliers == 0)
+			throw std::runtime_error("Could not align the chunks of the reconstruction");
+
+		return model;
+	}
+
+	void MultiCamera::transform_chunk(ReconstructionChunk* chunk, const RansacModel* similarity) {
+		// The matrix of a similarity is scale * rotation.
+		double scale = cbrt(cv::determinant(similarity->matrix));
+		cv::Matx33d rotation = similarity->matrix * (1.0 / scale);
+
+		for (cv::Matx34d& pose: chunk->poses) {
+			cv::Matx33d R = pose.get_minor<3, 3>(0, 0) * rotation.t();
+			cv::Vec3d t = cv::Vec3d(pose(0, 3), pose(1, 3), pose(2, 3)) * scale - R * similarity->translation;
+
+			pose = cv::Matx34d(
+				R(0,0), R(0,1), R(0,2), t[0],
+				R(1,0), R(1,1), R(1,2), t[1],
+				R(2,0), R(2,1), R(2,2), t[2]
+			);
+		}
+
+		for (unsigned int n = chunk->first; n < chunk->last; n++) {
+			PointCloud* point_cloud = this->feature_matchers[n]->point_cloud;
+
+			for (std::vector<CloudPoint>::iterator i = point_cloud->begin(); i != point_cloud->end(); i++) {
+				cv::Vec3d point = similarity->matrix * cv::Vec3d(i->pt.x, i->pt.y, i->pt.z) + similarity->translation;
+				i->pt = cv::Point3d(point[0], point[1], point[2]);
+			}
+		}
+	}
+
+	void MultiCamera::build_tracks(const ReconstructionChunk* chunk, unsigned int n, Tracks* tracks) const {
+		// Link the points that survived triangulation and the curve.
+		for (unsigned int i = 0; i < n; i++) {
+			FeatureMatcher* matcher = this->feature_matchers[chunk->first + i];
+
+			for (std::vector<CloudPoint>::const_iterator p = matcher->point_cloud->begin(); p != matcher->point_cloud->end(); p++)
+				tracks->add_match(i, p->queryIdx, &p->pt1, i + 1, p->trainIdx, &p->pt2);
+		}
+
+		tracks->build();
+
+		std::vector<cv::Matx33d> cameras;
+		std::vector<cv::Matx34d> poses(chunk->poses.begin(), chunk->poses.begin() + n + 1);
+
+		for (unsigned int i = 0; i <= n; i++) {
+			cv::Matx33d camera = this->chain_image(chunk->first + i)->get_camera();
+			cameras.push_back(camera);
+		}
+
+		tracks->triangulate(&cameras, &poses, this->boxes->get_scheduler());
+	}
+
+	void MultiCamera::bundle_adjust(ReconstructionChunk* chunk, unsigned int n) {
+		BundleAdjuster adjuster(this->boxes->get_settings().bundle_adjustment_max_iterations, this->boxes->get_scheduler());
+
+		// Every image is one camera, the first one fixes the coordinate system.
+		std::vector<cv::Matx33d> cameras;
+
+		for (unsigned int i = 0; i <= n; i++) {
+			cv::Matx33d camera = this->chain_image(chunk->first + i)->get_camera();
+			cameras.push_back(camera);
+
+			adjuster.add_camera(&chunk->poses[i], &cameras[i], i == 0);
+		}
+
+		if (this->boxes->get_settings().tracks) {
+			// Every track is one point with all its observations.
+			Tracks tracks;
+			this->build_tracks(chunk, n, &tracks);
+
+			std::vector<int> track_points(tracks.size(), -1);
+
+			for (unsigned int t = 0; t < tracks.size(); t++) {
+				if (!tracks.valid[t])
+					continue;
+
+				track_points[t] = adjuster.add_point(&tracks.points[t]);
+
+				for (unsigned int i = tracks.offsets[t]; i < tracks.offsets[t + 1]; i++)
+					adjuster.add_observation(tracks.images[i], track_points[t], &tracks.coordinates[i]);
+			}
+
+			chunk->bundle_adjustment_results.push_back(adjuster.run());
+
+			for (unsigned int i = 0; i <= n; i++)
+				chunk->poses[i] = adjuster.get_pose(i);
+
+			for (unsigned int t = 0; t < tracks.size(); t++) {
+				if (track_points[t] >= 0)
+					tracks.points[t] = adjuster.get_point(track_points[t]);
+			}
+
+			std::vector<cv::Matx34d> poses(chunk->poses.begin(), chunk->poses.begin() + n + 1);
+			tracks.reproject(&cameras, &poses, this->boxes->get_scheduler());
+
+			// Move the points of all pairs to their refined tracks.
+			for (unsigned int i = 0; i < n; i++) {
+				FeatureMatcher* matcher = this->feature_matchers[chunk->first + i];
+
+				for (std::vector<CloudPoint>::iterator p = matcher->point_cloud->begin(); p != matcher->point_cloud->end(); p++) {
+					int t = tracks.find(i, p->queryIdx, &p->pt1);
+
+					if (t >= 0 && track_points[t] >= 0)
+						p->pt = tracks.points[t];
+				}
+			}
+
+			chunk->tracks = tracks;
+		} else {
+			// Every point has been seen by both images of its pair.
+			for (unsigned int i = 0; i < n; i++) {
+				FeatureMatcher* matcher = this->feature_matchers[chunk->first + i];
+
+				for (std::vector<CloudPoint>::iterator p = matcher->point_cloud->begin(); p != matcher->point_cloud->end(); p++) {
+					unsigned int point = adjuster.add_point(&p->pt);
+
+					adjuster.add_observation(i, point, &p->pt1);
+					adjuster.add_observation(i + 1, point, &p->pt2);
+				}
+			}
+
+			chunk->bundle_adjustment_results.push_back(adjuster.run());
+
+			unsigned int point = 0;
+			for (unsigned int i = 0; i < n; i++) {
+				FeatureMatcher* matcher = this->feature_matchers[chunk->first + i];
+
+				for (std::vector<CloudPoint>::iterator p = matcher->point_cloud->begin(); p != matcher->point_cloud->end(); p++)
+					p->pt = adjuster.get_point(point++);
+			}
+
+			for (unsigned int i = 0; i <= n; i++)
+				chunk->poses[i] = adjuster.get_pose(i);
+		}
+	}
+
+	const std::vector<BundleAdjustmentResult>* MultiCamera::get_bundle_adjustment_results() const {
+		return &this->bundle_adjustment_results;
+	}
+
 	void MultiCamera::write_disparity_map_all(const std::string* filename) const {
 		for (unsigned int i = 0; i < this->image_pairs.size(); i++)
 			this->write_disparity_map_one(filename, i);
@@ -0,0 +1,409 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boxes/config.h>
+#include <boxes/constants.h>
+#include <boxes/image.h>
+#include <boxes/optical_flow.h>
+#include <boxes/scheduler.h>
+
+namespace Boxes {
+	OpticalFlow* OpticalFlow::create(const Settings& settings, Scheduler* scheduler) {
+		if (settings.optical_flow_engine == OPTICAL_FLOW_ENGINE_FARNEBACK)
+			return new OpticalFlowFarneback(settings, scheduler);
+
+		if (settings.optical_flow_engine == OPTICAL_FLOW_ENGINE_LUCAS_KANADE)
+			return new OpticalFlowLucasKanade(settings, scheduler);
+
+		if (settings.optical_flow_engine == OPTICAL_FLOW_ENGINE_PATCH)
+			return new OpticalFlowPatch(settings, scheduler);
+
+		throw std::runtime_error("Unknown optical flow engine: " + settings.optical_flow_engine);
+	}
+
+	const std::vector<cv::Mat>* OpticalFlow::get_pyramid(Image* image) const {
+		return image->get_pyramid(this->pyramid_key(), [&]() {
+			return this->build_pyramid(image->get_greyscale_mat());
+		});
+	}
+
+	void OpticalFlow::release_pyramid(Image* image) const {
+		image->release_pyramid(this->pyramid_key());
+	}
+
+	void OpticalFlow::calculate(const std::vector<cv::Mat>* pyramid1, const std::vector<cv::Mat>* pyramid2,
+			cv::Mat* flow) const {
+		throw std::runtime_error("This optical flow engine cannot calculate dense flow");
+	}
+
+	void OpticalFlow::track(const std::vector<cv::Mat>* pyramid1, const std::vector<cv::Mat>* pyramid2,
+			const std::vector<cv::Point2f>* points1, std::vector<cv::Point2f>* points2,
+			std::vector<uchar>* status) const {
+		cv::Mat flow;
+		this->calculate(pyramid1, pyramid2, &flow);
+
+		points2->resize(points1->size());
+		status->assign(points1->size(), 0);
+
+		for (unsigned int i = 0; i < points1->size(); i++) {
+			int x = cvRound(points1->at(i).x);
+			int y = cvRound(points1->at(i).y);
+
+			if (x < 0 || y < 0 || x >= flow.cols || y >= flow.rows)
+				continue;
+
+			points2->at(i) = points1->at(i) + flow.at<cv::Point2f>(y, x);
+			status->at(i) = 1;
+		}
+	}
+
+	/*
+	 * Contructor.
+	 */
+	OpticalFlowFarneback::OpticalFlowFarneback(const Settings& settings, Scheduler* scheduler) :
+			OpticalFlow(scheduler) {
+		this->pyramid_scale = settings.farneback_pyramid_scale;
+		this->levels        = settings.farneback_levels;
+		this->window_size   = settings.farneback_window_size;
+		this->iterations    = settings.farneback_iterations;
+		this->poly_n        = settings.farneback_poly_n;
+		this->poly_sigma    = settings.farneback_poly_sigma;
+	}
+
+	std::string OpticalFlowFarneback::pyramid_key() const {
+		return OPTICAL_FLOW_ENGINE_FARNEBACK;
+	}
+
+	std::vector<cv::Mat>* OpticalFlowFarneback::build_pyramid(const cv::Mat* greyscale) const {
+		return new std::vector<cv::Mat>(1, *greyscale);
+	}
+
+	void OpticalFlowFarneback::calculate(const std::vector<cv::Mat>* pyramid1, const std::vector<cv::Mat>* pyramid2,
+			cv::Mat* flow) const {
+		cv::calcOpticalFlowFarneback(pyramid1->front(), pyramid2->front(), *flow, this->pyramid_scale, this->levels,
+			this->window_size, this->iterations, this->poly_n, this->poly_sigma, 0);
+	}
+
+	/*
+	 * Contructor.
+	 */
+	OpticalFlowLucasKanade::OpticalFlowLucasKanade(const Settings& settings, Scheduler* scheduler) :
+			OpticalFlow(scheduler) {
+		this->window_size = settings.lk_window_size;
+		this->levels      = settings.lk_levels;
+		this->max_error   = settings.lk_max_error;
+	}
+
+	std::string OpticalFlowLucasKanade::pyramid_key() const {
+		std::ostringstream key;
+		key << OPTICAL_FLOW_ENGINE_LUCAS_KANADE << "-" << this->window_size << "-" << this->levels;
+
+		return key.str();
+	}
+
+	std::vector<cv::Mat>* OpticalFlowLucasKanade::build_pyramid(const cv::Mat* greyscale) const {
+		std::vector<cv::Mat>* pyramid = new std::vector<cv::Mat>();
+
+		cv::buildOpticalFlowPyramid(*greyscale, *pyramid, cv::Size(this->window_size, this->window_size),
+			this->levels);
+
+		return pyramid;
+	}
+
+	void OpticalFlowLucasKanade::track(const std::vector<cv::Mat>* pyramid1, const std::vector<cv::Mat>* pyramid2,
+			const std::vector<cv::Point2f>* points1, std::vector<cv::Point2f>* points2,
+			std::vector<uchar>* status) const {
+		points2->clear();
+		status->clear();
+
+		if (points1->empty())
+			return;
+
+		std::vector<float> errors;
+		cv::calcOpticalFlowPyrLK(*pyramid1, *pyramid2, *points1, *points2, *status, errors,
+			cv::Size(this->window_size, this->window_size), this->levels);
+
+		// Points that do not look alike any more are lost as well.
+		for (unsigned int i = 0; i < status->size(); i++) {
+			if (errors[i] >= this->max_error)
+				status->at(i) = 0;
+		}
+	}
+
+	/*
+	 * Contructor.
+	 */
+	OpticalFlowPatch::OpticalFlowPatch(const Settings& settings, Scheduler* scheduler) :
+			OpticalFlow(scheduler) {
+		this->patch_size = settings.patch_flow_size;
+		this->stride     = settings.patch_flow_stride;
+		this->levels     = settings.patch_flow_levels;
+		this->iterations = settings.patch_flow_iterations;
+	}
+
+	// Bilinear interpolation of a CV_32F image, positions outside of the image are clamped.
+	static inline float sample(const cv::Mat* image, float x, float y) {
+		x = std::min(std::max(x, 0.0f), (float)(image->cols - 1));
+		y = std::min(std::max(y, 0.0f), (float)(image->rows - 1));
+
+		int x0 = (int)x;
+		int y0 = (int)y;
+		int x1 = std::min(x0 + 1, image->cols - 1);
+		int y1 = std::min(y0 + 1, image->rows - 1);
+
+		float ax = x - x0;
+		float ay = y - y0;
+
+		const float* row0 = image->ptr<float>(y0);
+		const float* row1 = image->ptr<float>(y1);
+
+		return (1.0f - ay) * ((1.0f - ax) * row0[x0] + ax * row0[x1])
+			+ ay * ((1.0f - ax) * row1[x0] + ax * row1[x1]);
+	}
+
+	/*
+	 * Moves the patch of the first image at (x0, y0) to where it fits the
+	 * second image best, starting at flow. Both patches are compared
+	 * without their mean, so that changes in brightness do not matter.
+	 * The flow ends where the patches differed the least.
+	 */
+	static void align_patch(const cv::Mat* image1, const cv::Mat* image2, const cv::Mat* dx, const cv::Mat* dy,
+			int x0, int y0, int size, int iterations, std::vector<float>* values, cv::Point2f* flow) {
+		const int n = size * size;
+
+		// The template does not change, so neither does its Hessian.
+		double h11 = 0.0, h12 = 0.0, h22 = 0.0;
+		double mean1 = 0.0;
+
+		for (int y = 0; y < size; y++) {
+			const float* row = image1->ptr<float>(y0 + y) + x0;
+			const float* gx = dx->ptr<float>(y0 + y) + x0;
+			const float* gy = dy->ptr<float>(y0 + y) + x0;
+
+			for (int x = 0; x < size; x++) {
+				h11 += gx[x] * gx[x];
+				h12 += gx[x] * gy[x];
+				h22 += gy[x] * gy[x];
+				mean1 += row[x];
+			}
+		}
+		mean1 /= n;
+
+		// Patches without any texture stay where they are.
+		h11 += PATCH_FLOW_REGULARIZATION * n;
+		h22 += PATCH_FLOW_REGULARIZATION * n;
+
+		double det = h11 * h22 - h12 * h12;
+
+		// The search may run away from a patch that only fits the second image poorly.
+		cv::Point2f best = *flow;
+		double best_cost = DBL_MAX;
+
+		for (int i = 0; i < iterations; i++) {
+			double mean2 = 0.0;
+
+			for (int y = 0; y < size; y++) {
+				for (int x = 0; x < size; x++) {
+					float value = sample(image2, x0 + x + flow->x, y0 + y + flow->y);
+
+					(*values)[y * size + x] = value;
+					mean2 += value;
+				}
+			}
+			mean2 /= n;
+
+			double b1 = 0.0, b2 = 0.0;
+			double cost = 0.0;
+
+			for (int y = 0; y < size; y++) {
+				const float* row = image1->ptr<float>(y0 + y) + x0;
+				const float* gx = dx->ptr<float>(y0 + y) + x0;
+				const float* gy = dy->ptr<float>(y0 + y) + x0;
+				const float* value = &(*values)[y * size];
+
+				for (int x = 0; x < size; x++) {
+					double residual = (value[x] - mean2) - (row[x] - mean1);
+
+					b1 += gx[x] * residual;
+					b2 += gy[x] * residual;
+					cost += residual * residual;
+				}
+			}
+
+			if (cost < best_cost) {
+				best = *flow;
+				best_cost = cost;
+			}
+
+			// The update moves the template, so the patch moves the other way.
+			float ux = (h22 * b1 - h12 * b2) / det;
+			float uy = (h11 * b2 - h12 * b1) / det;
+
+			if (ux * ux + uy * uy < PATCH_FLOW_EPSILON * PATCH_FLOW_EPSILON)
+				break;
+
+			flow->x -= ux;
+			flow->y -= uy;
+		}
+
+		*flow = best;
+	}
+
+	std::string OpticalFlowPatch::pyramid_key() const {
+		std::ostringstream key;
+		key << OPTICAL_FLOW_ENGINE_PATCH << "-" << this->patch_size << "-" << this->levels;
+
+		return key.str();
+	}
+
+	std::vector<cv::Mat>* OpticalFlowPatch::build_pyramid(const cv::Mat* greyscale) const {
+		std::vector<cv::Mat>* pyramid = new std::vector<cv::Mat>();
+
+		cv::Mat level;
+		greyscale->convertTo(level, CV_32F);
+
+		while (true) {
+			// Gradients in intensity per pixel.
+			cv::Mat dx, dy;
+			cv::Sobel(level, dx, CV_32F, 1, 0, 3, 1.0 / 8.0);
+			cv::Sobel(level, dy, CV_32F, 0, 1, 3, 1.0 / 8.0);
+
+			pyramid->push_back(level);
+			pyramid->push_back(dx);
+			pyramid->push_back(dy);
+
+			if ((int)pyramid->size() / 3 >= this->levels)
+				break;
+
+			// Coarser levels, as long as they are at least two patches wide.
+			if (std::min(level.rows, level.cols) / 2 < 2 * this->patch_size)
+				break;
+
+			cv::Mat coarser;
+			cv::pyrDown(level, coarser);
+			level = coarser;
+		}
+
+		return pyramid;
+	}
+
+	void OpticalFlowPatch::calculate(const std::vector<cv::Mat>* pyramid1, const std::vector<cv::Mat>* pyramid2,
+			cv::Mat* flow) const {
+		int levels = std::min(pyramid1->size(), pyramid2->size()) / 3;
+
+		cv::Mat level_flow;
+
+		for (int level = levels - 1; level >= 0; level--) {
+			const cv::Mat* image1 = &pyramid1->at(3 * level);
+			cv::Mat initial;
+
+			if (level_flow.empty()) {
+				initial = cv::Mat::zeros(image1->size(), CV_32FC2);
+			} else {
+				// The flow of the level above is twice as long on this one.
+				cv::resize(level_flow, initial, image1->size(), 0, 0, cv::INTER_LINEAR);
+				initial *= 2.0;
+			}
+
+			this->calculate_level(image1, &pyramid1->at(3 * level + 1), &pyramid1->at(3 * level + 2),
+				&pyramid2->at(3 * level), &initial, &level_flow);
+		}
+
+		*flow = level_flow;
+	}
+
+	void OpticalFlowPatch::calculate_level(const cv::Mat* image1, const cv::Mat* dx, const cv::Mat* dy,
+			const cv::Mat* image2, const cv::Mat* initial, cv::Mat* flow) const {
+		const int size = this->patch_size;
+		const int stride = this->stride;
+
+		int rows = 0, cols = 0;
+		if (image1->rows >= size && image1->cols >= size) {
+			rows = (image1->rows - size) / stride + 1;
+			cols = (image1->cols - size) / stride + 1;
+		}
+
+		// Each patch starts with the flow at its centre.
+		std::vector<cv::Point2f> patch_flows(rows * cols);
+
+		this->scheduler->parallel_for(0, rows, PATCH_FLOW_ROWS_PER_TASK, [&](unsigned int r) {
+			std::vector<float> values(size * size);
+
+			for (int c = 0; c < cols; c++) {
+				int x0 = c * stride;
+				int y0 = r * stride;
+
+				cv::Point2f* patch_flow = &patch_flows[r * cols + c];
+				*patch_flow = initial->at<cv::Point2f>(y0 + size / 2, x0 + size / 2);
+
+				align_patch(image1, image2, dx, dy, x0, y0, size, this->iterations, &values, patch_flow);
+			}
+		});
+
+		/*
+		 * Every pixel gets the mean flow of all patches that cover it. A patch
+		 * counts less the more the pixel differs from where the patch says it went.
+		 */
+		flow->create(image1->rows, image1->cols, CV_32FC2);
+
+		this->scheduler->parallel_for(0, image1->rows, PATCH_FLOW_ROWS_PER_TASK * stride, [&](unsigned int y) {
+			const float* row = image1->ptr<float>(y);
+			const cv::Point2f* in = initial->ptr<cv::Point2f>(y);
+			cv::Point2f* out = flow->ptr<cv::Point2f>(y);
+
+			int first_row = ((int)y < size) ? 0 : ((int)y - size + stride) / stride;
+			int last_row = std::min(rows - 1, (int)y / stride);
+
+			for (int x = 0; x < image1->cols; x++) {
+				int first_col = (x < size) ? 0 : (x - size + stride) / stride;
+				int last_col = std::min(cols - 1, x / stride);
+
+				cv::Point2f sum(0.0, 0.0);
+				float weights = 0.0;
+
+				for (int r = first_row; r <= last_row; r++) {
+					for (int c = first_col; c <= last_col; c++) {
+						const cv::Point2f& f = patch_flows[r * cols + c];
+
+						float difference = fabs(sample(image2, x + f.x, y + f.y) - row[x]);
+						float weight = 1.0 / std::max(difference, 1.0f);
+
+						sum += f * weight;
+						weights += weight;
+					}
+				}
+
+				// Pixels at the border that no patch covers keep the flow they had.
+				if (weights > 0.0)
+					out[x] = sum * (1.0f / weights);
+				else
+					out[x] = in[x];
+			}
+		});
+	}
+}
@@ -58,6 +58,10 @@ namespace Boxes {
 		this->points.push_back(point);
 	}
 
+	void PointCloud::add_points(const std::vector<CloudPoint>* points) {
+		this->points.insert(this->points.end(), points->begin(), points->end());
+	}
+
 	void PointCloud::remove_point(const CloudPoint* point) {
 		int i = 0;
 
@@ -111,9 +115,7 @@ namespace Boxes {
 	}
 
 	void PointCloud::merge(const PointCloud* other) {
-		for (std::vector<CloudPoint>::const_iterator i = other->begin(); i != other->end(); i++) {
-			this->add_point(*i);
-		}
+		this->add_points(other->get_points());
 	}
 
 	void PointCloud::clear() {
@@ -179,7 +181,7 @@ namespace Boxes {
 		}
 		cvtColor(map, map, CV_HSV2BGR);
 
-		Image image_map = Image(this->boxes, map);
+		Image image_map(this->boxes, map);
 		image_map.write(filename);
 	}
 
@@ -194,14 +196,13 @@ namespace Boxes {
 	}
 
 	const pcl::ConvexHull<pcl::PointXYZRGB>* PointCloud::get_convex_hull() {
-		#pragma omp critical
-		{
-			if (!this->convex_hull) {
-				this->convex_hull = new pcl::ConvexHull<pcl::PointXYZRGB>();
-				this->convex_hull_mesh = new pcl::PolygonMesh();
+		std::lock_guard<std::mutex> lock(this->convex_hull_mutex);
 
-				this->compute_convex_hull(this->convex_hull, this->convex_hull_mesh);
-			}
+		if (!this->convex_hull) {
+			this->convex_hull = new pcl::ConvexHull<pcl::PointXYZRGB>();
+			this->convex_hull_mesh = new pcl::PolygonMesh();
+
+			this->compute_convex_hull(this->convex_hull, this->convex_hull_mesh);
 		}
 
 		return this->convex_hull;
@@ -228,14 +229,13 @@ namespace Boxes {
 	}
 
 	void PointCloud::reset_convex_hull() {
-		if (this->convex_hull == NULL)
-			return;
+		std::lock_guard<std::mutex> lock(this->convex_hull_mutex);
 
-		#pragma omp critical
-		{
-			delete this->convex_hull;
-			this->convex_hull = NULL;
-		}
+		delete this->convex_hull;
+		this->convex_hull = NULL;
+
+		delete this->convex_hull_mesh;
+		this->convex_hull_mesh = NULL;
 	}
 
 	void PointCloud::write_convex_hull(const std::string filename) {
@@ -0,0 +1,233 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <algorithm>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include <boxes/converters.h>
+#include <boxes/point_grid.h>
+
+namespace Boxes {
+	/*
+	 * Contructor.
+	 */
+	PointGrid::PointGrid(const std::vector<cv::Point2f>* points, float cell_size) {
+		this->points = *points;
+
+		this->origin = cv::Point2f(0, 0);
+		this->cell_size = 1.0;
+		this->cols = 1;
+		this->rows = 1;
+
+		cv::Point2f max = cv::Point2f(0, 0);
+
+		if (!this->points.empty()) {
+			this->origin = max = this->points[0];
+
+			for (std::vector<cv::Point2f>::const_iterator i = this->points.begin(); i != this->points.end(); ++i) {
+				this->origin.x = std::min(this->origin.x, i->x);
+				this->origin.y = std::min(this->origin.y, i->y);
+				max.x = std::max(max.x, i->x);
+				max.y = std::max(max.y, i->y);
+			}
+		}
+
+		float width = max.x - this->origin.x;
+		float height = max.y - this->origin.y;
+
+		// Choose the cell size so that each cell holds a few points on average.
+		if (cell_size <= 0.0) {
+			float cells = std::max<float>(this->points.size() / POINT_GRID_POINTS_PER_CELL, 1);
+
+			if (width > 0.0 && height > 0.0)
+				cell_size = sqrtf(width * height / cells);
+			else
+				cell_size = std::max(width, height) / cells;
+		}
+
+		if (cell_size > 0.0) {
+			this->cell_size = cell_size;
+			this->cols = floorf(width / cell_size) + 1;
+			this->rows = floorf(height / cell_size) + 1;
+		}
+
+		// Sort the points into their cells.
+		std::vector<int> cells(this->points.size());
+		this->cell_start.assign(this->cols * this->rows + 1, 0);
+
+		for (unsigned int i = 0; i < this->points.size(); i++) {
+			cells[i] = this->get_row(this->points[i].y) * this->cols + this->get_col(this->points[i].x);
+			this->cell_start[cells[i] + 1]++;
+		}
+
+		for (unsigned int i = 1; i < this->cell_start.size(); i++)
+			this->cell_start[i] += this->cell_start[i - 1];
+
+		std::vector<unsigned int> fill(this->cell_start.begin(), this->cell_start.end() - 1);
+		this->cell_points.resize(this->points.size());
+
+		for (unsigned int i = 0; i < this->points.size(); i++)
+			this->cell_points[fill[cells[i]]++] = i;
+	}
+
+	unsigned int PointGrid::size() const {
+		return this->points.size();
+	}
+
+	int PointGrid::get_col(float x) const {
+		int col = floorf((x - this->origin.x) / this->cell_size);
+
+		return std::min(std::max(col, 0), this->cols - 1);
+	}
+
+	int PointGrid::get_row(float y) const {
+		int row = floorf((y - this->origin.y) / this->cell_size);
+
+		return std::min(std::max(row, 0), this->rows - 1);
+	}
+
+	void PointGrid::query_line(const cv::Vec3d& line, double distance, std::vector<int>* result) const {
+		result->clear();
+
+		double n = sqrt(line[0] * line[0] + line[1] * line[1]);
+		if (IS_ZERO(n) || this->points.empty())
+			return;
+
+		double a = line[0] / n;
+		double b = line[1] / n;
+		double c = line[2] / n;
+
+		// Walk along the axis the line is closer to and visit the band of cells around it.
+		bool along_x = (fabs(b) >= fabs(a));
+		int steps = along_x ? this->cols : this->rows;
+
+		for (int step = 0; step < steps; step++) {
+			double s0 = (along_x ? this->origin.x : this->origin.y) + step * this->cell_size;
+			double s1 = s0 + this->cell_size;
+
+			// The other coordinate of the line at both ends of this column (or row).
+			double t0, t1, slack;
+			if (along_x) {
+				t0 = -(a * s0 + c) / b;
+				t1 = -(a * s1 + c) / b;
+				slack = distance / fabs(b);
+			} else {
+				t0 = -(b * s0 + c) / a;
+				t1 = -(b * s1 + c) / a;
+				slack = distance / fabs(a);
+			}
+
+			double lower = std::min(t0, t1) - slack;
+			double upper = std::max(t0, t1) + slack;
+
+			double origin = along_x ? this->origin.y : this->origin.x;
+			int limit = along_x ? this->rows : this->cols;
+
+			if (upper < origin || lower > origin + limit * this->cell_size)
+				continue;
+
+			int first = std::max((int)floor((lower - origin) / this->cell_size), 0);
+			int last = std::min((int)floor((upper - origin) / this->cell_size), limit - 1);
+
+			for (int other = first; other <= last; other++) {
+				int cell = along_x ? (other * this->cols + step) : (step * this->cols + other);
+
+				for (unsigned int i = this->cell_start[cell]; i < this->cell_start[cell + 1]; i++) {
+					const cv::Point2f* point = &this->points[this->cell_points[i]];
+
+					if (fabs(a * point->x + b * point->y + c) <= distance)
+						result->push_back(this->cell_points[i]);
+				}
+			}
+		}
+	}
+
+	template <typename Function>
+	void PointGrid::for_each_in_radius(const cv::Point2f& center, float radius, Function function) const {
+		if (this->points.empty() || radius < 0.0)
+			return;
+
+		// Nothing to find if the circle is entirely outside of the grid.
+		if (center.x + radius < this->origin.x || center.y + radius < this->origin.y ||
+				center.x - radius > this->origin.x + this->cols * this->cell_size ||
+				center.y - radius > this->origin.y + this->rows * this->cell_size)
+			return;
+
+		int first_col = this->get_col(center.x - radius);
+		int last_col = this->get_col(center.x + radius);
+		int first_row = this->get_row(center.y - radius);
+		int last_row = this->get_row(center.y + radius);
+
+		float radius2 = radius * radius;
+
+		for (int row = first_row; row <= last_row; row++) {
+			for (int col = first_col; col <= last_col; col++) {
+				int cell = row * this->cols + col;
+
+				for (unsigned int i = this->cell_start[cell]; i < this->cell_start[cell + 1]; i++) {
+					const cv::Point2f* point = &this->points[this->cell_points[i]];
+
+					float dx = point->x - center.x;
+					float dy = point->y - center.y;
+					float distance2 = dx * dx + dy * dy;
+
+					if (distance2 <= radius2)
+						function(this->cell_points[i], distance2);
+				}
+			}
+		}
+	}
+
+	void PointGrid::query_radius(const cv::Point2f& center, float radius, std::vector<int>* result) const {
+		result->clear();
+
+		this->for_each_in_radius(center, radius, [result](int index, float) {
+			result->push_back(index);
+		});
+	}
+
+	void PointGrid::query_nearest(const cv::Point2f& center, float radius, unsigned int k,
+			std::vector<cv::DMatch>* result) const {
+		result->clear();
+
+		if (k == 0)
+			return;
+
+		// Keep the k closest points sorted by their distance.
+		this->for_each_in_radius(center, radius, [result, k](int index, float distance2) {
+			cv::DMatch match(-1, index, distance2);
+
+			if (result->size() == k) {
+				if (distance2 >= result->back().distance)
+					return;
+
+				result->pop_back();
+			}
+
+			std::vector<cv::DMatch>::iterator position = std::upper_bound(result->begin(), result->end(), match,
+				[](const cv::DMatch& a, const cv::DMatch& b) { return a.distance < b.distance; });
+			result->insert(position, match);
+		});
+
+		for (std::vector<cv::DMatch>::iterator match = result->begin(); match != result->end(); ++match)
+			match->distance = sqrtf(match->distance);
+	}
+}
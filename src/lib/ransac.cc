@@ -0,0 +1,381 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <vector>
+
+#include <boxes/config.h>
+#include <boxes/constants.h>
+#include <boxes/ransac.h>
+#include <boxes/scheduler.h>
+
+namespace Boxes {
+	/*
+	 * Contructor.
+	 */
+	RansacParameters::RansacParameters(const Settings& settings, double threshold) {
+		this->threshold = threshold;
+
+		this->confidence = settings.ransac_confidence;
+		this->max_iterations = settings.ransac_max_iterations;
+		this->seed = RANSAC_SEED;
+
+		this->prosac = settings.ransac_prosac;
+		this->sprt = settings.ransac_sprt;
+		this->local_optimization = settings.ransac_local_optimization;
+	}
+
+	/*
+	 * Contructor.
+	 */
+	RansacEstimator::RansacEstimator(unsigned int n) {
+		this->n = n;
+	}
+
+	unsigned int RansacEstimator::size() const {
+		return this->n;
+	}
+
+	/*
+	 * Contructor.
+	 */
+	Ransac::Ransac(const RansacEstimator* estimator, const RansacParameters& parameters, Scheduler* scheduler) :
+			parameters(parameters) {
+		this->estimator = estimator;
+		this->scheduler = scheduler;
+	}
+
+	unsigned int ransac_iterations(double inlier_ratio, unsigned int sample_size, double confidence, unsigned int max_iterations) {
+		double p = pow(inlier_ratio, (double)sample_size);
+
+		if (p >= 1.0)
+			return 1;
+
+		if (p <= DBL_EPSILON)
+			return max_iterations;
+
+		double iterations = ceil(log(1.0 - confidence) / log(1.0 - p));
+		if (iterations > max_iterations)
+			return max_iterations;
+
+		return iterations;
+	}
+
+	void ransac_order(const std::vector<float>* values, std::vector<unsigned int>* order) {
+		order->resize(values->size());
+
+		for (unsigned int i = 0; i < order->size(); i++)
+			(*order)[i] = i;
+
+		std::stable_sort(order->begin(), order->end(), [values](unsigned int a, unsigned int b) {
+			return (*values)[a] < (*values)[b];
+		});
+	}
+
+	/*
+	 * Draws a sample for the given iteration.
+	 *
+	 * PROSAC draws from the n best correspondences only and lets n grow,
+	 * so that it ends up drawing uniformly like RANSAC (Chum and Matas,
+	 * "Matching with PROSAC - Progressive Sample Consensus").
+	 */
+	void Ransac::draw_sample(cv::RNG* rng, unsigned int iteration, unsigned int* sample) {
+		unsigned int m = this->estimator->sample_size();
+		unsigned int N = this->estimator->size();
+
+		unsigned int n = N;
+		bool last = false;
+
+		if (this->order) {
+			unsigned int t = iteration + 1;
+
+			if (t > this->prosac_t_prime && this->prosac_n < N) {
+				double t_next = this->prosac_t * (this->prosac_n + 1) / (this->prosac_n + 1 - m);
+
+				this->prosac_n++;
+				this->prosac_t_prime += ceil(t_next - this->prosac_t);
+				this->prosac_t = t_next;
+			}
+
+			n = this->prosac_n;
+
+			// Take the n-th correspondence and m - 1 of the better ones.
+			last = (this->prosac_t_prime >= t && n < N);
+		}
+
+		unsigned int random = last ? m - 1 : m;
+		unsigned int range = last ? n - 1 : n;
+
+		for (unsigned int i = 0; i < random; i++) {
+			bool unique;
+
+			do {
+				sample[i] = rng->uniform(0, (int)range);
+
+				unique = true;
+				for (unsigned int j = 0; j < i; j++)
+					unique = unique && (sample[i] != sample[j]);
+			} while (!unique);
+		}
+
+		if (last)
+			sample[m - 1] = n - 1;
+
+		if (this->order) {
+			for (unsigned int i = 0; i < m; i++)
+				sample[i] = (*this->order)[sample[i]];
+		}
+	}
+
+	/*
+	 * Decision threshold of the sequential probability ratio test
+	 * (Chum and Matas, "Optimal Randomized RANSAC").
+	 *
+	 * epsilon is the inlier ratio of a good model and delta the share of
+	 * correspondences that a bad model is consistent with.
+	 */
+	void Ransac::update_sprt_threshold() {
+		double epsilon = this->sprt_epsilon;
+		double delta = this->sprt_delta;
+
+		// The test cannot tell good from bad models.
+		this->sprt_decisive = (epsilon > delta);
+		if (!this->sprt_decisive)
+			return;
+
+		double C = (1.0 - delta) * log((1.0 - delta) / (1.0 - epsilon)) + delta * log(delta / epsilon);
+		double K = RANSAC_SPRT_MODEL_COST * C + 1.0;
+
+		double A = K;
+		for (unsigned int i = 0; i < 10; i++)
+			A = K + log(A);
+
+		this->sprt_threshold = A;
+	}
+
+	unsigned int Ransac::score(const RansacModel* model, double threshold, bool sprt, bool* rejected, unsigned int* tested) const {
+		unsigned int N = this->estimator->size();
+		double threshold2 = threshold * threshold;
+
+		// Models are only rejected early while the test can tell them apart.
+		sprt = sprt && this->sprt_decisive;
+
+		double log_consistent = log(this->sprt_delta / this->sprt_epsilon);
+		double log_inconsistent = log((1.0 - this->sprt_delta) / (1.0 - this->sprt_epsilon));
+		double log_threshold = sprt ? log(this->sprt_threshold) : 0.0;
+		double log_lambda = 0.0;
+
+		double errors[RANSAC_BLOCK_SIZE];
+		unsigned int inliers = 0;
+
+		*rejected = false;
+
+		for (unsigned int start = 0; start < N; start += RANSAC_BLOCK_SIZE) {
+			unsigned int count = std::min(N - start, (unsigned int)RANSAC_BLOCK_SIZE);
+
+			this->estimator->errors(model, start, count, errors);
+
+			unsigned int block_inliers = 0;
+			for (unsigned int i = 0; i < count; i++)
+				block_inliers += (errors[i] <= threshold2) ? 1 : 0;
+
+			inliers += block_inliers;
+			*tested = start + count;
+
+			// The likelihood ratio is updated once per block.
+			if (sprt) {
+				log_lambda += block_inliers * log_consistent + (count - block_inliers) * log_inconsistent;
+
+				if (log_lambda > log_threshold) {
+					*rejected = true;
+					break;
+				}
+			}
+		}
+
+		return inliers;
+	}
+
+	/*
+	 * Refits the model to its inliers a few times, starting with a larger
+	 * threshold that shrinks down to the original one.
+	 */
+	unsigned int Ransac::local_optimization(RansacModel* model, unsigned int inliers) const {
+		unsigned int N = this->estimator->size();
+
+		std::vector<double> errors(N);
+		std::vector<unsigned int> indices;
+		indices.reserve(N);
+
+		for (unsigned int iteration = 0; iteration < RANSAC_LO_ITERATIONS; iteration++) {
+			double multiplier = RANSAC_LO_THRESHOLD_MULTIPLIER
+				- (RANSAC_LO_THRESHOLD_MULTIPLIER - 1.0) * iteration / (RANSAC_LO_ITERATIONS - 1);
+			double threshold = this->parameters.threshold * multiplier;
+
+			for (unsigned int start = 0; start < N; start += RANSAC_BLOCK_SIZE)
+				this->estimator->errors(model, start, std::min(N - start, (unsigned int)RANSAC_BLOCK_SIZE), &errors[start]);
+
+			indices.clear();
+			for (unsigned int i = 0; i < N; i++) {
+				if (errors[i] <= threshold * threshold)
+					indices.push_back(i);
+			}
+
+			if (indices.size() < this->estimator->sample_size())
+				break;
+
+			RansacModel candidate = *model;
+			if (!this->estimator->fit(indices.data(), indices.size(), &candidate))
+				break;
+
+			bool rejected;
+			unsigned int tested;
+			unsigned int candidate_inliers = this->score(&candidate, this->parameters.threshold, false, &rejected, &tested);
+
+			if (candidate_inliers < inliers)
+				break;
+
+			*model = candidate;
+			inliers = candidate_inliers;
+		}
+
+		return inliers;
+	}
+
+	RansacResult Ransac::run(RansacModel* model, std::vector<uchar>* mask, const std::vector<unsigned int>* order) {
+		RansacResult result;
+
+		unsigned int m = this->estimator->sample_size();
+		unsigned int N = this->estimator->size();
+
+		mask->assign(N, 0);
+
+		if (N < m)
+			return result;
+
+		// PROSAC starts with the m best correspondences.
+		this->order = (this->parameters.prosac && order && order->size() == N) ? order : NULL;
+		this->prosac_n = m;
+		this->prosac_t_prime = 1.0;
+		this->prosac_t = this->parameters.max_iterations;
+		for (unsigned int i = 0; i < m; i++)
+			this->prosac_t *= (double)(m - i) / (N - i);
+
+		this->sprt_epsilon = RANSAC_SPRT_EPSILON;
+		this->sprt_delta = RANSAC_SPRT_DELTA;
+		this->update_sprt_threshold();
+
+		double delta_sum = 0.0;
+
+		cv::RNG rng(this->parameters.seed);
+
+		RansacModel best_model;
+		unsigned int best_inliers = 0;
+		unsigned int needed = this->parameters.max_iterations;
+
+		unsigned int iteration = 0;
+		while (iteration < needed) {
+			unsigned int batch = std::min(needed - iteration, (unsigned int)RANSAC_BATCH_SIZE);
+
+			// Samples are drawn in order, the rest does not depend on the order.
+			unsigned int samples[RANSAC_BATCH_SIZE][RANSAC_MAX_SAMPLE_SIZE];
+			for (unsigned int b = 0; b < batch; b++)
+				this->draw_sample(&rng, iteration + b, samples[b]);
+
+			RansacModel models[RANSAC_BATCH_SIZE][RANSAC_MAX_MODELS];
+			unsigned int counts[RANSAC_BATCH_SIZE];
+			unsigned int inliers[RANSAC_BATCH_SIZE][RANSAC_MAX_MODELS];
+			unsigned int tested[RANSAC_BATCH_SIZE][RANSAC_MAX_MODELS];
+			bool rejected[RANSAC_BATCH_SIZE][RANSAC_MAX_MODELS];
+
+			this->scheduler->parallel_for(0, batch, RANSAC_SAMPLES_PER_TASK, [&](unsigned int b) {
+				counts[b] = this->estimator->fit_minimal(samples[b], models[b]);
+
+				for (unsigned int s = 0; s < counts[b]; s++)
+					inliers[b][s] = this->score(&models[b][s], this->parameters.threshold,
+						this->parameters.sprt, &rejected[b][s], &tested[b][s]);
+			});
+
+			// Take the results in the order the samples were drawn.
+			for (unsigned int b = 0; b < batch; b++) {
+				for (unsigned int s = 0; s < counts[b]; s++) {
+					result.models++;
+
+					if (rejected[b][s]) {
+						result.rejected++;
+
+						// Learn how many correspondences bad models are consistent with.
+						delta_sum += std::max((double)inliers[b][s] / tested[b][s], RANSAC_SPRT_DELTA);
+						this->sprt_delta = delta_sum / result.rejected;
+						this->update_sprt_threshold();
+						continue;
+					}
+
+					if (inliers[b][s] <= best_inliers)
+						continue;
+
+					best_model = models[b][s];
+					best_inliers = inliers[b][s];
+
+					if (this->parameters.local_optimization) {
+						best_inliers = this->local_optimization(&best_model, best_inliers);
+						result.local_optimizations++;
+					}
+
+					double inlier_ratio = (double)best_inliers / N;
+
+					this->sprt_epsilon = std::min(inlier_ratio, RANSAC_SPRT_MAX_EPSILON);
+					this->update_sprt_threshold();
+
+					// SPRT may reject a good model, which needs more samples.
+					bool sprt = this->parameters.sprt && this->sprt_decisive;
+					double sprt_pass = sprt ? 1.0 - 1.0 / this->sprt_threshold : 1.0;
+					needed = ransac_iterations(inlier_ratio * pow(sprt_pass, 1.0 / m), m,
+						this->parameters.confidence, this->parameters.max_iterations);
+				}
+			}
+
+			iteration += batch;
+		}
+
+		result.iterations = iteration;
+
+		if (best_inliers == 0)
+			return result;
+
+		*model = best_model;
+
+		// Mark all inliers of the best model.
+		std::vector<double> errors(N);
+		for (unsigned int start = 0; start < N; start += RANSAC_BLOCK_SIZE)
+			this->estimator->errors(model, start, std::min(N - start, (unsigned int)RANSAC_BLOCK_SIZE), &errors[start]);
+
+		double threshold2 = this->parameters.threshold * this->parameters.threshold;
+		for (unsigned int i = 0; i < N; i++) {
+			(*mask)[i] = (errors[i] <= threshold2) ? 1 : 0;
+			result.inliers += (*mask)[i];
+		}
+
+		return result;
+	}
+}
@@ -0,0 +1,638 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <float.h>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+# define RANSAC_X86
+#endif
+
+#include <boxes/five_point.h>
+#include <boxes/ransac.h>
+#include <boxes/ransac_estimators.h>
+
+namespace Boxes {
+	// Moves points to their centroid and scales them to a mean distance of sqrt(2).
+	static cv::Matx33d normalize_points(const std::vector<double>* x, const std::vector<double>* y,
+			std::vector<double>* u, std::vector<double>* v) {
+		unsigned int n = x->size();
+
+		double cx = 0.0, cy = 0.0;
+		for (unsigned int i = 0; i < n; i++) {
+			cx += (*x)[i];
+			cy += (*y)[i];
+		}
+		cx /= n;
+		cy /= n;
+
+		double distance = 0.0;
+		for (unsigned int i = 0; i < n; i++)
+			distance += sqrt(((*x)[i] - cx) * ((*x)[i] - cx) + ((*y)[i] - cy) * ((*y)[i] - cy));
+		distance /= n;
+
+		double scale = (distance > 0.0) ? sqrt(2.0) / distance : 1.0;
+
+		u->resize(n);
+		v->resize(n);
+		for (unsigned int i = 0; i < n; i++) {
+			(*u)[i] = ((*x)[i] - cx) * scale;
+			(*v)[i] = ((*y)[i] - cy) * scale;
+		}
+
+		return cv::Matx33d(
+			scale, 0.0,   -cx * scale,
+			0.0,   scale, -cy * scale,
+			0.0,   0.0,    1.0
+		);
+	}
+
+	// Sets the smallest singular value to zero.
+	static cv::Matx33d enforce_rank2(const cv::Matx33d& F) {
+		cv::Matx31d w;
+		cv::Matx33d u, vt;
+		cv::SVD::compute(F, w, u, vt);
+
+		return u * cv::Matx33d::diag(cv::Matx31d(w(0), w(1), 0.0)) * vt;
+	}
+
+	static cv::Matx33d normalize_matrix(const cv::Matx33d& M) {
+		return M * (1.0 / cv::norm(M));
+	}
+
+	/*
+	 * Contructor.
+	 */
+	PointCorrespondences::PointCorrespondences(const std::vector<cv::Point2f>* points1, const std::vector<cv::Point2f>* points2,
+			const cv::Matx33d* camera1, const cv::Matx33d* camera2) :
+			RansacEstimator(points1->size()) {
+		cv::Matx33d c1_inv = camera1 ? camera1->inv() : cv::Matx33d::eye();
+		cv::Matx33d c2_inv = camera2 ? camera2->inv() : cv::Matx33d::eye();
+
+		this->x1.resize(this->n);
+		this->y1.resize(this->n);
+		this->x2.resize(this->n);
+		this->y2.resize(this->n);
+
+		for (unsigned int i = 0; i < this->n; i++) {
+			const cv::Point2f* pt1 = &(*points1)[i];
+			const cv::Point2f* pt2 = &(*points2)[i];
+
+			this->x1[i] = c1_inv(0,0) * pt1->x + c1_inv(0,1) * pt1->y + c1_inv(0,2);
+			this->y1[i] = c1_inv(1,0) * pt1->x + c1_inv(1,1) * pt1->y + c1_inv(1,2);
+			this->x2[i] = c2_inv(0,0) * pt2->x + c2_inv(0,1) * pt2->y + c2_inv(0,2);
+			this->y2[i] = c2_inv(1,0) * pt2->x + c2_inv(1,1) * pt2->y + c2_inv(1,2);
+		}
+
+		this->T1 = normalize_points(&this->x1, &this->y1, &this->u1, &this->v1);
+		this->T2 = normalize_points(&this->x2, &this->y2, &this->u2, &this->v2);
+	}
+
+	bool PointCorrespondences::fit_epipolar(const unsigned int* indices, unsigned int n, cv::Matx33d* F) const {
+		if (n < 8)
+			return false;
+
+		cv::Mat_<double> A(n, 9);
+		for (unsigned int i = 0; i < n; i++) {
+			unsigned int j = indices[i];
+			double* row = A[i];
+
+			row[0] = this->u2[j] * this->u1[j];
+			row[1] = this->u2[j] * this->v1[j];
+			row[2] = this->u2[j];
+			row[3] = this->v2[j] * this->u1[j];
+			row[4] = this->v2[j] * this->v1[j];
+			row[5] = this->v2[j];
+			row[6] = this->u1[j];
+			row[7] = this->v1[j];
+			row[8] = 1.0;
+		}
+
+		cv::Mat_<double> f;
+		cv::SVD::solveZ(A, f);
+
+		cv::Matx33d normalized(
+			f(0), f(1), f(2),
+			f(3), f(4), f(5),
+			f(6), f(7), f(8)
+		);
+
+		*F = normalize_matrix(this->T2.t() * enforce_rank2(normalized) * this->T1);
+
+		return true;
+	}
+
+	/*
+	 * Scoring kernels.
+	 *
+	 * Every hypothesis is scored against all points, which makes these
+	 * the innermost loops of RANSAC. They run over the struct of arrays
+	 * of the estimators, four points at a time where AVX2 is available.
+	 * Matrices are passed in row-major order.
+	 */
+
+	typedef void (*sampson_function)(const double* f, const double* x1, const double* y1,
+		const double* x2, const double* y2, unsigned int count, double* errors);
+	typedef void (*reprojection_function)(const double* p, const double* X, const double* Y, const double* Z,
+		const double* u, const double* v, unsigned int count, double* errors);
+
+	// The Sampson distance of x2^T * f * x1.
+	static void sampson_errors_generic(const double* f, const double* x1, const double* y1,
+			const double* x2, const double* y2, unsigned int count, double* errors) {
+		for (unsigned int i = 0; i < count; i++) {
+			double fx0 = f[0] * x1[i] + f[1] * y1[i] + f[2];
+			double fx1 = f[3] * x1[i] + f[4] * y1[i] + f[5];
+			double fx2 = f[6] * x1[i] + f[7] * y1[i] + f[8];
+
+			double ftx0 = f[0] * x2[i] + f[3] * y2[i] + f[6];
+			double ftx1 = f[1] * x2[i] + f[4] * y2[i] + f[7];
+
+			double e = x2[i] * fx0 + y2[i] * fx1 + fx2;
+
+			errors[i] = e * e / (fx0 * fx0 + fx1 * fx1 + ftx0 * ftx0 + ftx1 * ftx1);
+		}
+	}
+
+	// The squared distance of the projection of (X, Y, Z) with the 3x4 matrix p to (u, v).
+	static void reprojection_errors_generic(const double* p, const double* X, const double* Y, const double* Z,
+			const double* u, const double* v, unsigned int count, double* errors) {
+		for (unsigned int i = 0; i < count; i++) {
+			double px = p[0] * X[i] + p[1] * Y[i] + p[2]  * Z[i] + p[3];
+			double py = p[4] * X[i] + p[5] * Y[i] + p[6]  * Z[i] + p[7];
+			double pz = p[8] * X[i] + p[9] * Y[i] + p[10] * Z[i] + p[11];
+
+			// Points behind the camera are never inliers.
+			bool in_front = (pz > 0.0);
+			double inverse = in_front ? 1.0 / pz : 0.0;
+
+			double dx = px * inverse - u[i];
+			double dy = py * inverse - v[i];
+
+			errors[i] = in_front ? dx * dx + dy * dy : DBL_MAX;
+		}
+	}
+
+#ifdef RANSAC_X86
+	__attribute__((target("avx2")))
+	static void sampson_errors_avx2(const double* f, const double* x1, const double* y1,
+			const double* x2, const double* y2, unsigned int count, double* errors) {
+		const __m256d f0 = _mm256_set1_pd(f[0]), f1 = _mm256_set1_pd(f[1]), f2 = _mm256_set1_pd(f[2]);
+		const __m256d f3 = _mm256_set1_pd(f[3]), f4 = _mm256_set1_pd(f[4]), f5 = _mm256_set1_pd(f[5]);
+		const __m256d f6 = _mm256_set1_pd(f[6]), f7 = _mm256_set1_pd(f[7]), f8 = _mm256_set1_pd(f[8]);
+
+		unsigned int i = 0;
+
+		for (; i + 4 <= count; i += 4) {
+			__m256d a1 = _mm256_loadu_pd(x1 + i);
+			__m256d b1 = _mm256_loadu_pd(y1 + i);
+			__m256d a2 = _mm256_loadu_pd(x2 + i);
+			__m256d b2 = _mm256_loadu_pd(y2 + i);
+
+			__m256d fx0 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(f0, a1), _mm256_mul_pd(f1, b1)), f2);
+			__m256d fx1 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(f3, a1), _mm256_mul_pd(f4, b1)), f5);
+			__m256d fx2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(f6, a1), _mm256_mul_pd(f7, b1)), f8);
+
+			__m256d ftx0 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(f0, a2), _mm256_mul_pd(f3, b2)), f6);
+			__m256d ftx1 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(f1, a2), _mm256_mul_pd(f4, b2)), f7);
+
+			__m256d e = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a2, fx0), _mm256_mul_pd(b2, fx1)), fx2);
+
+			__m256d norm = _mm256_add_pd(
+				_mm256_add_pd(_mm256_mul_pd(fx0, fx0), _mm256_mul_pd(fx1, fx1)),
+				_mm256_add_pd(_mm256_mul_pd(ftx0, ftx0), _mm256_mul_pd(ftx1, ftx1))
+			);
+
+			_mm256_storeu_pd(errors + i, _mm256_div_pd(_mm256_mul_pd(e, e), norm));
+		}
+
+		sampson_errors_generic(f, x1 + i, y1 + i, x2 + i, y2 + i, count - i, errors + i);
+	}
+
+	__attribute__((target("avx2")))
+	static void reprojection_errors_avx2(const double* p, const double* X, const double* Y, const double* Z,
+			const double* u, const double* v, unsigned int count, double* errors) {
+		const __m256d p0 = _mm256_set1_pd(p[0]), p1 = _mm256_set1_pd(p[1]), p2  = _mm256_set1_pd(p[2]),  p3  = _mm256_set1_pd(p[3]);
+		const __m256d p4 = _mm256_set1_pd(p[4]), p5 = _mm256_set1_pd(p[5]), p6  = _mm256_set1_pd(p[6]),  p7  = _mm256_set1_pd(p[7]);
+		const __m256d p8 = _mm256_set1_pd(p[8]), p9 = _mm256_set1_pd(p[9]), p10 = _mm256_set1_pd(p[10]), p11 = _mm256_set1_pd(p[11]);
+
+		const __m256d zero = _mm256_setzero_pd();
+		const __m256d one = _mm256_set1_pd(1.0);
+		const __m256d behind = _mm256_set1_pd(DBL_MAX);
+
+		unsigned int i = 0;
+
+		for (; i + 4 <= count; i += 4) {
+			__m256d x = _mm256_loadu_pd(X + i);
+			__m256d y = _mm256_loadu_pd(Y + i);
+			__m256d z = _mm256_loadu_pd(Z + i);
+
+			__m256d px = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(p0, x), _mm256_mul_pd(p1, y)),
+				_mm256_add_pd(_mm256_mul_pd(p2, z), p3));
+			__m256d py = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(p4, x), _mm256_mul_pd(p5, y)),
+				_mm256_add_pd(_mm256_mul_pd(p6, z), p7));
+			__m256d pz = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(p8, x), _mm256_mul_pd(p9, y)),
+				_mm256_add_pd(_mm256_mul_pd(p10, z), p11));
+
+			// Points behind the camera are never inliers, and are not divided by.
+			__m256d in_front = _mm256_cmp_pd(pz, zero, _CMP_GT_OQ);
+			__m256d inverse = _mm256_div_pd(one, _mm256_blendv_pd(one, pz, in_front));
+
+			__m256d dx = _mm256_sub_pd(_mm256_mul_pd(px, inverse), _mm256_loadu_pd(u + i));
+			__m256d dy = _mm256_sub_pd(_mm256_mul_pd(py, inverse), _mm256_loadu_pd(v + i));
+
+			__m256d error = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+
+			_mm256_storeu_pd(errors + i, _mm256_blendv_pd(behind, error, in_front));
+		}
+
+		reprojection_errors_generic(p, X + i, Y + i, Z + i, u + i, v + i, count - i, errors + i);
+	}
+#endif
+
+	struct ScoringImplementation {
+		sampson_function sampson;
+		reprojection_function reprojection;
+	};
+
+	// Picks the fastest implementation for this CPU.
+	static ScoringImplementation select_implementation() {
+		ScoringImplementation impl = { sampson_errors_generic, reprojection_errors_generic };
+
+#ifdef RANSAC_X86
+		__builtin_cpu_init();
+
+		if (__builtin_cpu_supports("avx2")) {
+			impl.sampson = sampson_errors_avx2;
+			impl.reprojection = reprojection_errors_avx2;
+		}
+#endif
+
+		return impl;
+	}
+
+	static const ScoringImplementation* get_implementation() {
+		static const ScoringImplementation impl = select_implementation();
+
+		return &impl;
+	}
+
+	void PointCorrespondences::sampson_errors(const cv::Matx33d* F, unsigned int start, unsigned int count, double* errors) const {
+		get_implementation()->sampson(F->val, &this->x1[start], &this->y1[start],
+			&this->x2[start], &this->y2[start], count, errors);
+	}
+
+	/*
+	 * Contructor.
+	 */
+	FundamentalEstimator::FundamentalEstimator(const std::vector<cv::Point2f>* points1, const std::vector<cv::Point2f>* points2) :
+			PointCorrespondences(points1, points2) {
+	}
+
+	unsigned int FundamentalEstimator::sample_size() const {
+		return 8;
+	}
+
+	unsigned int FundamentalEstimator::fit_minimal(const unsigned int* sample, RansacModel* models) const {
+		return this->fit_epipolar(sample, this->sample_size(), &models[0].matrix) ? 1 : 0;
+	}
+
+	bool FundamentalEstimator::fit(const unsigned int* indices, unsigned int n, RansacModel* model) const {
+		return this->fit_epipolar(indices, n, &model->matrix);
+	}
+
+	void FundamentalEstimator::errors(const RansacModel* model, unsigned int start, unsigned int count, double* errors) const {
+		this->sampson_errors(&model->matrix, start, count, errors);
+	}
+
+	/*
+	 * Contructor.
+	 */
+	EssentialEstimator::EssentialEstimator(const std::vector<cv::Point2f>* points1, const std::vector<cv::Point2f>* points2,
+			const cv::Matx33d* camera1, const cv::Matx33d* camera2) :
+			PointCorrespondences(points1, points2, camera1, camera2) {
+	}
+
+	unsigned int EssentialEstimator::sample_size() const {
+		return FIVE_POINT_SAMPLE_SIZE;
+	}
+
+	unsigned int EssentialEstimator::fit_minimal(const unsigned int* sample, RansacModel* models) const {
+		cv::Vec2d x1[FIVE_POINT_SAMPLE_SIZE];
+		cv::Vec2d x2[FIVE_POINT_SAMPLE_SIZE];
+
+		for (unsigned int i = 0; i < FIVE_POINT_SAMPLE_SIZE; i++) {
+			x1[i] = cv::Vec2d(this->x1[sample[i]], this->y1[sample[i]]);
+			x2[i] = cv::Vec2d(this->x2[sample[i]], this->y2[sample[i]]);
+		}
+
+		cv::Matx33d solutions[FIVE_POINT_MAX_SOLUTIONS];
+		unsigned int count = five_point_solve(x1, x2, solutions);
+
+		for (unsigned int i = 0; i < count; i++)
+			models[i].matrix = solutions[i];
+
+		return count;
+	}
+
+	bool EssentialEstimator::fit(const unsigned int* indices, unsigned int n, RansacModel* model) const {
+		cv::Matx33d F;
+		if (!this->fit_epipolar(indices, n, &F))
+			return false;
+
+		// Project onto the essential matrices, which have two equal singular values.
+		cv::Matx31d w;
+		cv::Matx33d u, vt;
+		cv::SVD::compute(F, w, u, vt);
+
+		model->matrix = normalize_matrix(u * cv::Matx33d::diag(cv::Matx31d(1.0, 1.0, 0.0)) * vt);
+
+		return true;
+	}
+
+	void EssentialEstimator::errors(const RansacModel* model, unsigned int start, unsigned int count, double* errors) const {
+		this->sampson_errors(&model->matrix, start, count, errors);
+	}
+
+	/*
+	 * Contructor.
+	 */
+	HomographyEstimator::HomographyEstimator(const std::vector<cv::Point2f>* points1, const std::vector<cv::Point2f>* points2) :
+			PointCorrespondences(points1, points2) {
+	}
+
+	unsigned int HomographyEstimator::sample_size() const {
+		return 4;
+	}
+
+	unsigned int HomographyEstimator::fit_minimal(const unsigned int* sample, RansacModel* models) const {
+		return this->fit(sample, this->sample_size(), &models[0]) ? 1 : 0;
+	}
+
+	bool HomographyEstimator::fit(const unsigned int* indices, unsigned int n, RansacModel* model) const {
+		if (n < 4)
+			return false;
+
+		// Direct linear transformation.
+		cv::Mat_<double> A(2 * n, 9);
+		for (unsigned int i = 0; i < n; i++) {
+			unsigned int j = indices[i];
+			double u1 = this->u1[j], v1 = this->v1[j];
+			double u2 = this->u2[j], v2 = this->v2[j];
+
+			double* row = A[2 * i];
+			row[0] = -u1; row[1] = -v1; row[2] = -1.0;
+			row[3] = 0.0; row[4] = 0.0; row[5] = 0.0;
+			row[6] = u2 * u1; row[7] = u2 * v1; row[8] = u2;
+
+			row = A[2 * i + 1];
+			row[0] = 0.0; row[1] = 0.0; row[2] = 0.0;
+			row[3] = -u1; row[4] = -v1; row[5] = -1.0;
+			row[6] = v2 * u1; row[7] = v2 * v1; row[8] = v2;
+		}
+
+		cv::Mat_<double> h;
+		cv::SVD::solveZ(A, h);
+
+		cv::Matx33d H(
+			h(0), h(1), h(2),
+			h(3), h(4), h(5),
+			h(6), h(7), h(8)
+		);
+
+		H = this->T2.inv() * H * this->T1;
+		if (fabs(H(2,2)) < DBL_EPSILON)
+			return false;
+
+		model->matrix = H * (1.0 / H(2,2));
+
+		return true;
+	}
+
+	void HomographyEstimator::errors(const RansacModel* model, unsigned int start, unsigned int count, double* errors) const {
+		const cv::Matx33d& H = model->matrix;
+
+		const double* x1 = &this->x1[start];
+		const double* y1 = &this->y1[start];
+		const double* x2 = &this->x2[start];
+		const double* y2 = &this->y2[start];
+
+		for (unsigned int i = 0; i < count; i++) {
+			double w = 1.0 / (H(2,0) * x1[i] + H(2,1) * y1[i] + H(2,2));
+			double dx = (H(0,0) * x1[i] + H(0,1) * y1[i] + H(0,2)) * w - x2[i];
+			double dy = (H(1,0) * x1[i] + H(1,1) * y1[i] + H(1,2)) * w - y2[i];
+
+			errors[i] = dx * dx + dy * dy;
+		}
+	}
+
+	/*
+	 * Contructor.
+	 */
+	PnPEstimator::PnPEstimator(const std::vector<cv::Point3f>* object_points, const std::vector<cv::Point2f>* image_points,
+			const cv::Matx33d* camera) :
+			RansacEstimator(object_points->size()) {
+		this->object_points = object_points;
+		this->image_points = image_points;
+		this->camera = *camera;
+
+		this->X.resize(this->n);
+		this->Y.resize(this->n);
+		this->Z.resize(this->n);
+		this->u.resize(this->n);
+		this->v.resize(this->n);
+
+		for (unsigned int i = 0; i < this->n; i++) {
+			this->X[i] = (*object_points)[i].x;
+			this->Y[i] = (*object_points)[i].y;
+			this->Z[i] = (*object_points)[i].z;
+			this->u[i] = (*image_points)[i].x;
+			this->v[i] = (*image_points)[i].y;
+		}
+	}
+
+	unsigned int PnPEstimator::sample_size() const {
+		// EPnP needs at least four points, a fifth one makes it a lot more stable.
+		return 5;
+	}
+
+	bool PnPEstimator::solve(const unsigned int* indices, unsigned int n, int flags, RansacModel* model) const {
+		std::vector<cv::Point3f> object_points(n);
+		std::vector<cv::Point2f> image_points(n);
+
+		for (unsigned int i = 0; i < n; i++) {
+			object_points[i] = (*this->object_points)[indices[i]];
+			image_points[i] = (*this->image_points)[indices[i]];
+		}
+
+		bool guess = (flags == CV_ITERATIVE);
+
+		cv::Mat_<double> rvec, tvec;
+		cv::Mat_<double> rotation;
+
+		/*
+		 * Degenerate samples make OpenCV throw. This runs inside the parallel
+		 * loop of Ransac, which must not be left by an exception, so the
+		 * sample is only rejected.
+		 */
+		try {
+			if (guess) {
+				cv::Rodrigues(cv::Mat(model->matrix), rvec);
+				tvec = cv::Mat(model->translation).clone();
+			}
+
+			std::vector<double> distortion_coeff;
+			cv::solvePnP(object_points, image_points, cv::Mat(this->camera), distortion_coeff, rvec, tvec, guess, flags);
+
+			cv::Rodrigues(rvec, rotation);
+		} catch (cv::Exception& e) {
+			return false;
+		}
+
+		model->matrix = cv::Matx33d((double*)rotation.ptr());
+		model->translation = cv::Vec3d(tvec(0), tvec(1), tvec(2));
+
+		return cv::checkRange(rotation) && cv::checkRange(tvec);
+	}
+
+	unsigned int PnPEstimator::fit_minimal(const unsigned int* sample, RansacModel* models) const {
+		return this->solve(sample, this->sample_size(), CV_EPNP, &models[0]) ? 1 : 0;
+	}
+
+	bool PnPEstimator::fit(const unsigned int* indices, unsigned int n, RansacModel* model) const {
+		return this->solve(indices, n, CV_ITERATIVE, model);
+	}
+
+	void PnPEstimator::errors(const RansacModel* model, unsigned int start, unsigned int count, double* errors) const {
+		// Project with K * [R|t].
+		cv::Matx33d KR = this->camera * model->matrix;
+		cv::Vec3d Kt = this->camera * model->translation;
+
+		const double P[12] = {
+			KR(0,0), KR(0,1), KR(0,2), Kt[0],
+			KR(1,0), KR(1,1), KR(1,2), Kt[1],
+			KR(2,0), KR(2,1), KR(2,2), Kt[2]
+		};
+
+		get_implementation()->reprojection(P, &this->X[start], &this->Y[start], &this->Z[start],
+			&this->u[start], &this->v[start], count, errors);
+	}
+
+	SimilarityEstimator::SimilarityEstimator(const std::vector<cv::Point3d>* points1, const std::vector<cv::Point3d>* points2) :
+			RansacEstimator(points1->size()) {
+		this->X1.resize(this->n);
+		this->Y1.resize(this->n);
+		this->Z1.resize(this->n);
+		this->X2.resize(this->n);
+		this->Y2.resize(this->n);
+		this->Z2.resize(this->n);
+
+		for (unsigned int i = 0; i < this->n; i++) {
+			this->X1[i] = (*points1)[i].x;
+			this->Y1[i] = (*points1)[i].y;
+			this->Z1[i] = (*points1)[i].z;
+			this->X2[i] = (*points2)[i].x;
+			this->Y2[i] = (*points2)[i].y;
+			this->Z2[i] = (*points2)[i].z;
+		}
+	}
+
+	unsigned int SimilarityEstimator::sample_size() const {
+		return 3;
+	}
+
+	unsigned int SimilarityEstimator::fit_minimal(const unsigned int* sample, RansacModel* models) const {
+		return this->fit(sample, this->sample_size(), &models[0]) ? 1 : 0;
+	}
+
+	bool SimilarityEstimator::fit(const unsigned int* indices, unsigned int n, RansacModel* model) const {
+		// Umeyama: the rotation comes from the SVD of the cross covariance of both centered point sets.
+		cv::Vec3d c1, c2;
+		for (unsigned int i = 0; i < n; i++) {
+			unsigned int j = indices[i];
+
+			c1 += cv::Vec3d(this->X1[j], this->Y1[j], this->Z1[j]);
+			c2 += cv::Vec3d(this->X2[j], this->Y2[j], this->Z2[j]);
+		}
+		c1 = c1 * (1.0 / n);
+		c2 = c2 * (1.0 / n);
+
+		cv::Matx33d covariance = cv::Matx33d::zeros();
+		double variance = 0.0;
+
+		for (unsigned int i = 0; i < n; i++) {
+			unsigned int j = indices[i];
+
+			cv::Vec3d d1(this->X1[j] - c1[0], this->Y1[j] - c1[1], this->Z1[j] - c1[2]);
+			cv::Vec3d d2(this->X2[j] - c2[0], this->Y2[j] - c2[1], this->Z2[j] - c2[2]);
+
+			for (unsigned int r = 0; r < 3; r++) {
+				for (unsigned int c = 0; c < 3; c++)
+					covariance(r, c) += d2[r] * d1[c];
+			}
+
+			variance += d1.dot(d1);
+		}
+
+		// All points are the same.
+		if (variance < DBL_EPSILON)
+			return false;
+
+		cv::Matx31d w;
+		cv::Matx33d u, vt;
+		cv::SVD::compute(covariance, w, u, vt);
+
+		// Flip the smallest axis, if the best orthogonal matrix is a reflection.
+		double sign = (cv::determinant(u) * cv::determinant(vt) < 0.0) ? -1.0 : 1.0;
+
+		cv::Matx33d rotation = u * cv::Matx33d(1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, sign) * vt;
+		double scale = (w(0) + w(1) + sign * w(2)) / variance;
+
+		// Collinear points do not fix the rotation.
+		if (!(scale > 0.0) || w(1) < DBL_EPSILON * w(0))
+			return false;
+
+		model->matrix = rotation * scale;
+		model->translation = c2 - model->matrix * c1;
+
+		return cv::checkRange(cv::Mat(model->matrix)) && cv::checkRange(cv::Mat(model->translation));
+	}
+
+	void SimilarityEstimator::errors(const RansacModel* model, unsigned int start, unsigned int count, double* errors) const {
+		const cv::Matx33d& M = model->matrix;
+		const cv::Vec3d& t = model->translation;
+
+		const double* X1 = &this->X1[start];
+		const double* Y1 = &this->Y1[start];
+		const double* Z1 = &this->Z1[start];
+		const double* X2 = &this->X2[start];
+		const double* Y2 = &this->Y2[start];
+		const double* Z2 = &this->Z2[start];
+
+		for (unsigned int i = 0; i < count; i++) {
+			double dx = M(0,0) * X1[i] + M(0,1) * Y1[i] + M(0,2) * Z1[i] + t[0] - X2[i];
+			double dy = M(1,0) * X1[i] + M(1,1) * Y1[i] + M(1,2) * Z1[i] + t[1] - Y2[i];
+			double dz = M(2,0) * X1[i] + M(2,1) * Y1[i] + M(2,2) * Z1[i] + t[2] - Z2[i];
+
+			errors[i] = dx * dx + dy * dy + dz * dz;
+		}
+	}
+}
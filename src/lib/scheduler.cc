@@ -0,0 +1,266 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <thread>
+#include <vector>
+
+#ifdef _OPENMP
+# include <omp.h>
+#endif
+
+#include <boxes/scheduler.h>
+
+namespace Boxes {
+	// The scheduler and queue of the worker that runs on this thread.
+	static thread_local const Scheduler* current_scheduler = NULL;
+	static thread_local unsigned int current_worker = 0;
+
+	/*
+	 * Contructor.
+	 */
+	TaskGroup::TaskGroup() {
+		this->pending = 0;
+	}
+
+	/*
+	 * Contructor.
+	 */
+	Scheduler::Scheduler(unsigned int threads) {
+		if (threads == 0)
+			threads = std::thread::hardware_concurrency();
+
+		this->threads = std::max(threads, 1u);
+		this->queued = 0;
+
+		for (unsigned int i = 0; i < this->threads; i++)
+			this->queues.push_back(new Queue());
+
+#ifdef _OPENMP
+		// OpenMP loops outside of the pool use as many threads as the pool.
+		omp_set_num_threads(this->threads);
+#endif
+
+		// OpenCV must not start threads of its own while all workers are busy.
+		this->opencv_threads = cv::getNumThreads();
+		if (this->threads > 1)
+			cv::setNumThreads(1);
+
+		// The thread that waits is the last worker.
+		for (unsigned int i = 0; i < this->threads - 1; i++)
+			this->workers.push_back(std::thread(&Scheduler::work, this, i));
+	}
+
+	Scheduler::~Scheduler() {
+		{
+			std::lock_guard<std::mutex> lock(this->sleep_mutex);
+			this->stopping = true;
+		}
+		this->sleep.notify_all();
+
+		for (std::thread& worker: this->workers)
+			worker.join();
+
+		for (Queue* queue: this->queues)
+			delete queue;
+
+		cv::setNumThreads(this->opencv_threads);
+	}
+
+	unsigned int Scheduler::size() const {
+		return this->threads;
+	}
+
+	unsigned int Scheduler::current_queue() const {
+		if (current_scheduler == this)
+			return current_worker;
+
+		return this->threads - 1;
+	}
+
+	void Scheduler::run(TaskGroup* group, Task task) {
+		group->pending++;
+
+		Queue* queue = this->queues[this->current_queue()];
+		{
+			std::lock_guard<std::mutex> lock(queue->mutex);
+
+			// Count the job before anyone can take it, so that the count never drops below zero.
+			this->queued++;
+
+			Job job = { task, group };
+			queue->jobs.push_back(job);
+		}
+
+		this->notify();
+	}
+
+	void Scheduler::wait(TaskGroup* group) {
+		while (group->pending > 0) {
+			Job job;
+
+			if (this->find(&job)) {
+				this->execute(&job);
+				continue;
+			}
+
+			// The remaining tasks of the group are running on other threads.
+			std::unique_lock<std::mutex> lock(this->sleep_mutex);
+			this->sleep.wait(lock, [this, group]() {
+				return group->pending == 0 || this->queued > 0;
+			});
+		}
+
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::mutex> lock(group->mutex);
+
+			error = group->error;
+			group->error = std::exception_ptr();
+		}
+
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	void Scheduler::parallel_for(unsigned int begin, unsigned int end, unsigned int grain,
+			std::function<void(unsigned int)> function) {
+		if (grain == 0)
+			grain = 1;
+
+		// The indices are split the same way for any number of threads.
+		TaskGroup group;
+
+		for (unsigned int start = begin; start < end; start += grain) {
+			unsigned int stop = std::min(start + grain, end);
+
+			this->run(&group, [start, stop, &function]() {
+				for (unsigned int i = start; i < stop; i++)
+					function(i);
+			});
+		}
+
+		this->wait(&group);
+	}
+
+	bool Scheduler::find(Job* job) {
+		if (this->queued == 0)
+			return false;
+
+		unsigned int own = this->current_queue();
+
+		// Newest task of the own queue first.
+		{
+			Queue* queue = this->queues[own];
+			std::lock_guard<std::mutex> lock(queue->mutex);
+
+			if (!queue->jobs.empty()) {
+				*job = queue->jobs.back();
+				queue->jobs.pop_back();
+
+				this->queued--;
+				return true;
+			}
+		}
+
+		// Then the oldest task of any other queue.
+		for (unsigned int i = 1; i < this->threads; i++) {
+			Queue* queue = this->queues[(own + i) % this->threads];
+			std::lock_guard<std::mutex> lock(queue->mutex);
+
+			if (!queue->jobs.empty()) {
+				*job = queue->jobs.front();
+				queue->jobs.pop_front();
+
+				this->queued--;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void Scheduler::execute(Job* job) {
+		TaskGroup* group = job->group;
+
+#ifdef _OPENMP
+		// Tasks run on one thread here as well, while the workers are busy with the others.
+		int omp_threads = omp_get_max_threads();
+		omp_set_num_threads(1);
+#endif
+
+		try {
+			job->task();
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(group->mutex);
+
+			if (!group->error)
+				group->error = std::current_exception();
+		}
+
+#ifdef _OPENMP
+		omp_set_num_threads(omp_threads);
+#endif
+
+		// The group may be gone as soon as its last task is done.
+		if (--group->pending == 0)
+			this->notify();
+	}
+
+	void Scheduler::notify() {
+		// Take the lock, so that no thread misses this between its check and going to sleep.
+		{
+			std::lock_guard<std::mutex> lock(this->sleep_mutex);
+		}
+
+		this->sleep.notify_all();
+	}
+
+	void Scheduler::work(unsigned int index) {
+		current_scheduler = this;
+		current_worker = index;
+
+#ifdef _OPENMP
+		// Parallel loops inside of tasks run on the worker alone.
+		omp_set_num_threads(1);
+#endif
+
+		while (true) {
+			Job job;
+
+			if (this->find(&job)) {
+				this->execute(&job);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(this->sleep_mutex);
+			this->sleep.wait(lock, [this]() {
+				return this->stopping || this->queued > 0;
+			});
+
+			if (this->stopping && this->queued == 0)
+				return;
+		}
+	}
+}
@@ -0,0 +1,287 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <algorithm>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include <boxes/constants.h>
+#include <boxes/converters.h>
+#include <boxes/scheduler.h>
+#include <boxes/structs.h>
+#include <boxes/tracks.h>
+#include <boxes/triangulation.h>
+
+namespace Boxes {
+	static inline uint64_t keypoint_key(unsigned int image, int keypoint) {
+		return ((uint64_t)image << 32) | (uint32_t)keypoint;
+	}
+
+	// Packs the coordinates of a point into one key, so that equal points have equal keys.
+	static inline uint64_t coordinate_key(const cv::Point2f* pt) {
+		uint32_t x, y;
+		memcpy(&x, &pt->x, sizeof(x));
+		memcpy(&y, &pt->y, sizeof(y));
+
+		return ((uint64_t)x << 32) | y;
+	}
+
+	int Tracks::find_node(unsigned int image, int keypoint, const cv::Point2f* pt) const {
+		if (keypoint != MATCH_NO_KEYPOINT) {
+			std::unordered_map<uint64_t, unsigned int>::const_iterator i = this->keypoint_nodes.find(keypoint_key(image, keypoint));
+
+			return (i == this->keypoint_nodes.end()) ? -1 : i->second;
+		}
+
+		std::map<std::pair<unsigned int, uint64_t>, unsigned int>::const_iterator i =
+			this->coordinate_nodes.find(std::make_pair(image, coordinate_key(pt)));
+
+		return (i == this->coordinate_nodes.end()) ? -1 : i->second;
+	}
+
+	unsigned int Tracks::add_node(unsigned int image, int keypoint, const cv::Point2f* pt) {
+		int node = this->find_node(image, keypoint, pt);
+		if (node >= 0)
+			return node;
+
+		node = this->parents.size();
+
+		if (keypoint != MATCH_NO_KEYPOINT)
+			this->keypoint_nodes.insert(std::make_pair(keypoint_key(image, keypoint), node));
+		else
+			this->coordinate_nodes.insert(std::make_pair(std::make_pair(image, coordinate_key(pt)), node));
+
+		this->node_images.push_back(image);
+		this->node_keypoints.push_back(keypoint);
+		this->node_coordinates.push_back(*pt);
+
+		this->parents.push_back(node);
+		this->ranks.push_back(0);
+
+		return node;
+	}
+
+	unsigned int Tracks::find_root(unsigned int node) {
+		unsigned int root = node;
+		while (this->parents[root] != root)
+			root = this->parents[root];
+
+		// Path compression
+		while (this->parents[node] != root) {
+			unsigned int parent = this->parents[node];
+			this->parents[node] = root;
+			node = parent;
+		}
+
+		return root;
+	}
+
+	void Tracks::unite(unsigned int node1, unsigned int node2) {
+		unsigned int root1 = this->find_root(node1);
+		unsigned int root2 = this->find_root(node2);
+
+		if (root1 == root2)
+			return;
+
+		// Union by rank
+		if (this->ranks[root1] < this->ranks[root2])
+			std::swap(root1, root2);
+
+		this->parents[root2] = root1;
+
+		if (this->ranks[root1] == this->ranks[root2])
+			this->ranks[root1]++;
+	}
+
+	void Tracks::add_match(unsigned int image1, int keypoint1, const cv::Point2f* pt1,
+			unsigned int image2, int keypoint2, const cv::Point2f* pt2) {
+		unsigned int node1 = this->add_node(image1, keypoint1, pt1);
+		unsigned int node2 = this->add_node(image2, keypoint2, pt2);
+
+		this->unite(node1, node2);
+	}
+
+	void Tracks::build() {
+		unsigned int nodes = this->parents.size();
+
+		// Number the tracks in the order of their first node.
+		std::vector<int> root_tracks(nodes, -1);
+		std::vector<unsigned int> sizes;
+
+		this->node_tracks.assign(nodes, -1);
+
+		for (unsigned int node = 0; node < nodes; node++) {
+			unsigned int root = this->find_root(node);
+
+			if (root_tracks[root] < 0) {
+				root_tracks[root] = sizes.size();
+				sizes.push_back(0);
+			}
+
+			this->node_tracks[node] = root_tracks[root];
+			sizes[root_tracks[root]]++;
+		}
+
+		std::vector<unsigned int> track_offsets(sizes.size() + 1, 0);
+		for (unsigned int t = 0; t < sizes.size(); t++)
+			track_offsets[t + 1] = track_offsets[t] + sizes[t];
+
+		std::vector<unsigned int> track_nodes(nodes);
+		std::vector<unsigned int> next(track_offsets.begin(), track_offsets.end() - 1);
+
+		for (unsigned int node = 0; node < nodes; node++)
+			track_nodes[next[this->node_tracks[node]]++] = node;
+
+		// Keep the consistent tracks only, with their observations sorted by image.
+		this->offsets.assign(1, 0);
+		this->images.clear();
+		this->keypoints.clear();
+		this->coordinates.clear();
+
+		std::vector<int> tracks(sizes.size(), -1);
+
+		for (unsigned int t = 0; t < sizes.size(); t++) {
+			std::vector<unsigned int>::iterator begin = track_nodes.begin() + track_offsets[t];
+			std::vector<unsigned int>::iterator end = track_nodes.begin() + track_offsets[t + 1];
+
+			std::sort(begin, end, [this](unsigned int a, unsigned int b) {
+				return this->node_images[a] < this->node_images[b];
+			});
+
+			bool consistent = true;
+			for (std::vector<unsigned int>::iterator i = begin + 1; i < end; i++)
+				consistent = consistent && (this->node_images[*i] != this->node_images[*(i - 1)]);
+
+			if (!consistent)
+				continue;
+
+			tracks[t] = this->offsets.size() - 1;
+
+			for (std::vector<unsigned int>::iterator i = begin; i != end; i++) {
+				this->images.push_back(this->node_images[*i]);
+				this->keypoints.push_back(this->node_keypoints[*i]);
+				this->coordinates.push_back(this->node_coordinates[*i]);
+			}
+
+			this->offsets.push_back(this->images.size());
+		}
+
+		for (unsigned int node = 0; node < nodes; node++)
+			this->node_tracks[node] = tracks[this->node_tracks[node]];
+
+		this->points.clear();
+		this->reprojection_errors.clear();
+		this->valid.clear();
+	}
+
+	unsigned int Tracks::size() const {
+		return this->offsets.empty() ? 0 : this->offsets.size() - 1;
+	}
+
+	unsigned int Tracks::observation_count() const {
+		return this->images.size();
+	}
+
+	int Tracks::find(unsigned int image, int keypoint, const cv::Point2f* pt) const {
+		int node = this->find_node(image, keypoint, pt);
+		if (node < 0 || (unsigned int)node >= this->node_tracks.size())
+			return -1;
+
+		return this->node_tracks[node];
+	}
+
+	void Tracks::triangulate(const std::vector<cv::Matx33d>* cameras, const std::vector<cv::Matx34d>* poses,
+			Scheduler* scheduler) {
+		int n = this->size();
+
+		this->points.resize(n);
+		this->reprojection_errors.resize(n);
+		this->valid.resize(n);
+
+		std::vector<cv::Matx33d> inverse_cameras(cameras->size());
+		for (unsigned int i = 0; i < cameras->size(); i++)
+			inverse_cameras[i] = (*cameras)[i].inv();
+
+		scheduler->parallel_for(0, n, TRACKS_PER_TASK, [&](unsigned int t) {
+			unsigned int start = this->offsets[t];
+			unsigned int count = this->offsets[t + 1] - start;
+
+			std::vector<cv::Vec2d> x(count);
+			std::vector<cv::Matx34d> track_poses(count);
+
+			for (unsigned int i = 0; i < count; i++) {
+				unsigned int image = this->images[start + i];
+				const cv::Matx33d& c_inv = inverse_cameras[image];
+				const cv::Point2f* pt = &this->coordinates[start + i];
+
+				x[i] = cv::Vec2d(
+					c_inv(0,0) * pt->x + c_inv(0,1) * pt->y + c_inv(0,2),
+					c_inv(1,0) * pt->x + c_inv(1,1) * pt->y + c_inv(1,2)
+				);
+				track_poses[i] = (*poses)[image];
+			}
+
+			cv::Vec3d X;
+			this->valid[t] = triangulate_views(&x[0], &track_poses[0], count, &X);
+			this->points[t] = cv::Point3d(X[0], X[1], X[2]);
+		});
+
+		this->reproject(cameras, poses, scheduler);
+	}
+
+	void Tracks::reproject(const std::vector<cv::Matx33d>* cameras, const std::vector<cv::Matx34d>* poses,
+			Scheduler* scheduler) {
+		int n = this->size();
+
+		this->reprojection_errors.assign(n, 0.0);
+
+		scheduler->parallel_for(0, n, TRACKS_PER_TASK, [&](unsigned int t) {
+			if (!this->valid[t])
+				return;
+
+			unsigned int start = this->offsets[t];
+			unsigned int count = this->offsets[t + 1] - start;
+
+			cv::Vec4d X(this->points[t].x, this->points[t].y, this->points[t].z, 1.0);
+
+			// Mean reprojection error over all observations.
+			double error = 0.0;
+			for (unsigned int i = 0; i < count; i++) {
+				unsigned int image = this->images[start + i];
+				cv::Vec3d p = (*cameras)[image] * ((*poses)[image] * X);
+
+				// The point must be in front of all cameras.
+				if (p[2] <= BOXES_EPSILON) {
+					this->valid[t] = false;
+					break;
+				}
+
+				double dx = p[0] / p[2] - this->coordinates[start + i].x;
+				double dy = p[1] / p[2] - this->coordinates[start + i].y;
+
+				error += sqrt(dx * dx + dy * dy);
+			}
+
+			this->reprojection_errors[t] = this->valid[t] ? error / count : 0.0;
+		});
+	}
+}
@@ -0,0 +1,328 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include <boxes/constants.h>
+#include <boxes/triangulation.h>
+
+namespace Boxes {
+	/*
+	 * A batch of correspondences, stored lane by lane so that the loops
+	 * below compile to vector instructions.
+	 */
+	struct TriangulationBatch {
+		double x1[TRIANGULATION_BATCH_SIZE];
+		double y1[TRIANGULATION_BATCH_SIZE];
+		double x2[TRIANGULATION_BATCH_SIZE];
+		double y2[TRIANGULATION_BATCH_SIZE];
+
+		double weight1[TRIANGULATION_BATCH_SIZE];
+		double weight2[TRIANGULATION_BATCH_SIZE];
+
+		double X[TRIANGULATION_BATCH_SIZE];
+		double Y[TRIANGULATION_BATCH_SIZE];
+		double Z[TRIANGULATION_BATCH_SIZE];
+
+		bool valid[TRIANGULATION_BATCH_SIZE];
+	};
+
+	// Adds the row (a0, a1, a2 | b) to the normal equations.
+	static inline void add_row(double a0, double a1, double a2, double b, double* m, double* r) {
+		m[0] += a0 * a0;
+		m[1] += a0 * a1;
+		m[2] += a0 * a2;
+		m[3] += a1 * a1;
+		m[4] += a1 * a2;
+		m[5] += a2 * a2;
+
+		r[0] += a0 * b;
+		r[1] += a1 * b;
+		r[2] += a2 * b;
+	}
+
+	// Adds the two rows that one camera contributes, each divided by weight.
+	static inline void add_camera(double x, double y, double weight, const cv::Matx34d& p, double* m, double* r) {
+		double w = 1.0 / weight;
+
+		add_row((x * p(2,0) - p(0,0)) * w, (x * p(2,1) - p(0,1)) * w, (x * p(2,2) - p(0,2)) * w,
+			-(x * p(2,3) - p(0,3)) * w, m, r);
+		add_row((y * p(2,0) - p(1,0)) * w, (y * p(2,1) - p(1,1)) * w, (y * p(2,2) - p(1,2)) * w,
+			-(y * p(2,3) - p(1,3)) * w, m, r);
+	}
+
+	/*
+	 * Solves the symmetric 3x3 normal equations with the adjugate, which
+	 * has no branches and no pivoting.
+	 *
+	 * Returns false if the system is close to singular (e.g. parallel
+	 * rays). The determinant is compared relative to the scale of the
+	 * system, which changes with the weights. The solution is zero then.
+	 */
+	static inline bool solve_normal_equations(const double* m, const double* r, double* X, double* Y, double* Z) {
+		double c00 = m[3] * m[5] - m[4] * m[4];
+		double c01 = m[2] * m[4] - m[1] * m[5];
+		double c02 = m[1] * m[4] - m[2] * m[3];
+		double c11 = m[0] * m[5] - m[2] * m[2];
+		double c12 = m[1] * m[2] - m[0] * m[4];
+		double c22 = m[0] * m[3] - m[1] * m[1];
+
+		double det = m[0] * c00 + m[1] * c01 + m[2] * c02;
+		double scale = m[0] + m[3] + m[5];
+
+		bool valid = (det > BOXES_EPSILON * scale * scale * scale);
+		double inverse = valid ? 1.0 / det : 0.0;
+
+		*X = (c00 * r[0] + c01 * r[1] + c02 * r[2]) * inverse;
+		*Y = (c01 * r[0] + c11 * r[1] + c12 * r[2]) * inverse;
+		*Z = (c02 * r[0] + c12 * r[1] + c22 * r[2]) * inverse;
+
+		return valid;
+	}
+
+	// Solves the weighted 4x3 system of one point.
+	static inline bool solve(double x1, double y1, double weight1, const cv::Matx34d& p1,
+			double x2, double y2, double weight2, const cv::Matx34d& p2, double* X, double* Y, double* Z) {
+		double m[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+		double r[3] = { 0.0, 0.0, 0.0 };
+
+		add_camera(x1, y1, weight1, p1, m, r);
+		add_camera(x2, y2, weight2, p2, m, r);
+
+		return solve_normal_equations(m, r, X, Y, Z);
+	}
+
+	// Solves the weighted 2n x 3 system of one point seen by n cameras.
+	static inline bool solve_views(const cv::Vec2d* x, const cv::Matx34d* poses, const double* weights, unsigned int n,
+			double* X, double* Y, double* Z) {
+		double m[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+		double r[3] = { 0.0, 0.0, 0.0 };
+
+		for (unsigned int i = 0; i < n; i++)
+			add_camera(x[i][0], x[i][1], weights[i], poses[i], m, r);
+
+		return solve_normal_equations(m, r, X, Y, Z);
+	}
+
+	// Triangulates the first N points of the batch.
+	template <unsigned int N>
+	static void triangulate_batch(TriangulationBatch* batch, const cv::Matx34d& p1, const cv::Matx34d& p2) {
+		bool active[N];
+
+		for (unsigned int i = 0; i < N; i++) {
+			batch->weight1[i] = 1.0;
+			batch->weight2[i] = 1.0;
+			active[i] = true;
+
+			batch->valid[i] = solve(batch->x1[i], batch->y1[i], batch->weight1[i], p1,
+				batch->x2[i], batch->y2[i], batch->weight2[i], p2,
+				&batch->X[i], &batch->Y[i], &batch->Z[i]);
+		}
+
+		// It is suggested to run 10 iterations at most.
+		for (unsigned int iteration = 0; iteration < TRIANGULATION_MAX_ITERATIONS; iteration++) {
+			bool any_active = false;
+
+			for (unsigned int i = 0; i < N; i++) {
+				// Recalculate weights
+				double weight1 = p1(2,0) * batch->X[i] + p1(2,1) * batch->Y[i] + p1(2,2) * batch->Z[i] + p1(2,3);
+				double weight2 = p2(2,0) * batch->X[i] + p2(2,1) * batch->Y[i] + p2(2,2) * batch->Z[i] + p2(2,3);
+
+				// Points on the principal plane of a camera cannot be weighted by their depth.
+				batch->valid[i] = batch->valid[i] && !IS_ZERO(weight1) && !IS_ZERO(weight2);
+
+				// Points stop, once the gained precision is smaller than epsilon.
+				bool converged = (fabs(batch->weight1[i] - weight1) <= TRIANGULATION_EPSILON)
+					&& (fabs(batch->weight2[i] - weight2) <= TRIANGULATION_EPSILON);
+				active[i] = active[i] && batch->valid[i] && !converged;
+
+				batch->weight1[i] = active[i] ? weight1 : batch->weight1[i];
+				batch->weight2[i] = active[i] ? weight2 : batch->weight2[i];
+
+				any_active |= active[i];
+			}
+
+			if (!any_active)
+				break;
+
+			// Re-weight the equations of all points that are still active.
+			for (unsigned int i = 0; i < N; i++) {
+				double X, Y, Z;
+				bool valid = solve(batch->x1[i], batch->y1[i], batch->weight1[i], p1,
+					batch->x2[i], batch->y2[i], batch->weight2[i], p2, &X, &Y, &Z);
+
+				batch->X[i] = active[i] ? X : batch->X[i];
+				batch->Y[i] = active[i] ? Y : batch->Y[i];
+				batch->Z[i] = active[i] ? Z : batch->Z[i];
+				batch->valid[i] = active[i] ? valid : batch->valid[i];
+			}
+		}
+	}
+
+	bool triangulate_correspondence(const cv::Vec2d& x1, const cv::Matx34d& p1, const cv::Vec2d& x2, const cv::Matx34d& p2,
+			cv::Vec3d* point) {
+		TriangulationBatch batch;
+
+		batch.x1[0] = x1[0];
+		batch.y1[0] = x1[1];
+		batch.x2[0] = x2[0];
+		batch.y2[0] = x2[1];
+
+		triangulate_batch<1>(&batch, p1, p2);
+
+		*point = cv::Vec3d(batch.X[0], batch.Y[0], batch.Z[0]);
+		return batch.valid[0];
+	}
+
+	void triangulate_correspondences(const cv::Point2f* points1, const cv::Point2f* points2, unsigned int n,
+			const cv::Matx33d& camera1, const cv::Matx34d& p1, const cv::Matx33d& camera2, const cv::Matx34d& p2,
+			cv::Point3d* points, double* reprojection_errors, uchar* valid) {
+		cv::Matx33d c1_inv = camera1.inv();
+		cv::Matx33d c2_inv = camera2.inv();
+
+		cv::Matx34d KP2 = camera2 * p2;
+
+		TriangulationBatch batch;
+
+		for (unsigned int start = 0; start < n; start += TRIANGULATION_BATCH_SIZE) {
+			unsigned int size = n - start;
+			if (size > TRIANGULATION_BATCH_SIZE)
+				size = TRIANGULATION_BATCH_SIZE;
+
+			// Normalize the coordinates, the last batch is padded with its last point.
+			for (unsigned int i = 0; i < TRIANGULATION_BATCH_SIZE; i++) {
+				const cv::Point2f* pt1 = &points1[start + ((i < size) ? i : size - 1)];
+				const cv::Point2f* pt2 = &points2[start + ((i < size) ? i : size - 1)];
+
+				batch.x1[i] = c1_inv(0,0) * pt1->x + c1_inv(0,1) * pt1->y + c1_inv(0,2);
+				batch.y1[i] = c1_inv(1,0) * pt1->x + c1_inv(1,1) * pt1->y + c1_inv(1,2);
+				batch.x2[i] = c2_inv(0,0) * pt2->x + c2_inv(0,1) * pt2->y + c2_inv(0,2);
+				batch.y2[i] = c2_inv(1,0) * pt2->x + c2_inv(1,1) * pt2->y + c2_inv(1,2);
+			}
+
+			triangulate_batch<TRIANGULATION_BATCH_SIZE>(&batch, p1, p2);
+
+			for (unsigned int i = 0; i < size; i++) {
+				double X = batch.X[i], Y = batch.Y[i], Z = batch.Z[i];
+
+				// Reproject the point into the second image.
+				double u = KP2(0,0) * X + KP2(0,1) * Y + KP2(0,2) * Z + KP2(0,3);
+				double v = KP2(1,0) * X + KP2(1,1) * Y + KP2(1,2) * Z + KP2(1,3);
+				double w = KP2(2,0) * X + KP2(2,1) * Y + KP2(2,2) * Z + KP2(2,3);
+
+				bool is_valid = batch.valid[i] && !IS_ZERO(w);
+				double inverse = is_valid ? 1.0 / w : 0.0;
+
+				double dx = u * inverse - points2[start + i].x;
+				double dy = v * inverse - points2[start + i].y;
+
+				points[start + i] = cv::Point3d(X, Y, Z);
+				reprojection_errors[start + i] = is_valid ? sqrt(dx * dx + dy * dy) : 0.0;
+				valid[start + i] = is_valid;
+			}
+		}
+	}
+
+	bool triangulate_views(const cv::Vec2d* x, const cv::Matx34d* poses, unsigned int n, cv::Vec3d* point) {
+		std::vector<double> weights(n, 1.0);
+
+		double X, Y, Z;
+		bool valid = solve_views(x, poses, &weights[0], n, &X, &Y, &Z);
+
+		for (unsigned int iteration = 0; valid && iteration < TRIANGULATION_MAX_ITERATIONS; iteration++) {
+			bool converged = true;
+
+			// Weight every camera with the depth of the point.
+			for (unsigned int i = 0; i < n; i++) {
+				const cv::Matx34d& p = poses[i];
+				double weight = p(2,0) * X + p(2,1) * Y + p(2,2) * Z + p(2,3);
+
+				// The point must stay in front of all cameras, which also keeps the weights from vanishing.
+				valid = valid && (weight > BOXES_EPSILON);
+
+				converged = converged && (fabs(weights[i] - weight) <= TRIANGULATION_EPSILON);
+				weights[i] = weight;
+			}
+
+			if (converged || !valid)
+				break;
+
+			valid = solve_views(x, poses, &weights[0], n, &X, &Y, &Z);
+		}
+
+		*point = cv::Vec3d(X, Y, Z);
+
+		if (!valid)
+			return false;
+
+		// The point must be in front of all cameras.
+		for (unsigned int i = 0; i < n; i++) {
+			const cv::Matx34d& p = poses[i];
+
+			if (p(2,0) * X + p(2,1) * Y + p(2,2) * Z + p(2,3) <= BOXES_EPSILON)
+				return false;
+		}
+
+		return true;
+	}
+
+	void count_points_in_front(const cv::Vec2d* x1, const cv::Vec2d* x2, unsigned int n,
+			const cv::Matx34d* candidates, unsigned int candidate_count, unsigned int* counts) {
+		const cv::Matx34d p1 = cv::Matx34d::eye();
+
+		for (unsigned int c = 0; c < candidate_count; c++)
+			counts[c] = 0;
+
+		TriangulationBatch batch;
+
+		for (unsigned int start = 0; start < n; start += TRIANGULATION_BATCH_SIZE) {
+			unsigned int size = n - start;
+			if (size > TRIANGULATION_BATCH_SIZE)
+				size = TRIANGULATION_BATCH_SIZE;
+
+			for (unsigned int i = 0; i < TRIANGULATION_BATCH_SIZE; i++) {
+				unsigned int j = start + ((i < size) ? i : size - 1);
+
+				batch.x1[i] = x1[j][0];
+				batch.y1[i] = x1[j][1];
+				batch.x2[i] = x2[j][0];
+				batch.y2[i] = x2[j][1];
+			}
+
+			for (unsigned int c = 0; c < candidate_count; c++) {
+				const cv::Matx34d& p2 = candidates[c];
+				unsigned int in_front = 0;
+
+				// Only the sign of the depths is needed, so the linear solution is enough.
+				for (unsigned int i = 0; i < TRIANGULATION_BATCH_SIZE; i++) {
+					double X, Y, Z;
+					bool valid = solve(batch.x1[i], batch.y1[i], 1.0, p1, batch.x2[i], batch.y2[i], 1.0, p2, &X, &Y, &Z);
+
+					double depth2 = p2(2,0) * X + p2(2,1) * Y + p2(2,2) * Z + p2(2,3);
+
+					in_front += (i < size && valid && Z > 0.0 && depth2 > 0.0) ? 1 : 0;
+				}
+
+				counts[c] += in_front;
+			}
+		}
+	}
+}
@@ -20,8 +20,10 @@
 #include <getopt.h>
 #include <iostream>
 #include <stdio.h>
+#include <stdexcept>
 #include <stdlib.h>
 #include <string>
+#include <vector>
 
 #include <boxes.h>
 
@@ -56,11 +58,13 @@ int main(int argc, char **argv) {
 			{"disparity-maps",        required_argument,  0, 'D'},
 			{"environment",           required_argument,  0, 'E'},
 			{"environment-file",      required_argument,  0, 'e'},
+			{"threads",               required_argument,  0, 'j'},
 			{"matches",               required_argument,  0, 'm'},
 			{"nurbs",                 required_argument,  0, 'n'},
-			{"optical-flow",          no_argument,        0, 'O'},
+			{"optical-flow",          optional_argument,  0, 'O'},
 			{"point-cloud",           no_argument,        0, 'p'},
 			{"resolution",            required_argument,  0, 'r'},
+			{"track",                 no_argument,        0, 'T'},
 			{"transparent",           no_argument,        0, 't'},
 			{"version",               no_argument,        0, 'V'},
 			{"visualize",             no_argument,        0, 'v'},
@@ -68,7 +72,7 @@ int main(int argc, char **argv) {
 		};
 		int option_index = 0;
 
-		int c = getopt_long(argc, argv, "a:Cc:D:d:E:e:m:n:Op:r:tVv", long_options, &option_index);
+		int c = getopt_long(argc, argv, "a:Cc:D:d:E:e:j:m:n:O::p:r:TtVv", long_options, &option_index);
 
 		if (c == -1)
 			break;
@@ -105,11 +109,30 @@ int main(int argc, char **argv) {
 				break;
 
 			case 'E':
-				boxes.config->parse_line(optarg);
+				try {
+					boxes.config->parse_line(optarg);
+				} catch (std::runtime_error& e) {
+					std::cerr << "Invalid configuration: " << e.what() << std::endl;
+					exit(2);
+				}
 				break;
 
 			case 'e':
-				boxes.config->read(optarg);
+				try {
+					boxes.config->read(optarg);
+				} catch (std::runtime_error& e) {
+					std::cerr << "Invalid configuration: " << e.what() << std::endl;
+					exit(2);
+				}
+				break;
+
+			case 'j':
+				try {
+					boxes.config->set("THREADS", optarg);
+				} catch (std::runtime_error& e) {
+					std::cerr << "Invalid configuration: " << e.what() << std::endl;
+					exit(2);
+				}
 				break;
 
 			case 'm':
@@ -121,6 +144,10 @@ int main(int argc, char **argv) {
 
 			case 'O':
 				use_optical_flow = true;
+
+				// Optionally choose the engine, e.g. -OPATCH or --optical-flow=LK.
+				if (optarg)
+					boxes.config->set("OPTICAL_FLOW_ENGINE", optarg);
 				break;
 
 			case 'p':
@@ -131,6 +158,10 @@ int main(int argc, char **argv) {
 				resolution.assign(optarg);
 				break;
 
+			case 'T':
+				boxes.config->set("SEQUENCE_TRACKING", "true");
+				break;
+
 			case 't':
 				visualize_transparent = true;
 				break;
@@ -157,6 +188,14 @@ int main(int argc, char **argv) {
 	// Dump the configuration.
 	boxes.config->dump();
 
+	// Check the configuration before doing any work.
+	try {
+		boxes.compile_settings();
+	} catch (std::runtime_error& e) {
+		std::cerr << "Invalid configuration: " << e.what() << std::endl;
+		exit(2);
+	}
+
 	while (optind < argc) {
 		std::string filename = argv[optind++];
 
@@ -179,6 +218,14 @@ int main(int argc, char **argv) {
 
 	multi_camera.run(use_optical_flow);
 
+	const std::vector<Boxes::BundleAdjustmentResult>* results = multi_camera.get_bundle_adjustment_results();
+	for (std::vector<Boxes::BundleAdjustmentResult>::const_iterator i = results->begin(); i != results->end(); i++) {
+		std::cout << "Bundle adjustment: " << i->cameras << " cameras, " << i->points << " points, "
+			<< i->iterations << " iterations" << (i->converged ? "" : " (not converged)") << ", "
+			<< "reprojection error " << i->initial_error << " -> " << i->final_error << " px, "
+			<< i->seconds << " s" << std::endl;
+	}
+
 	if (!output_matches.empty()) {
 		std::cout << "Writing matches..." << std::endl;
 		multi_camera.write_matches_all(&output_matches);
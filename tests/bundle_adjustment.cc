@@ -0,0 +1,136 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <assert.h>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <stdlib.h>
+#include <vector>
+
+#include <boxes/bundle_adjustment.h>
+#include <boxes/scheduler.h>
+#include "tests.h"
+
+int main() {
+	TEST_INIT
+
+	Boxes::Scheduler scheduler(4);
+	cv::RNG rng(1);
+
+	cv::Matx33d camera(
+		800.0,   0.0, 320.0,
+		  0.0, 800.0, 240.0,
+		  0.0,   0.0,   1.0
+	);
+
+	// Cameras on a line that all look at the same points.
+	unsigned int camera_count = 6;
+	std::vector<cv::Matx34d> poses;
+
+	for (unsigned int c = 0; c < camera_count; c++) {
+		cv::Matx33d R;
+		cv::Rodrigues(cv::Vec3d(0.0, -0.05 * c, 0.0), R);
+
+		cv::Vec3d t = R * cv::Vec3d(-0.3 * c, 0.0, 0.0);
+
+		poses.push_back(cv::Matx34d(
+			R(0,0), R(0,1), R(0,2), t[0],
+			R(1,0), R(1,1), R(1,2), t[1],
+			R(2,0), R(2,1), R(2,2), t[2]
+		));
+	}
+
+	unsigned int point_count = 300;
+	std::vector<cv::Vec3d> points;
+
+	for (unsigned int p = 0; p < point_count; p++)
+		points.push_back(cv::Vec3d(rng.uniform(-1.0, 2.5), rng.uniform(-1.0, 1.0), rng.uniform(4.0, 8.0)));
+
+	// All cameras but the first one and all points start with an error.
+	Boxes::BundleAdjuster adjuster(50, &scheduler);
+
+	for (unsigned int c = 0; c < camera_count; c++) {
+		cv::Matx34d pose = poses[c];
+
+		if (c > 0) {
+			cv::Matx33d R;
+			cv::Rodrigues(cv::Vec3d(rng.gaussian(0.01), rng.gaussian(0.01), rng.gaussian(0.01)), R);
+
+			cv::Matx34d noise(
+				R(0,0), R(0,1), R(0,2), rng.gaussian(0.02),
+				R(1,0), R(1,1), R(1,2), rng.gaussian(0.02),
+				R(2,0), R(2,1), R(2,2), rng.gaussian(0.02)
+			);
+			pose = noise * cv::Matx44d(
+				pose(0,0), pose(0,1), pose(0,2), pose(0,3),
+				pose(1,0), pose(1,1), pose(1,2), pose(1,3),
+				pose(2,0), pose(2,1), pose(2,2), pose(2,3),
+				0.0,       0.0,       0.0,       1.0
+			);
+		}
+
+		adjuster.add_camera(&pose, &camera, c == 0);
+	}
+
+	for (unsigned int p = 0; p < point_count; p++) {
+		cv::Point3d point(points[p][0] + rng.gaussian(0.05), points[p][1] + rng.gaussian(0.05), points[p][2] + rng.gaussian(0.05));
+		adjuster.add_point(&point);
+	}
+
+	for (unsigned int c = 0; c < camera_count; c++) {
+		for (unsigned int p = 0; p < point_count; p++) {
+			cv::Vec3d X = poses[c] * cv::Vec4d(points[p][0], points[p][1], points[p][2], 1.0);
+			cv::Vec3d x = camera * X;
+
+			cv::Point2f pt(x[0] / x[2] + rng.gaussian(0.5), x[1] / x[2] + rng.gaussian(0.5));
+
+			// Some observations are wrong.
+			if (rng.uniform(0, 50) == 0)
+				pt = cv::Point2f(rng.uniform(0.0, 640.0), rng.uniform(0.0, 480.0));
+
+			adjuster.add_observation(c, p, &pt);
+		}
+	}
+
+	Boxes::BundleAdjustmentResult result = adjuster.run();
+
+	assert(result.cameras == camera_count);
+	assert(result.points == point_count);
+	assert(result.observations == camera_count * point_count);
+	assert(result.converged);
+	assert(result.iterations > 0 && result.iterations < 50);
+	assert(result.final_error < result.initial_error);
+
+	// The first camera does not move.
+	cv::Matx34d first = adjuster.get_pose(0);
+	for (unsigned int i = 0; i < 12; i++)
+		assert(fabs(first.val[i] - poses[0].val[i]) < 1e-12);
+
+	// All points are close to the truth again.
+	double error = 0.0;
+	for (unsigned int p = 0; p < point_count; p++) {
+		cv::Point3d point = adjuster.get_point(p);
+
+		error += sqrt(pow(point.x - points[p][0], 2) + pow(point.y - points[p][1], 2) + pow(point.z - points[p][2], 2));
+	}
+
+	assert(error / point_count < 0.05);
+
+	exit(0);
+}
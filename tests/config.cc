@@ -0,0 +1,83 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <math.h>
+#include <stdexcept>
+#include <string>
+
+#include <boxes.h>
+#include "tests.h"
+
+static bool parse_fails(Boxes::Boxes* boxes, const std::string line) {
+	try {
+		boxes->config->parse_line(line);
+	} catch (std::runtime_error& e) {
+		std::cout << "Rejected '" << line << "': " << e.what() << std::endl;
+		return true;
+	}
+
+	return false;
+}
+
+int main() {
+	TEST_INIT
+
+	Boxes::Boxes boxes;
+
+	// Set a valid value and check if it ends up in the settings...
+	boxes.config->parse_line("MATCH_VALID_RATIO = 0.7");
+
+	const Boxes::Settings& settings = boxes.compile_settings();
+	assert(fabs(settings.match_valid_ratio - 0.7) < 1e-9);
+
+	// Unknown keys and malformed values must be rejected right away...
+	assert(parse_fails(&boxes, "NO_SUCH_KEY = 1"));
+	assert(parse_fails(&boxes, "MATCH_VALID_RATIO = abc"));
+	assert(parse_fails(&boxes, "SURF_MIN_HESSIAN = 1.5"));
+	assert(parse_fails(&boxes, "MATCH_VALID_RATIO"));
+
+	// ...and must not have changed anything.
+	assert(boxes.config->get("MATCH_VALID_RATIO") == "0.7");
+
+	// Out of range values are found when compiling...
+	boxes.config->parse_line("MATCH_VALID_RATIO = 2.0");
+
+	bool failed = false;
+	try {
+		boxes.compile_settings();
+	} catch (std::runtime_error& e) {
+		failed = true;
+	}
+	assert(failed);
+
+	// ...including values that only conflict with each other.
+	boxes.config->parse_line("MATCH_VALID_RATIO = 0.7");
+	boxes.config->parse_line("TRACKING_MAX_FEATURES = 500");
+	boxes.config->parse_line("TRACKING_MIN_FEATURES = 1000");
+
+	failed = false;
+	try {
+		boxes.compile_settings();
+	} catch (std::runtime_error& e) {
+		failed = true;
+	}
+	assert(failed);
+
+	exit(0);
+}
@@ -0,0 +1,158 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <assert.h>
+#include <iostream>
+#include <math.h>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+#include <boxes.h>
+#include <boxes/feature_tracker.h>
+#include <boxes/image.h>
+#include "tests.h"
+
+// Textured blobs with plenty of corners, seen from (dx, dy).
+static cv::Mat make_image(int rows, int cols, float dx, float dy, float frequency = 1.0) {
+	cv::Mat image(rows, cols, CV_8U);
+
+	for (int y = 0; y < rows; y++) {
+		for (int x = 0; x < cols; x++) {
+			float u = (x - dx) * frequency;
+			float v = (y - dy) * frequency;
+
+			image.at<uchar>(y, x) = cvRound(128.0 + 60.0 * sin(u * 0.23) * cos(v * 0.19)
+				+ 30.0 * sin((u - v) * 0.07) + 20.0 * cos((u + v) * 0.13));
+		}
+	}
+
+	return image;
+}
+
+static float distance(const cv::Point2f& a, const cv::Point2f& b) {
+	cv::Point2f d = a - b;
+
+	return sqrt(d.x * d.x + d.y * d.y);
+}
+
+int main() {
+	TEST_INIT
+
+	Boxes::Boxes boxes;
+
+	// Every image moves by the same amount.
+	float dx = 2.5, dy = 1.5;
+	int rows = 240, cols = 320;
+
+	std::vector<std::unique_ptr<Boxes::Image>> images;
+	for (int i = 0; i < 4; i++)
+		images.emplace_back(new Boxes::Image(&boxes, make_image(rows, cols, i * dx, i * dy)));
+
+	// Enough tracks survive, so there is no need to look for new ones.
+	boxes.config->set("TRACKING_MAX_FEATURES", "400");
+	boxes.config->set("TRACKING_MIN_FEATURES", "1");
+	boxes.compile_settings();
+
+	{
+		Boxes::FeatureTracker tracker(&boxes);
+		const std::vector<Boxes::FeatureTrack>* tracks = tracker.get_tracks();
+
+		tracker.start(images[0].get());
+
+		unsigned int detected = tracks->size();
+		assert(detected > 50);
+		assert(tracker.live_size() == detected);
+
+		std::vector<Boxes::MatchPoint> match_points;
+
+		for (unsigned int i = 1; i < images.size(); i++) {
+			tracker.track(images[i].get(), &match_points);
+
+			assert(match_points.size() == tracker.live_size());
+			assert(tracks->size() == detected);
+
+			// The tracks follow the known shift.
+			for (std::vector<Boxes::MatchPoint>::const_iterator mp = match_points.begin(); mp != match_points.end(); ++mp)
+				assert(distance(mp->pt2 - mp->pt1, cv::Point2f(dx, dy)) < 0.2);
+		}
+
+		// Only the features that left the image got lost.
+		std::cout << "Live tracks: " << tracker.live_size() << " of " << detected << std::endl;
+		assert(tracker.live_size() > detected / 2);
+
+		// Tracks link the same feature through all images.
+		unsigned int complete = 0;
+
+		for (std::vector<Boxes::FeatureTrack>::const_iterator t = tracks->begin(); t != tracks->end(); ++t) {
+			assert(t->first == 0);
+
+			if (t->points.size() != images.size())
+				continue;
+
+			for (unsigned int i = 1; i < t->points.size(); i++)
+				assert(distance(t->points[i] - t->points[0], cv::Point2f(i * dx, i * dy)) < 0.5);
+
+			complete++;
+		}
+
+		assert(complete == tracker.live_size());
+	}
+
+	// Every lost track has to be replaced.
+	boxes.config->set("TRACKING_MIN_FEATURES", "400");
+	boxes.compile_settings();
+
+	{
+		Boxes::FeatureTracker tracker(&boxes);
+		const std::vector<Boxes::FeatureTrack>* tracks = tracker.get_tracks();
+
+		tracker.start(images[0].get());
+
+		// The right half turns into something else, which loses all tracks there.
+		cv::Mat mat = make_image(rows, cols, dx, dy);
+		make_image(rows, cols, dx, dy, 1.7).colRange(cols / 2, cols).copyTo(mat.colRange(cols / 2, cols));
+
+		Boxes::Image image(&boxes, mat);
+
+		unsigned int detected = tracks->size();
+
+		std::vector<Boxes::MatchPoint> match_points;
+		tracker.track(&image, &match_points);
+
+		assert(match_points.size() < detected);
+		assert(tracks->size() > detected);
+		assert(tracker.live_size() == match_points.size() + tracks->size() - detected);
+
+		// New tracks start in this image, away from all tracks that are still alive.
+		for (unsigned int i = detected; i < tracks->size(); i++) {
+			const Boxes::FeatureTrack* track = &tracks->at(i);
+
+			assert(track->first == 1);
+			assert(track->points.size() == 1);
+
+			for (std::vector<Boxes::MatchPoint>::const_iterator mp = match_points.begin(); mp != match_points.end(); ++mp)
+				assert(distance(track->points[0], mp->pt2) >= 7.0);
+		}
+	}
+
+	exit(0);
+}
@@ -0,0 +1,123 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <stdlib.h>
+#include <vector>
+
+#include <boxes/config.h>
+#include <boxes/five_point.h>
+#include <boxes/ransac.h>
+#include <boxes/ransac_estimators.h>
+#include <boxes/scheduler.h>
+#include "tests.h"
+
+// A random essential matrix and five correspondences that fit it.
+static cv::Matx33d random_pose(cv::RNG* rng, cv::Matx33d* R, cv::Vec3d* t) {
+	cv::Vec3d rotation(rng->uniform(-0.3, 0.3), rng->uniform(-0.3, 0.3), rng->uniform(-0.3, 0.3));
+	cv::Rodrigues(rotation, *R);
+
+	*t = cv::normalize(cv::Vec3d(rng->uniform(-1.0, 1.0), rng->uniform(-1.0, 1.0), rng->uniform(-1.0, 1.0)));
+
+	cv::Matx33d tx(0, -(*t)[2], (*t)[1], (*t)[2], 0, -(*t)[0], -(*t)[1], (*t)[0], 0);
+	cv::Matx33d E = tx * (*R);
+
+	return E * (1.0 / cv::norm(E));
+}
+
+static void project(cv::RNG* rng, const cv::Matx33d& R, const cv::Vec3d& t, cv::Vec2d* x1, cv::Vec2d* x2) {
+	cv::Vec3d X(rng->uniform(-2.0, 2.0), rng->uniform(-2.0, 2.0), rng->uniform(4.0, 10.0));
+	cv::Vec3d Y = R * X + t;
+
+	*x1 = cv::Vec2d(X[0] / X[2], X[1] / X[2]);
+	*x2 = cv::Vec2d(Y[0] / Y[2], Y[1] / Y[2]);
+}
+
+int main() {
+	TEST_INIT
+
+	Boxes::Scheduler scheduler(4);
+	cv::RNG rng(1);
+
+	// One of the solutions must be the true essential matrix (up to its sign).
+	for (unsigned int trial = 0; trial < 500; trial++) {
+		cv::Matx33d R;
+		cv::Vec3d t;
+		cv::Matx33d E = random_pose(&rng, &R, &t);
+
+		cv::Vec2d x1[FIVE_POINT_SAMPLE_SIZE], x2[FIVE_POINT_SAMPLE_SIZE];
+		for (unsigned int i = 0; i < FIVE_POINT_SAMPLE_SIZE; i++)
+			project(&rng, R, t, &x1[i], &x2[i]);
+
+		cv::Matx33d solutions[FIVE_POINT_MAX_SOLUTIONS];
+		unsigned int count = Boxes::five_point_solve(x1, x2, solutions);
+		assert(count > 0 && count <= FIVE_POINT_MAX_SOLUTIONS);
+
+		double best = DBL_MAX;
+		for (unsigned int s = 0; s < count; s++)
+			best = std::min(best, std::min(cv::norm(solutions[s] - E), cv::norm(solutions[s] + E)));
+
+		assert(best < 1e-6);
+	}
+
+	// RANSAC must keep all inliers when half of the correspondences are wrong.
+	cv::Matx33d R;
+	cv::Vec3d t;
+	random_pose(&rng, &R, &t);
+
+	unsigned int n = 1000;
+	std::vector<cv::Point2f> points1(n), points2(n);
+
+	for (unsigned int i = 0; i < n; i++) {
+		cv::Vec2d x1, x2;
+		project(&rng, R, t, &x1, &x2);
+
+		if (i % 2)
+			x2 = cv::Vec2d(rng.uniform(-0.5, 0.5), rng.uniform(-0.5, 0.5));
+
+		points1[i] = cv::Point2f(x1[0], x1[1]);
+		points2[i] = cv::Point2f(x2[0], x2[1]);
+	}
+
+	Boxes::Settings settings;
+	settings.ransac_confidence = 0.99;
+	settings.ransac_max_iterations = 1000;
+	settings.ransac_sprt = true;
+	settings.ransac_local_optimization = true;
+
+	// The points are already normalized, so there are no camera matrices.
+	Boxes::EssentialEstimator estimator(&points1, &points2, NULL, NULL);
+	Boxes::Ransac ransac(&estimator, Boxes::RansacParameters(settings, 1e-3), &scheduler);
+
+	Boxes::RansacModel model;
+	std::vector<uchar> mask;
+	Boxes::RansacResult result = ransac.run(&model, &mask);
+
+	assert(result.inliers >= n / 2);
+	assert(result.iterations > 0 && result.iterations < 1000);
+
+	for (unsigned int i = 0; i < n; i += 2)
+		assert(mask[i]);
+
+	exit(0);
+}
@@ -0,0 +1,129 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <assert.h>
+#include <iostream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+#include <boxes/hamming.h>
+#include "tests.h"
+
+static uint32_t naive_distance(const uint8_t* a, const uint8_t* b, unsigned int bytes) {
+	uint32_t distance = 0;
+
+	for (unsigned int i = 0; i < bytes; i++)
+		for (unsigned int bit = 0; bit < 8; bit++)
+			distance += ((a[i] ^ b[i]) >> bit) & 1;
+
+	return distance;
+}
+
+static void random_descriptors(std::vector<uint8_t>* descriptors) {
+	for (unsigned int i = 0; i < descriptors->size(); i++)
+		descriptors->at(i) = rand();
+}
+
+// Compares the result for one row of a with a naive search over all rows of b.
+static void check_neighbours(const Boxes::HammingNeighbours* n, const uint8_t* a,
+		const std::vector<uint8_t>* b, unsigned int rows, unsigned int bytes) {
+	uint32_t best = UINT32_MAX;
+	uint32_t second = UINT32_MAX;
+
+	for (unsigned int t = 0; t < rows; t++) {
+		uint32_t distance = naive_distance(a, &b->at(t * bytes), bytes);
+
+		if (distance < best) {
+			second = best;
+			best = distance;
+		} else if (distance < second) {
+			second = distance;
+		}
+	}
+
+	// Ties may be resolved differently, so only the distances are compared.
+	assert(n->best == best);
+	assert(n->second == second);
+	assert(naive_distance(a, &b->at(n->idx * bytes), bytes) == best);
+
+	if (rows > 1)
+		assert(naive_distance(a, &b->at(n->second_idx * bytes), bytes) == second);
+}
+
+static void check(unsigned int query_rows, unsigned int train_rows, unsigned int bytes) {
+	std::vector<uint8_t> query(query_rows * bytes);
+	std::vector<uint8_t> train(train_rows * bytes);
+
+	random_descriptors(&query);
+	random_descriptors(&train);
+
+	std::vector<Boxes::HammingNeighbours> result;
+	Boxes::hamming_knn2(&query[0], query_rows, bytes, &train[0], train_rows, bytes, bytes, &result);
+
+	assert(result.size() == query_rows);
+
+	for (unsigned int q = 0; q < query_rows; q++)
+		check_neighbours(&result[q], &query[q * bytes], &train, train_rows, bytes);
+
+	// The symmetric search must give the same results in both directions.
+	std::vector<Boxes::HammingNeighbours> query_result;
+	std::vector<Boxes::HammingNeighbours> train_result;
+	Boxes::hamming_knn2_symmetric(&query[0], query_rows, bytes, &train[0], train_rows, bytes, bytes,
+		&query_result, &train_result);
+
+	assert(query_result.size() == query_rows);
+	assert(train_result.size() == train_rows);
+
+	for (unsigned int q = 0; q < query_rows; q++)
+		check_neighbours(&query_result[q], &query[q * bytes], &train, train_rows, bytes);
+
+	for (unsigned int t = 0; t < train_rows; t++)
+		check_neighbours(&train_result[t], &train[t * bytes], &query, query_rows, bytes);
+}
+
+int main() {
+	TEST_INIT
+
+	std::cout << "Using the " << Boxes::hamming_implementation() << " implementation" << std::endl;
+
+	// ORB, BRISK and odd descriptor sizes, across tile boundaries.
+	check(100, 1000, 32);
+	check(70, 600, 64);
+	check(65, 513, 61);
+	check(10, 1, 16);
+
+	// The ratio test...
+	Boxes::HammingNeighbours n;
+	assert(!Boxes::hamming_ratio_test(&n, Boxes::hamming_ratio(0.8)));
+
+	n.idx = 0;
+	n.best = 40;
+	assert(Boxes::hamming_ratio_test(&n, Boxes::hamming_ratio(0.8)));
+
+	n.second_idx = 1;
+	n.second = 50;
+	assert(Boxes::hamming_ratio_test(&n, Boxes::hamming_ratio(0.8)));
+
+	n.second = 49;
+	assert(!Boxes::hamming_ratio_test(&n, Boxes::hamming_ratio(0.8)));
+
+	exit(0);
+}
@@ -0,0 +1,106 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <assert.h>
+#include <iostream>
+#include <math.h>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <stdexcept>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+#include <boxes/config.h>
+#include <boxes/optical_flow.h>
+#include <boxes/scheduler.h>
+#include "tests.h"
+
+// Smooth texture, seen from (dx, dy).
+static cv::Mat make_image(int rows, int cols, float dx, float dy) {
+	cv::Mat image(rows, cols, CV_8U);
+
+	for (int y = 0; y < rows; y++) {
+		for (int x = 0; x < cols; x++) {
+			float u = x - dx;
+			float v = y - dy;
+
+			image.at<uchar>(y, x) = cvRound(128.0 + 50.0 * sin(u * 0.21 + v * 0.05)
+				+ 40.0 * cos(v * 0.17 - u * 0.03) + 20.0 * sin((u + v) * 0.11));
+		}
+	}
+
+	return image;
+}
+
+int main() {
+	TEST_INIT
+
+	Boxes::Scheduler scheduler(4);
+	Boxes::Config config;
+
+	config.set("OPTICAL_FLOW_ENGINE", "PATCH");
+	Boxes::Settings settings = config.compile();
+
+	std::unique_ptr<Boxes::OpticalFlow> optical_flow(Boxes::OpticalFlow::create(settings, &scheduler));
+	assert(optical_flow->is_dense());
+
+	// Everything moves by the same amount.
+	float dx = 5.5, dy = -3.25;
+
+	cv::Mat image1 = make_image(120, 160, 0.0, 0.0);
+	cv::Mat image2 = make_image(120, 160, dx, dy);
+
+	std::unique_ptr<std::vector<cv::Mat>> pyramid1(optical_flow->build_pyramid(&image1));
+	std::unique_ptr<std::vector<cv::Mat>> pyramid2(optical_flow->build_pyramid(&image2));
+
+	cv::Mat flow;
+	optical_flow->calculate(pyramid1.get(), pyramid2.get(), &flow);
+
+	assert(flow.rows == image1.rows && flow.cols == image1.cols);
+
+	// Away from the border, the flow is found to a fraction of a pixel.
+	double error = 0.0;
+	unsigned int count = 0;
+
+	for (int y = 16; y < flow.rows - 16; y++) {
+		for (int x = 16; x < flow.cols - 16; x++) {
+			cv::Point2f f = flow.at<cv::Point2f>(y, x);
+
+			error += sqrt((f.x - dx) * (f.x - dx) + (f.y - dy) * (f.y - dy));
+			count++;
+		}
+	}
+
+	std::cout << "Mean error: " << error / count << std::endl;
+	assert(error / count < 0.1);
+
+	// Unknown engines are rejected.
+	config.set("OPTICAL_FLOW_ENGINE", "NONE");
+
+	bool failed = false;
+	try {
+		config.compile();
+	} catch (std::runtime_error& e) {
+		failed = true;
+	}
+	assert(failed);
+
+	exit(0);
+}
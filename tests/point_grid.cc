@@ -0,0 +1,108 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <boxes/point_grid.h>
+#include "tests.h"
+
+int main() {
+	TEST_INIT
+
+	std::vector<cv::Point2f> points;
+	for (unsigned int i = 0; i < 2000; i++)
+		points.push_back(cv::Point2f(rand() % 1600, rand() % 1200));
+
+	Boxes::PointGrid grid(&points);
+	assert(grid.size() == points.size());
+
+	std::vector<int> result;
+
+	// Compare the line queries with checking every single point...
+	for (unsigned int l = 0; l < 200; l++) {
+		double a = rand() / (double)RAND_MAX - 0.5;
+		double b = rand() / (double)RAND_MAX - 0.5;
+		double c = -(a * (rand() % 1600) + b * (rand() % 1200));
+		double distance = 2.0;
+
+		grid.query_line(cv::Vec3d(a, b, c), distance, &result);
+		std::sort(result.begin(), result.end());
+
+		std::vector<int> expected;
+		for (unsigned int i = 0; i < points.size(); i++) {
+			if (fabs(a * points[i].x + b * points[i].y + c) / sqrt(a * a + b * b) <= distance)
+				expected.push_back(i);
+		}
+
+		assert(result == expected);
+	}
+
+	// ...and the radius queries, too.
+	std::vector<cv::DMatch> nearest;
+
+	for (unsigned int q = 0; q < 200; q++) {
+		cv::Point2f center(rand() % 1800 - 100, rand() % 1400 - 100);
+		float radius = rand() % 60;
+
+		grid.query_radius(center, radius, &result);
+		std::sort(result.begin(), result.end());
+
+		std::vector<int> expected;
+		std::vector<float> distances;
+
+		for (unsigned int i = 0; i < points.size(); i++) {
+			float dx = points[i].x - center.x;
+			float dy = points[i].y - center.y;
+
+			if (dx * dx + dy * dy <= radius * radius) {
+				expected.push_back(i);
+				distances.push_back(sqrtf(dx * dx + dy * dy));
+			}
+		}
+
+		assert(result == expected);
+
+		// The nearest points are the closest ones of the same set.
+		grid.query_nearest(center, radius, 2, &nearest);
+		assert(nearest.size() == std::min<size_t>(expected.size(), 2));
+
+		std::sort(distances.begin(), distances.end());
+
+		for (unsigned int i = 0; i < nearest.size(); i++) {
+			assert(std::find(expected.begin(), expected.end(), nearest[i].trainIdx) != expected.end());
+			assert(fabs(nearest[i].distance - distances[i]) < 1e-3);
+		}
+	}
+
+	// An empty grid must not find anything.
+	std::vector<cv::Point2f> empty;
+	Boxes::PointGrid empty_grid(&empty);
+
+	empty_grid.query_line(cv::Vec3d(1.0, 1.0, 0.0), 1.0, &result);
+	assert(result.empty());
+
+	empty_grid.query_radius(cv::Point2f(0.0, 0.0), 10.0, &result);
+	assert(result.empty());
+
+	exit(0);
+}
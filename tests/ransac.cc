@@ -0,0 +1,220 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <stdlib.h>
+#include <vector>
+
+#include <boxes/config.h>
+#include <boxes/ransac.h>
+#include <boxes/ransac_estimators.h>
+#include <boxes/scheduler.h>
+#include "tests.h"
+
+static Boxes::RansacResult estimate(const Boxes::RansacEstimator* estimator, const Boxes::Settings& settings,
+		Boxes::Scheduler* scheduler, double threshold, const std::vector<unsigned int>* order, Boxes::RansacModel* model,
+		std::vector<uchar>* mask) {
+	Boxes::Ransac ransac(estimator, Boxes::RansacParameters(settings, threshold), scheduler);
+
+	return ransac.run(model, mask, order);
+}
+
+int main() {
+	TEST_INIT
+
+	Boxes::Scheduler scheduler(4);
+	cv::RNG rng(1);
+
+	// A homography between two images, every third correspondence is wrong.
+	cv::Matx33d H(
+		1.1,   0.05, 20.0,
+		-0.03, 0.95, -10.0,
+		1e-4,  2e-4,  1.0
+	);
+
+	unsigned int n = 600;
+	std::vector<cv::Point2f> points1(n), points2(n);
+	std::vector<float> distances(n);
+
+	for (unsigned int i = 0; i < n; i++) {
+		cv::Vec3d x(rng.uniform(0.0, 640.0), rng.uniform(0.0, 480.0), 1.0);
+		cv::Vec3d y = H * x;
+
+		points1[i] = cv::Point2f(x[0], x[1]);
+		points2[i] = cv::Point2f(y[0] / y[2] + rng.gaussian(0.2), y[1] / y[2] + rng.gaussian(0.2));
+		distances[i] = rng.uniform(0.0, 1.0);
+
+		if (i % 3 == 0) {
+			points2[i] = cv::Point2f(rng.uniform(0.0, 640.0), rng.uniform(0.0, 480.0));
+			distances[i] += 0.5;
+		}
+	}
+
+	Boxes::Settings settings;
+	settings.ransac_confidence = 0.99;
+	settings.ransac_max_iterations = 1000;
+	settings.ransac_prosac = true;
+	settings.ransac_sprt = true;
+	settings.ransac_local_optimization = true;
+
+	std::vector<unsigned int> order;
+	Boxes::ransac_order(&distances, &order);
+
+	for (unsigned int i = 1; i < n; i++)
+		assert(distances[order[i - 1]] <= distances[order[i]]);
+
+	Boxes::HomographyEstimator homography(&points1, &points2);
+
+	Boxes::RansacModel model;
+	std::vector<uchar> mask;
+	Boxes::RansacResult result = estimate(&homography, settings, &scheduler, 2.0, &order, &model, &mask);
+
+	assert(result.inliers >= 2 * n / 3 - 5);
+	assert(result.iterations < settings.ransac_max_iterations);
+
+	for (unsigned int i = 0; i < n; i++) {
+		if (mask[i])
+			assert(i % 3 != 0);
+	}
+
+	for (unsigned int i = 0; i < 9; i++)
+		assert(fabs(model.matrix.val[i] - H.val[i]) < 0.01 * (fabs(H.val[i]) + 1.0));
+
+	// The same seed must give the same result, on any number of threads.
+	Boxes::Scheduler single(1);
+
+	Boxes::RansacModel again;
+	std::vector<uchar> mask_again;
+	Boxes::RansacResult result_again = estimate(&homography, settings, &single, 2.0, &order, &again, &mask_again);
+
+	assert(result_again.iterations == result.iterations);
+	assert(result_again.inliers == result.inliers);
+	assert(mask_again == mask);
+
+	// Plain RANSAC finds the same inliers.
+	settings.ransac_prosac = false;
+	settings.ransac_sprt = false;
+	settings.ransac_local_optimization = false;
+
+	result = estimate(&homography, settings, &scheduler, 2.0, NULL, &model, &mask);
+	assert(result.inliers >= 2 * n / 3 - 10);
+	assert(result.rejected == 0);
+
+	// All correspondences of the homography fit an epipolar geometry as well.
+	settings.ransac_sprt = true;
+
+	Boxes::FundamentalEstimator fundamental(&points1, &points2);
+	result = estimate(&fundamental, settings, &scheduler, 2.0, NULL, &model, &mask);
+
+	assert(result.inliers >= 2 * n / 3 - 5);
+	assert(fabs(cv::determinant(model.matrix)) < 1e-6);
+
+	// The scoring kernels give the plain Sampson distance, also after the last full block of points.
+	std::vector<double> errors(13);
+	fundamental.errors(&model, 3, errors.size(), &errors[0]);
+
+	for (unsigned int i = 0; i < errors.size(); i++) {
+		cv::Vec3d x1(points1[i + 3].x, points1[i + 3].y, 1.0);
+		cv::Vec3d x2(points2[i + 3].x, points2[i + 3].y, 1.0);
+
+		cv::Vec3d Fx1 = model.matrix * x1;
+		cv::Vec3d Ftx2 = model.matrix.t() * x2;
+		double e = x2.dot(Fx1);
+
+		double sampson = e * e / (Fx1[0] * Fx1[0] + Fx1[1] * Fx1[1] + Ftx2[0] * Ftx2[0] + Ftx2[1] * Ftx2[1]);
+		assert(fabs(errors[i] - sampson) <= 1e-9 * (sampson + 1.0));
+	}
+
+	// A similarity between two point clouds, every fourth point is wrong.
+	cv::Matx33d R;
+	cv::Rodrigues(cv::Vec3d(0.1, -0.4, 0.2), R);
+
+	double scale = 2.5;
+	cv::Vec3d t(1.0, -2.0, 0.5);
+
+	std::vector<cv::Point3d> cloud1(n), cloud2(n);
+
+	for (unsigned int i = 0; i < n; i++) {
+		cv::Vec3d x(rng.uniform(-1.0, 1.0), rng.uniform(-1.0, 1.0), rng.uniform(3.0, 6.0));
+		cv::Vec3d y = R * x * scale + t;
+
+		cloud1[i] = cv::Point3d(x[0], x[1], x[2]);
+		cloud2[i] = cv::Point3d(y[0] + rng.gaussian(0.01), y[1] + rng.gaussian(0.01), y[2] + rng.gaussian(0.01));
+
+		if (i % 4 == 0)
+			cloud2[i] = cv::Point3d(rng.uniform(-3.0, 3.0), rng.uniform(-3.0, 3.0), rng.uniform(5.0, 15.0));
+	}
+
+	settings.ransac_local_optimization = true;
+
+	Boxes::SimilarityEstimator similarity(&cloud1, &cloud2);
+	result = estimate(&similarity, settings, &scheduler, 0.05, NULL, &model, &mask);
+
+	assert(result.inliers >= 3 * n / 4 - 5);
+
+	for (unsigned int i = 0; i < 9; i++)
+		assert(fabs(model.matrix.val[i] - scale * R.val[i]) < 0.01);
+
+	for (unsigned int i = 0; i < 3; i++)
+		assert(fabs(model.translation[i] - t[i]) < 0.05);
+
+	// Reprojection errors of a camera pose, every fifth point is behind the camera.
+	cv::Matx33d camera(
+		800.0,   0.0, 320.0,
+		  0.0, 800.0, 240.0,
+		  0.0,   0.0,   1.0
+	);
+
+	std::vector<cv::Point3f> object_points(13);
+	std::vector<cv::Point2f> image_points(13);
+
+	for (unsigned int i = 0; i < object_points.size(); i++) {
+		double z = (i % 5 == 0) ? -rng.uniform(1.0, 3.0) : rng.uniform(2.0, 6.0);
+
+		object_points[i] = cv::Point3f(rng.uniform(-1.0, 1.0), rng.uniform(-1.0, 1.0), z);
+		image_points[i] = cv::Point2f(rng.uniform(0.0, 640.0), rng.uniform(0.0, 480.0));
+	}
+
+	Boxes::PnPEstimator pnp(&object_points, &image_points, &camera);
+
+	model.matrix = R;
+	model.translation = cv::Vec3d(0.1, -0.2, 0.3);
+
+	pnp.errors(&model, 0, errors.size(), &errors[0]);
+
+	for (unsigned int i = 0; i < errors.size(); i++) {
+		cv::Vec3d X(object_points[i].x, object_points[i].y, object_points[i].z);
+		cv::Vec3d p = camera * (R * X + model.translation);
+
+		if (p[2] <= 0.0) {
+			assert(errors[i] >= DBL_MAX);
+			continue;
+		}
+
+		double dx = p[0] / p[2] - image_points[i].x;
+		double dy = p[1] / p[2] - image_points[i].y;
+
+		assert(fabs(errors[i] - (dx * dx + dy * dy)) <= 1e-9 * (dx * dx + dy * dy + 1.0));
+	}
+
+	exit(0);
+}
@@ -0,0 +1,93 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <assert.h>
+#include <atomic>
+#include <stdexcept>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+#include <boxes/scheduler.h>
+#include "tests.h"
+
+static void test_scheduler(unsigned int threads) {
+	Boxes::Scheduler scheduler(threads);
+	assert(scheduler.size() == threads);
+
+	// Every index is visited exactly once.
+	unsigned int n = 10000;
+	std::vector<unsigned int> visits(n, 0);
+
+	scheduler.parallel_for(0, n, 7, [&](unsigned int i) {
+		visits[i]++;
+	});
+
+	for (unsigned int i = 0; i < n; i++)
+		assert(visits[i] == 1);
+
+	// Tasks can wait for tasks of their own.
+	std::atomic<unsigned int> sum(0);
+
+	scheduler.parallel_for(0, 64, 1, [&](unsigned int i) {
+		scheduler.parallel_for(0, 100, 10, [&](unsigned int j) {
+			sum += j;
+		});
+	});
+
+	assert(sum == 64 * 4950);
+
+	// Tasks can start more tasks in the same group.
+	Boxes::TaskGroup group;
+	std::atomic<unsigned int> count(0);
+
+	for (unsigned int i = 0; i < 16; i++) {
+		scheduler.run(&group, [&]() {
+			for (unsigned int j = 0; j < 16; j++)
+				scheduler.run(&group, [&]() { count++; });
+		});
+	}
+
+	scheduler.wait(&group);
+	assert(count == 256);
+
+	// Exceptions are thrown by wait().
+	bool thrown = false;
+
+	try {
+		scheduler.parallel_for(0, 100, 1, [&](unsigned int i) {
+			if (i == 42)
+				throw std::runtime_error("42");
+		});
+	} catch (std::runtime_error& e) {
+		thrown = true;
+	}
+
+	assert(thrown);
+}
+
+int main() {
+	TEST_INIT
+
+	test_scheduler(1);
+	test_scheduler(2);
+	test_scheduler(8);
+
+	exit(0);
+}
@@ -0,0 +1,126 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <assert.h>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <stdlib.h>
+#include <vector>
+
+#include <boxes/structs.h>
+#include <boxes/scheduler.h>
+#include <boxes/tracks.h>
+#include "tests.h"
+
+int main() {
+	TEST_INIT
+
+	Boxes::Scheduler scheduler(4);
+	cv::RNG rng(1);
+
+	cv::Matx33d camera(
+		800.0,   0.0, 320.0,
+		  0.0, 800.0, 240.0,
+		  0.0,   0.0,   1.0
+	);
+
+	// Four cameras next to each other.
+	unsigned int image_count = 4;
+	std::vector<cv::Matx33d> cameras(image_count, camera);
+	std::vector<cv::Matx34d> poses;
+
+	for (unsigned int i = 0; i < image_count; i++)
+		poses.push_back(cv::Matx34d(
+			1.0, 0.0, 0.0, -0.5 * i,
+			0.0, 1.0, 0.0, 0.0,
+			0.0, 0.0, 1.0, 0.0
+		));
+
+	unsigned int point_count = 100;
+	std::vector<cv::Vec3d> points;
+	std::vector<std::vector<cv::Point2f> > projections(image_count);
+
+	for (unsigned int p = 0; p < point_count; p++) {
+		points.push_back(cv::Vec3d(rng.uniform(-1.0, 2.5), rng.uniform(-1.0, 1.0), rng.uniform(4.0, 8.0)));
+
+		for (unsigned int i = 0; i < image_count; i++) {
+			cv::Vec3d x = camera * (poses[i] * cv::Vec4d(points[p][0], points[p][1], points[p][2], 1.0));
+			projections[i].push_back(cv::Point2f(x[0] / x[2], x[1] / x[2]));
+		}
+	}
+
+	// Match neighbouring images, keypoint p is point p in every image.
+	Boxes::Tracks tracks;
+
+	for (unsigned int i = 0; i + 1 < image_count; i++) {
+		for (unsigned int p = 0; p < point_count; p++) {
+			if (i == 2 && p == 5)
+				continue;
+
+			tracks.add_match(i, p, &projections[i][p], i + 1, p, &projections[i + 1][p]);
+		}
+	}
+
+	// Optical flow matches are linked by their coordinates.
+	tracks.add_match(2, 5, &projections[2][5], 3, MATCH_NO_KEYPOINT, &projections[3][5]);
+
+	// Point 1 is matched to point 2 in the same image, which breaks both tracks.
+	tracks.add_match(0, 1, &projections[0][1], 1, 2, &projections[1][2]);
+
+	tracks.build();
+
+	assert(tracks.size() == point_count - 2);
+	assert(tracks.observation_count() == (point_count - 2) * image_count);
+
+	int track = tracks.find(0, 5, &projections[0][5]);
+	assert(track == 3);
+	assert(tracks.find(3, MATCH_NO_KEYPOINT, &projections[3][5]) == track);
+	assert(tracks.find(0, 1, &projections[0][1]) == -1);
+	assert(tracks.find(2, 3, &projections[2][3]) == 1);
+
+	for (unsigned int t = 0; t < tracks.size(); t++) {
+		for (unsigned int i = tracks.offsets[t] + 1; i < tracks.offsets[t + 1]; i++)
+			assert(tracks.images[i - 1] < tracks.images[i]);
+	}
+
+	tracks.triangulate(&cameras, &poses, &scheduler);
+
+	for (unsigned int t = 0; t < tracks.size(); t++) {
+		unsigned int p = tracks.keypoints[tracks.offsets[t]];
+
+		assert(tracks.valid[t]);
+		assert(tracks.reprojection_errors[t] < 0.01);
+
+		assert(fabs(tracks.points[t].x - points[p][0]) < 1e-3);
+		assert(fabs(tracks.points[t].y - points[p][1]) < 1e-3);
+		assert(fabs(tracks.points[t].z - points[p][2]) < 1e-3);
+	}
+
+	// Moved points are reprojected, points behind the cameras become invalid.
+	tracks.points[0].x += 0.1;
+	tracks.points[1].z = -tracks.points[1].z;
+	tracks.reproject(&cameras, &poses, &scheduler);
+
+	assert(tracks.valid[0]);
+	assert(tracks.reprojection_errors[0] > 1.0);
+	assert(!tracks.valid[1]);
+	assert(tracks.valid[2] && tracks.reprojection_errors[2] < 0.01);
+
+	exit(0);
+}
@@ -0,0 +1,125 @@
+/***
+	This file is part of the boxes library.
+
+	Copyright (C) 2013-2014  Christian Bodenstein, Michael Tremer
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <assert.h>
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+#include <boxes/triangulation.h>
+#include "tests.h"
+
+static cv::Point2f project(const cv::Matx34d& P, const cv::Vec3d& X) {
+	cv::Vec3d x = P * cv::Vec4d(X[0], X[1], X[2], 1.0);
+
+	return cv::Point2f(x[0] / x[2], x[1] / x[2]);
+}
+
+static cv::Vec2d normalize(const cv::Matx33d& camera_inv, const cv::Point2f& pt) {
+	cv::Vec3d x = camera_inv * cv::Vec3d(pt.x, pt.y, 1.0);
+
+	return cv::Vec2d(x[0] / x[2], x[1] / x[2]);
+}
+
+int main() {
+	TEST_INIT
+
+	cv::RNG rng(1);
+
+	cv::Matx33d camera(
+		800.0,   0.0, 320.0,
+		  0.0, 800.0, 240.0,
+		  0.0,   0.0,   1.0
+	);
+	cv::Matx33d camera_inv = camera.inv();
+
+	cv::Matx34d p1 = cv::Matx34d::eye();
+	cv::Matx34d p2(
+		 cos(0.1), 0.0, sin(0.1), -1.0,
+		      0.0, 1.0,      0.0,  0.05,
+		-sin(0.1), 0.0, cos(0.1),  0.02
+	);
+
+	cv::Matx34d KP1 = camera * p1;
+	cv::Matx34d KP2 = camera * p2;
+
+	// Not a multiple of the batch size, so that the last batch is padded.
+	unsigned int n = 5 * TRIANGULATION_BATCH_SIZE + 3;
+
+	std::vector<cv::Vec3d> truth;
+	std::vector<cv::Point2f> points1;
+	std::vector<cv::Point2f> points2;
+
+	for (unsigned int i = 0; i < n; i++) {
+		truth.push_back(cv::Vec3d(rng.uniform(-2.0, 2.0), rng.uniform(-2.0, 2.0), rng.uniform(4.0, 12.0)));
+
+		points1.push_back(project(KP1, truth[i]));
+		points2.push_back(project(KP2, truth[i]));
+	}
+
+	std::vector<cv::Point3d> points(n);
+	std::vector<double> reprojection_errors(n);
+	std::vector<uchar> valid(n);
+
+	Boxes::triangulate_correspondences(&points1[0], &points2[0], n, camera, p1, camera, p2,
+		&points[0], &reprojection_errors[0], &valid[0]);
+
+	for (unsigned int i = 0; i < n; i++) {
+		// The batched kernel gives the same points as the one for single points.
+		cv::Vec3d point;
+		bool single_valid = Boxes::triangulate_correspondence(normalize(camera_inv, points1[i]), p1,
+			normalize(camera_inv, points2[i]), p2, &point);
+
+		assert(single_valid);
+		assert(valid[i]);
+
+		assert(fabs(points[i].x - point[0]) < 1e-9);
+		assert(fabs(points[i].y - point[1]) < 1e-9);
+		assert(fabs(points[i].z - point[2]) < 1e-9);
+
+		// Both found the original point.
+		assert(cv::norm(cv::Vec3d(points[i].x, points[i].y, points[i].z) - truth[i]) < 1e-3);
+
+		// The reprojection error is measured in the second image.
+		cv::Point2f reprojection = project(KP2, point);
+		double dx = reprojection.x - points2[i].x;
+		double dy = reprojection.y - points2[i].y;
+
+		assert(fabs(reprojection_errors[i] - sqrt(dx * dx + dy * dy)) < 1e-3);
+		assert(reprojection_errors[i] < 0.01);
+	}
+
+	// The same camera twice gives parallel rays, which no kernel can triangulate.
+	cv::Point2f centre(320.0, 240.0);
+	cv::Point3d point;
+	double reprojection_error;
+	uchar centre_valid;
+
+	Boxes::triangulate_correspondences(&centre, &centre, 1, camera, p1, camera, p1,
+		&point, &reprojection_error, &centre_valid);
+
+	cv::Vec3d single_point;
+	assert(!centre_valid);
+	assert(!Boxes::triangulate_correspondence(normalize(camera_inv, centre), p1,
+		normalize(camera_inv, centre), p1, &single_point));
+
+	exit(0);
+}